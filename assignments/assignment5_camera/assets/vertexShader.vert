@@ -2,16 +2,17 @@
 
 layout(location = 0) in vec3 vPos;
 layout(location = 1) in vec3 vNormal;
+//Per instance, see ew::InstanceData
+layout(location = 6) in mat4 vModel;
 
 out vec3 Normal;
-uniform mat4 _Model;
 uniform mat4 _View;
 uniform mat4 _Projection;
 
 void main(){
     Normal = vNormal;
 
-    vec4 viewPosition = _View * _Model * vec4(vPos, 1.0);
+    vec4 viewPosition = _View * vModel * vec4(vPos, 1.0);
 
     gl_Position = _Projection * viewPosition;
 }
@@ -24,6 +24,7 @@ const int SCREEN_HEIGHT = 720;
 
 const int NUM_CUBES = 4;
 ew::Transform cubeTransforms[NUM_CUBES];
+ew::InstanceData cubeInstances[NUM_CUBES];
 
 ew::Vec3 position = ew::Vec3(0, 0, 5);
 ew::Vec3 target = ew::Vec3(0, 0, 0);
@@ -115,18 +116,17 @@ int main() {
 		cam.farPlane = farPlane;
 		cam.aspectRatio = (float)SCREEN_WIDTH / (float)SCREEN_HEIGHT;
 
-		//TODO: Set model matrix uniform
+		//Do Projection Work
+		shader.setMat4("_View", cam.ViewMatrix());
+		shader.setMat4("_Projection", cam.ProjectionMatrix());
+
+		//Every cube in one upload and one draw call, model matrices are per instance attributes
 		for (size_t i = 0; i < NUM_CUBES; i++)
 		{
-			//Construct model matrix
-			shader.setMat4("_Model", cubeTransforms[i].getModelMatrix());
-
-			//Do Projection Work
-			shader.setMat4("_View", cam.ViewMatrix());
-			shader.setMat4("_Projection", cam.ProjectionMatrix());
-
-			cubeMesh.draw();
+			cubeInstances[i].model = cubeTransforms[i].getModelMatrix();
 		}
+		cubeMesh.setInstances(cubeInstances, NUM_CUBES);
+		cubeMesh.drawInstanced(NUM_CUBES);
 
 		//Render UI
 		{
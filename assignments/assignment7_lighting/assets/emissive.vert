@@ -2,10 +2,15 @@
 layout(location = 0) in vec3 vPos;
 layout(location = 1) in vec3 vNormal;
 layout(location = 2) in vec2 vUV;
+//Per instance, see ew::InstanceData
+layout(location = 6) in mat4 vModel;
+layout(location = 10) in vec4 vColor;
+
+out vec3 Color;
 
-uniform mat4 _Model;
 uniform mat4 _ViewProjection;
 
 void main(){
-	gl_Position = _ViewProjection * _Model * vec4(vPos,1.0);
+	Color = vColor.rgb;
+	gl_Position = _ViewProjection * vModel * vec4(vPos,1.0);
 }
@@ -103,14 +103,10 @@ int main() {
 	int numLights = MAX_LIGHTS;
 	bool useBlinnPhong = true;
 
-	ew::Mesh lightSphereMeshes[MAX_LIGHTS]{
-		lightSphereMeshes[0] = ew::createSphere(0.5f, 20),
-		lightSphereMeshes[1] = ew::createSphere(0.5f, 20),
-		lightSphereMeshes[2] = ew::createSphere(0.5f, 20),
-		lightSphereMeshes[3] = ew::createSphere(0.5f, 20)
-	};
-
+	//One sphere drawn once per light, placed and colored by per instance attributes
+	ew::Mesh lightSphereMesh(ew::createSphere(0.5f, 20));
 	ew::Transform lightSphereTransforms[MAX_LIGHTS];
+	ew::InstanceData lightSphereInstances[MAX_LIGHTS];
 
 	Light lights[MAX_LIGHTS]{
 		lights[0].position = ew::Vec3(5.0f,0.0f,0.0f),
@@ -170,16 +166,16 @@ int main() {
 		shader.setMat4("_Model", cylinderTransform.getModelMatrix());
 		cylinderMesh.draw();
 
-		//TODO: Render point lights
+		//Render point lights
 		for (int i = 0; i < numLights; i++) {
-			emissiveShader.use();
-			emissiveShader.setVec3("_Color", lights[i].color);
-			emissiveShader.setMat4("_ViewProjection", camera.ProjectionMatrix() * camera.ViewMatrix());
-
 			lightSphereTransforms[i].position = lights[i].position;
-			emissiveShader.setMat4("_Model", lightSphereTransforms[i].getModelMatrix());
-			lightSphereMeshes[i].draw();
+			lightSphereInstances[i].model = lightSphereTransforms[i].getModelMatrix();
+			lightSphereInstances[i].color = ew::Vec4(lights[i].color, 1.0f);
 		}
+		emissiveShader.use();
+		emissiveShader.setMat4("_ViewProjection", camera.ProjectionMatrix() * camera.ViewMatrix());
+		lightSphereMesh.setInstances(lightSphereInstances, numLights);
+		lightSphereMesh.drawInstanced(numLights);
 
 		//Render UI
 		{
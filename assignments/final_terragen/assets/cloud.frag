@@ -7,14 +7,7 @@ in Surface {
     vec3 WorldNormal;
 } fs_in;
 
-struct Light {
-    vec3 position;
-    vec3 color;
-};
-#define MAX_LIGHTS 4
-uniform Light _Lights[MAX_LIGHTS];
-uniform vec3 _ViewPosition;
-uniform int numLights;
+#include "ew/uniformBuffer.glsl"
 uniform int useBlinnPhong;
 
 uniform float ambientK;
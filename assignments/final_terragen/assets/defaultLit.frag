@@ -7,14 +7,7 @@ in Surface {
     vec3 WorldNormal;
 } fs_in;
 
-struct Light {
-    vec3 position;
-    vec3 color;
-};
-#define MAX_LIGHTS 4
-uniform Light _Lights[MAX_LIGHTS];
-uniform vec3 _ViewPosition;
-uniform int numLights;
+#include "ew/uniformBuffer.glsl"
 uniform int useBlinnPhong;
 
 uniform float ambientK;
@@ -22,7 +15,8 @@ uniform float diffuseK;
 uniform float specularK;
 uniform float shininess;
 
-uniform sampler2D _Texture;
+#include "ew/virtualTexture.glsl"
+
 uniform sampler2D _TextureNight;
 
 void main() {
@@ -55,7 +49,7 @@ void main() {
         ambient += ambientK * _Lights[i].color;
     }
 
-    vec4 texColor = texture(_Texture, fs_in.UV);
+    vec4 texColor = sampleVirtual(fs_in.UV);
     vec4 texColorN = texture(_TextureNight, fs_in.UV);
 
     vec3 mainColor = texColor.rgb * (ambient + diffuse);
@@ -3,6 +3,10 @@
 layout(location = 0) in vec3 vPos;
 layout(location = 1) in vec3 vNormal;
 layout(location = 2) in vec2 vUV;
+//Morph target (globe), blended by _MorphWeight
+layout(location = 3) in vec3 vMorphPos;
+layout(location = 4) in vec3 vMorphNormal;
+layout(location = 5) in vec2 vMorphUV;
 
 out Surface{
 	vec2 UV;
@@ -11,12 +15,18 @@ out Surface{
 }vs_out;
 
 uniform mat4 _Model;
-uniform mat4 _ViewProjection;
+#include "ew/uniformBuffer.glsl"
+uniform float _MorphWeight;
+
+#include "ew/vertexFormat.glsl"
 
 void main(){
-	vs_out.UV = vUV;
-	vs_out.WorldPosition = vec3(_Model * vec4(vPos, 1.0));
-	vs_out.WorldNormal = transpose(inverse(mat3(_Model))) * vNormal;
+	vec3 pos = decodePosition(mix(vPos, vMorphPos, _MorphWeight));
+	vec3 normal = mix(decodeNormal(vNormal), decodeNormal(vMorphNormal), _MorphWeight);
+
+	vs_out.UV = mix(vUV, vMorphUV, _MorphWeight);
+	vs_out.WorldPosition = vec3(_Model * vec4(pos, 1.0));
+	vs_out.WorldNormal = transpose(inverse(mat3(_Model))) * normal;
 
-	gl_Position = _ViewProjection * _Model * vec4(vPos,1.0);
+	gl_Position = _ViewProjection * _Model * vec4(pos,1.0);
 }
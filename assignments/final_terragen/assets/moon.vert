@@ -12,12 +12,15 @@ out Surface{
 }vs_out;
 
 uniform mat4 _Model;
-uniform mat4 _ViewProjection;
+#include "ew/uniformBuffer.glsl"
+
+#include "ew/vertexFormat.glsl"
 
 void main(){
+	vec3 pos = decodePosition(vPos);
 	vs_out.UV = vUV;
-	vs_out.WorldPosition = vec3(_Model * vec4(vPos, 1.0));
-	vs_out.WorldNormal = transpose(inverse(mat3(_Model))) * vNormal;
+	vs_out.WorldPosition = vec3(_Model * vec4(pos, 1.0));
+	vs_out.WorldNormal = transpose(inverse(mat3(_Model))) * decodeNormal(vNormal);
 
-	gl_Position = _ViewProjection * _Model * vec4(vPos,1.0);
+	gl_Position = _ViewProjection * _Model * vec4(pos,1.0);
 }
@@ -3,9 +3,9 @@ out vec4 FragColor;
 
 in vec3 Normal;
 in vec2 UV;
-uniform sampler2D _Texture;
+#include "ew/virtualTexture.glsl"
 
 void main()
 {
-	FragColor = texture(_Texture,UV);
+	FragColor = sampleVirtual(UV);
 }
\ No newline at end of file
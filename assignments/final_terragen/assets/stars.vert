@@ -7,10 +7,12 @@ out vec3 Normal;
 out vec2 UV;
 
 uniform mat4 _Model;
-uniform mat4 _ViewProjection;
+#include "ew/uniformBuffer.glsl"
+
+#include "ew/vertexFormat.glsl"
 
 void main(){
-	Normal = vNormal;
+	Normal = decodeNormal(vNormal);
 	UV = vUV;
-	gl_Position = _ViewProjection * _Model * vec4(vPos,1.0);
+	gl_Position = _ViewProjection * _Model * vec4(decodePosition(vPos),1.0);
 }
\ No newline at end of file
@@ -0,0 +1,131 @@
+#version 450
+//CDLOD terrain node, see ew/cdlodTerrain.h. Pairs with defaultLit.frag for shading and vtFeedback.frag for tile feedback.
+
+//Shared grid, x and y from 0 to 1 across the node
+layout(location = 0) in vec3 vPos;
+
+out Surface{
+	vec2 UV;
+	vec3 WorldPosition;
+	vec3 WorldNormal;
+}vs_out;
+out vec2 UV;
+
+uniform mat4 _Model;
+#include "ew/uniformBuffer.glsl"
+
+uniform vec3 _FaceNormal;
+uniform vec3 _FaceRight;
+uniform vec3 _FaceUp;
+uniform vec2 _NodeOffset; //Face coordinates of the node's minimum corner
+uniform float _NodeSize; //In face coordinates
+uniform float _GridSize; //Quads per side of the grid being drawn
+uniform vec2 _MorphRange; //Distance where morphing into the next coarser level starts and ends
+uniform float _Radius;
+uniform float _HeightScale;
+uniform float _NoiseFrequency = 4.0;
+
+const float PI = 3.14159265359;
+const int NUM_OCTAVES = 10;
+const uint NOISE_SEED = 1u;
+
+//Seeded simplex noise and fBm from ew/noise.cpp, with the same hash, primes and gradients, so a seed gives the same field on the CPU
+const float SKEW = 1.0 / 3.0;
+const float UNSKEW = 1.0 / 6.0;
+const uvec3 PRIMES = uvec3(501125321u, 1136930381u, 1720413743u);
+const uint HASH_MULTIPLIER = 0x27d4eb2du;
+
+uint hashCorner(uint seed, uvec3 primed){
+	uint hash = (seed ^ primed.x ^ primed.y ^ primed.z) * HASH_MULTIPLIER;
+	return hash ^ (hash >> 15);
+}
+//One of the 12 cube edge gradients, picked by the low 4 bits of hash
+float gradientDot(uint hash, vec3 d){
+	uint h = hash & 15u;
+	float u = (h & 8u) == 0u ? d.x : d.y;
+	float v = (h & 12u) == 0u ? d.y : ((h & 13u) == 12u ? d.x : d.z);
+	return ((h & 1u) != 0u ? -u : u) + ((h & 2u) != 0u ? -v : v);
+}
+float cornerContribution(uint hash, vec3 d){
+	float t = 0.6 - d.x * d.x - d.y * d.y - d.z * d.z;
+	if (t <= 0.0)
+		return 0.0;
+	t *= t;
+	return t * t * gradientDot(hash, d);
+}
+float simplexNoise(vec3 p, uint seed){
+	//Cell of the skewed grid, and which of its 6 tetrahedra the point is in
+	ivec3 cell = ivec3(floor(p + (p.x + p.y + p.z) * SKEW));
+	float t = float(cell.x + cell.y + cell.z) * UNSKEW;
+	vec3 d0 = p - (vec3(cell) - t);
+	bool xy = d0.x >= d0.y;
+	bool yz = d0.y >= d0.z;
+	bool xz = d0.x >= d0.z;
+	uvec3 corner1 = uvec3(xy && xz, !xy && yz, !xz && !yz);
+	uvec3 corner2 = uvec3(xy || xz, !xy || yz, !(xz && yz));
+	vec3 d1 = d0 - vec3(corner1) + UNSKEW;
+	vec3 d2 = d0 - vec3(corner2) + 2.0 * UNSKEW;
+	vec3 d3 = d0 - 1.0 + 3.0 * UNSKEW;
+
+	uvec3 primed = uvec3(cell) * PRIMES;
+	float n = cornerContribution(hashCorner(seed, primed), d0);
+	n += cornerContribution(hashCorner(seed, primed + corner1 * PRIMES), d1);
+	n += cornerContribution(hashCorner(seed, primed + corner2 * PRIMES), d2);
+	n += cornerContribution(hashCorner(seed, primed + PRIMES), d3);
+	return n * 32.0;
+}
+//Height above the sphere for a unit direction, 0 to _HeightScale. Negative fBm is flattened into sea level.
+float terrainHeight(vec3 dir){
+	float sum = 0.0;
+	float amplitude = 1.0;
+	float amplitudeSum = 0.0;
+	float frequency = _NoiseFrequency;
+	for (int octave = 0; octave < NUM_OCTAVES; octave++){
+		sum += simplexNoise(dir * frequency, NOISE_SEED + uint(octave)) * amplitude;
+		amplitudeSum += amplitude;
+		amplitude *= 0.5;
+		frequency *= 2.0;
+	}
+	return max(sum / amplitudeSum, 0.0) * _HeightScale;
+}
+vec3 faceToSphere(vec2 faceCoord){
+	return normalize(_FaceNormal + faceCoord.x * _FaceRight + faceCoord.y * _FaceUp);
+}
+//Same mapping as the globe of ew::createEarth
+vec2 sphereUV(vec3 dir){
+	return vec2(atan(dir.z, dir.x) / (2.0 * PI), 1.0 - acos(clamp(dir.y, -1.0, 1.0)) / PI);
+}
+
+void main(){
+	//Odd grid vertices slide onto their even neighbors as the camera moves away, leaving the next coarser grid
+	vec2 gridPos = vPos.xy;
+	vec3 worldPosition = vec3(_Model * vec4(faceToSphere(_NodeOffset + gridPos * _NodeSize) * _Radius, 1.0));
+	float morph = clamp((distance(worldPosition, _ViewPosition) - _MorphRange.x) / (_MorphRange.y - _MorphRange.x), 0.0, 1.0);
+	vec2 isOdd = mod(round(gridPos * _GridSize), 2.0);
+	gridPos -= isOdd / _GridSize * morph;
+
+	vec3 dir = faceToSphere(_NodeOffset + gridPos * _NodeSize);
+	vec3 pos = dir * (_Radius + terrainHeight(dir));
+
+	//Normal from the height of two nearby points, half a grid cell away
+	float epsilon = _NodeSize / _GridSize * 0.5;
+	vec3 tangent = normalize(_FaceRight - dir * dot(dir, _FaceRight));
+	vec3 bitangent = cross(dir, tangent);
+	vec3 dirT = normalize(dir + tangent * epsilon);
+	vec3 dirB = normalize(dir + bitangent * epsilon);
+	vec3 posT = dirT * (_Radius + terrainHeight(dirT));
+	vec3 posB = dirB * (_Radius + terrainHeight(dirB));
+	vec3 normal = normalize(cross(posT - pos, posB - pos));
+
+	//Unwrap u around the node center so triangles crossing the date line don't interpolate across the whole map
+	vec2 uv = sphereUV(dir);
+	float centerU = sphereUV(faceToSphere(_NodeOffset + vec2(0.5 * _NodeSize))).x;
+	uv.x = centerU + fract(uv.x - centerU + 0.5) - 0.5;
+
+	vs_out.UV = uv;
+	UV = uv;
+	vs_out.WorldPosition = vec3(_Model * vec4(pos, 1.0));
+	vs_out.WorldNormal = transpose(inverse(mat3(_Model))) * normal;
+
+	gl_Position = _ViewProjection * _Model * vec4(pos, 1.0);
+}
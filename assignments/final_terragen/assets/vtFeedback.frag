@@ -0,0 +1,14 @@
+#version 450
+//Writes the virtual texture tile each pixel needs, see ew::VirtualTextureFeedback
+layout(location = 0) out uvec4 FragFeedback;
+
+in vec2 UV;
+
+#include "ew/virtualTexture.glsl"
+uniform int _VTIndex; //Index into the texture list passed to VirtualTextureFeedback::end, plus one
+uniform float _VTLodBias; //log2(screen width / feedback width), derivatives are that much larger here
+
+void main()
+{
+	FragFeedback = uvec4(getVirtualTile(UV, _VTLodBias), _VTIndex);
+}
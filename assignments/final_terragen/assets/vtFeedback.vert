@@ -0,0 +1,21 @@
+#version 450
+
+layout(location = 0) in vec3 vPos;
+layout(location = 2) in vec2 vUV;
+//Morph target, only set for meshes that have one (earth)
+layout(location = 3) in vec3 vMorphPos;
+layout(location = 5) in vec2 vMorphUV;
+
+out vec2 UV;
+
+uniform mat4 _Model;
+#include "ew/uniformBuffer.glsl"
+uniform float _MorphWeight;
+
+#include "ew/vertexFormat.glsl"
+
+void main(){
+	vec3 pos = decodePosition(mix(vPos, vMorphPos, _MorphWeight));
+	UV = mix(vUV, vMorphUV, _MorphWeight);
+	gl_Position = _ViewProjection * _Model * vec4(pos, 1.0);
+}
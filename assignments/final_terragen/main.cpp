@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <math.h>
+#include <memory>
 
 #include <ew/external/glad.h>
 #include <ew/ewMath/ewMath.h>
@@ -9,11 +10,24 @@
 #include <imgui_impl_opengl3.h>
 
 #include <ew/shader.h>
+#include <ew/shaderBatch.h>
 #include <ew/texture.h>
+#include <ew/textureStreamer.h>
+#include <ew/virtualTexture.h>
 #include <ew/procGen.h>
+#include <ew/meshCache.h>
+#include <ew/meshOptimizer.h>
+#include <ew/dynamicMesh.h>
+#include <ew/lodMesh.h>
+#include <ew/cdlodTerrain.h>
+#include <ew/frustum.h>
+#include <ew/renderQueue.h>
+#include <ew/profiler.h>
+#include <ew/benchmark.h>
 #include <ew/transform.h>
 #include <ew/camera.h>
 #include <ew/cameraController.h>
+#include <ew/uniformBuffer.h>
 #include <../assignments/final_terragen/constants.h>
 
 
@@ -34,6 +48,76 @@ struct Material {
 	float shininess; //Shininess
 };
 
+//Uniform handles shared by the lit shaders (defaultLit, cloud, moon), resolved once at startup.
+//Camera and lights come from the shared uniform buffers.
+struct LitUniforms {
+	ew::UniformHandle<ew::Mat4> model;
+	ew::UniformHandle<float> ambientK;
+	ew::UniformHandle<float> diffuseK;
+	ew::UniformHandle<float> specularK;
+	ew::UniformHandle<float> shininess;
+	ew::UniformHandle<int> useBlinnPhong;
+};
+
+//Uniform handles for the unlit shaders (stars, emissive)
+struct UnlitUniforms {
+	ew::UniformHandle<ew::Mat4> model;
+	ew::UniformHandle<ew::Vec3> color;
+};
+
+//Uniform handles for ew/vertexFormat.glsl, and the mesh they were last set for.
+//Values are only uploaded again when the shader draws a different mesh, such as another LOD level.
+struct VertexDecodeUniforms {
+	ew::UniformHandle<ew::Vec3> positionScale;
+	ew::UniformHandle<ew::Vec3> positionOffset;
+	ew::UniformHandle<int> octahedralNormals;
+	const ew::Mesh* mesh = nullptr;
+};
+
+//Uniform handles for the virtual texture feedback pass (vtFeedback)
+struct FeedbackUniforms {
+	ew::UniformHandle<ew::Mat4> model;
+	ew::UniformHandle<float> morphWeight;
+	ew::UniformHandle<ew::Vec2> size;
+	ew::UniformHandle<int> numLevels;
+	ew::UniformHandle<int> tileSize;
+	ew::UniformHandle<int> index;
+	ew::UniformHandle<float> lodBias;
+	VertexDecodeUniforms vertexDecode;
+};
+
+LitUniforms getLitUniforms(const ew::Shader& shader);
+UnlitUniforms getUnlitUniforms(const ew::Shader& shader);
+VertexDecodeUniforms getVertexDecodeUniforms(const ew::Shader& shader);
+FeedbackUniforms getFeedbackUniforms(const ew::Shader& shader);
+void setMaterialUniforms(const ew::Shader& shader, const LitUniforms& uniforms, const Material& material);
+void setVirtualTextureUniforms(const ew::Shader& shader, const ew::VirtualTexture& virtualTexture);
+void setVertexDecodeUniforms(const ew::Shader& shader, VertexDecodeUniforms& uniforms, const ew::Mesh& mesh);
+void setFeedbackUniforms(const ew::Shader& shader, FeedbackUniforms& uniforms, const ew::VirtualTexture& virtualTexture, const ew::Mesh& mesh, int index);
+ew::MeshData optimized(const char* name, ew::MeshData meshData);
+
+//Objects tested against the view frustum each frame, in the order their bounds are passed to ew::cullSpheres
+enum CulledObject {
+	CULL_EARTH,
+	CULL_CLOUDS,
+	CULL_MOON,
+	CULL_SUN,
+	NUM_CULLED_OBJECTS
+};
+
+//Subdivisions of each level of the earth, cloud and star LOD chains, finest first
+const int LOD_SUBDIVISIONS[] = { 640, 320, 160, 80, 40, 20 };
+
+//Camera path of --bench runs: in from the default view, low around the earth, then out past it
+const ew::CameraKeyframe BENCH_CAMERA_PATH[] = {
+	{ 0.0f, ew::Vec3(0.0f, 0.0f, 5.0f), ew::Vec3(0.0f) },
+	{ 2.5f, ew::Vec3(3.0f, 1.0f, 2.0f), ew::Vec3(0.0f) },
+	{ 4.5f, ew::Vec3(1.0f, 0.3f, 0.0f), ew::Vec3(0.0f) },
+	{ 6.0f, ew::Vec3(0.5f, 0.3f, -0.87f), ew::Vec3(0.0f) },
+	{ 7.5f, ew::Vec3(-0.5f, 0.3f, -0.87f), ew::Vec3(0.0f) },
+	{ 10.0f, ew::Vec3(-4.0f, -1.0f, 3.0f), ew::Vec3(0.0f) }
+};
+
 int SCREEN_WIDTH = 1080;
 int SCREEN_HEIGHT = 720;
 
@@ -45,14 +129,25 @@ ew::Vec3 bgColor = ew::Vec3(0.0f);
 ew::Camera camera;
 ew::CameraController cameraController;
 
-int main() {
+int main(int argc, char** argv) {
+	//--bench renders a fixed camera path offscreen and writes timings instead of opening the interactive window, see ew/benchmark.h
+	ew::BenchmarkSettings benchmarkSettings = ew::parseBenchmarkArgs(argc, argv);
+
 	printf("Initializing...");
 	if (!glfwInit()) {
 		printf("GLFW failed to init!");
 		return 1;
 	}
 
-	GLFWwindow* window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "Camera", NULL, NULL);
+	GLFWwindow* window;
+	if (benchmarkSettings.enabled) {
+		SCREEN_WIDTH = benchmarkSettings.width;
+		SCREEN_HEIGHT = benchmarkSettings.height;
+		window = ew::createBenchmarkWindow(benchmarkSettings, "Camera");
+	}
+	else {
+		window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "Camera", NULL, NULL);
+	}
 	if (window == NULL) {
 		printf("GLFW failed to create window");
 		return 1;
@@ -89,13 +184,47 @@ int main() {
 		material.shininess = 1.0f
 	};
 
+	//Textures decode in the background and appear once uploaded
+	ew::TextureStreamer textureStreamer;
+
+	//Every program is submitted up front so the driver compiles them while textures decode and meshes are built below.
+	//Uniforms are set up once the batch is done, see ew/shaderBatch.h
+	ew::ShaderBatch shaderBatch;
+	const int earthProgram = shaderBatch.add("assets/defaultLit.vert", "assets/defaultLit.frag");
+	const int terrainProgram = shaderBatch.add("assets/terrain.vert", "assets/defaultLit.frag");
+	const int cloudProgram = shaderBatch.add("assets/cloud.vert", "assets/cloud.frag");
+	const int moonProgram = shaderBatch.add("assets/moon.vert", "assets/moon.frag");
+	const int emissiveProgram = shaderBatch.add("assets/emissive.vert", "assets/emissive.frag");
+	const int starProgram = shaderBatch.add("assets/stars.vert", "assets/stars.frag");
+	const int feedbackProgram = shaderBatch.add("assets/vtFeedback.vert", "assets/vtFeedback.frag");
+	const int terrainFeedbackProgram = shaderBatch.add("assets/terrain.vert", "assets/vtFeedback.frag");
+
 	//----------------Earth---------------------
 
-	ew::Shader earthShader("assets/defaultLit.vert", "assets/defaultLit.frag");
-	unsigned int earthTexture = ew::loadTexture("assets/world5k.png", GL_REPEAT, GL_LINEAR);
-	unsigned int nightTexture = ew::loadTexture("assets/worldN.jpg", GL_REPEAT, GL_LINEAR);
+	//Day map is sampled through a fixed size tile atlas, see ew/virtualTexture.h
+	ew::VirtualTexture earthVirtualTexture("assets/world5k.png");
+	unsigned int nightTexture = textureStreamer.load("assets/worldN.jpg", GL_REPEAT, GL_LINEAR);
+
+	//Flat map and globe are uploaded once per LOD level; the blend between them is a uniform.
+	//Generated meshes are cached in assets/ and mapped straight into the buffers on later launches.
+	float earthWidth = 40075.0f * Constants::scaleRatio;
+	float earthHeight = 20000.0f * Constants::scaleRatio;
+	float earthRadius = 6357.0f * Constants::scaleRatio;
+	//The flat map reaches further from the center than the globe
+	float flatMapRadius = sqrtf(earthWidth * earthWidth + earthHeight * earthHeight) * 0.5f;
+	ew::LodMesh earthLod;
+	for (int subdivisions : LOD_SUBDIVISIONS)
+	{
+		earthLod.addLevel(ew::loadCachedMesh("assets", "earth", { earthWidth, earthHeight, earthRadius, (float)subdivisions, 0.0f }, [&] {
+			return optimized("earth", ew::createEarth(earthWidth, earthHeight, earthRadius, subdivisions, 0.0f));
+		}).getView(), ew::getSphereGeometricError(earthRadius, subdivisions), ew::VertexFormat::NORMALIZED);
+	}
+
+	//Quadtree terrain that replaces the globe when enabled, see ew/cdlodTerrain.h.
+	//Heights are exaggerated: the default tops out at 10x the height of Everest.
+	ew::CdlodTerrain terrain(earthRadius, 88.0f * Constants::scaleRatio, 12);
+	bool useTerrain = false;
 
-	ew::Mesh earthMesh(ew::createSphere(6357.0f * Constants::scaleRatio, 640));
 	ew::Transform earthTransform;
 	earthTransform.position = ew::Vec3(0.0f, 0.0f, 0.0f);
 	earthTransform.rotation = ew::Vec3(0.0f, 0.0f, 0.0f);
@@ -103,15 +232,18 @@ int main() {
 	float earthRotY = 0.0f;
 	float earthSpinSpeed = 10.0f;
 
-	//Add height here
-	earthMesh.load(ew::createEarth(40075.0f * Constants::scaleRatio, 20000.0f * Constants::scaleRatio, 6357.0f * Constants::scaleRatio, 640, 1.0f, 0.0f));
-
 	//-------------------Clouds------------------------
 
-	ew::Shader sphereShader("assets/cloud.vert", "assets/cloud.frag");
-	unsigned int cloudTexture = ew::loadTexture("assets/cloud.png", GL_REPEAT, GL_LINEAR);
+	unsigned int cloudTexture = textureStreamer.load("assets/cloud.png", GL_REPEAT, GL_LINEAR, ew::Vec4(0.0f));
 
-	ew::Mesh cloudMesh(ew::createSphere((6357.0f + 10.0f) * Constants::scaleRatio, 640));
+	float cloudRadius = (6357.0f + 10.0f) * Constants::scaleRatio;
+	ew::LodMesh cloudLod;
+	for (int subdivisions : LOD_SUBDIVISIONS)
+	{
+		cloudLod.addLevel(ew::loadCachedMesh("assets", "sphere", { cloudRadius, (float)subdivisions }, [&] {
+			return optimized("clouds", ew::createSphere(cloudRadius, subdivisions));
+		}).getView(), ew::getSphereGeometricError(cloudRadius, subdivisions), ew::VertexFormat::NORMALIZED);
+	}
 	ew::Transform cloudTransform;
 	cloudTransform.position = ew::Vec3(0.0f, 0.0f, 0.0f);
 	cloudTransform.rotation = ew::Vec3(0.0f, 0.0f, 0.0f);
@@ -126,23 +258,28 @@ int main() {
 		moonMaterial.shininess = 0.05f
 	};
 
-	ew::Shader moonShader("assets/moon.vert", "assets/moon.frag");
-	unsigned int moonTexture = ew::loadTexture("assets/moon1k.jpg", GL_REPEAT, GL_LINEAR);
+	unsigned int moonTexture = textureStreamer.load("assets/moon1k.jpg", GL_REPEAT, GL_LINEAR);
 
 	float moonDistance = 384400.0f * Constants::scaleRatio;
 
-	ew::Mesh moonMesh(ew::createSphere(1737.4f * Constants::scaleRatio, 64));
+	ew::Mesh moonMesh(optimized("moon", ew::createSphere(1737.4f * Constants::scaleRatio, 64)), ew::MeshUsage::STATIC, ew::VertexFormat::HALF);
 	ew::Transform moonTransform;
 	moonTransform.position = ew::Vec3(moonDistance, 0.0f, 0.0f);
 	moonTransform.rotation = ew::Vec3(0.0f, 0.0f, 0.0f);
 
-	//----------------------Sun------------------------
+	//Recent moon positions as points. Each sample overwrites one vertex of the ring, so only that vertex is uploaded.
+	const int MOON_TRAIL_LENGTH = 1024;
+	const float MOON_TRAIL_INTERVAL = 0.25f;
+	ew::DynamicMesh moonTrail(MOON_TRAIL_LENGTH, 0);
+	int moonTrailNext = 0;
+	float moonTrailTime = -MOON_TRAIL_INTERVAL;
+	bool showMoonTrail = true;
 
-	ew::Shader emissiveShader("assets/emissive.vert", "assets/emissive.frag");
+	//----------------------Sun------------------------
 
 	float sunDistance = 149600000.0f * Constants::scaleRatio;
 
-	ew::Mesh sunMesh = ew::createSphere(1392000.0f * Constants::scaleRatio, 20);
+	ew::Mesh sunMesh = optimized("sun", ew::createSphere(1392000.0f * Constants::scaleRatio, 20));
 	ew::Transform sunSphereTransform;
 	Light sunLight;
 	sunLight.position = ew::Vec3(sunDistance, 0.0f, 0.0f);
@@ -153,153 +290,367 @@ int main() {
 
 	//---------------------Stars---------------------
 
-	ew::Shader starShader("assets/stars.vert", "assets/stars.frag");
-	unsigned int starTexture = ew::loadTexture("assets/starmap16k.jpg", GL_REPEAT, GL_LINEAR);
+	ew::VirtualTexture starVirtualTexture("assets/starmap16k.jpg");
 
-	ew::Mesh starMesh(ew::createSphere(18000.0f, 640));
+	float starRadius = 18000.0f;
+	ew::LodMesh starLod;
+	for (int subdivisions : LOD_SUBDIVISIONS)
+	{
+		starLod.addLevel(ew::loadCachedMesh("assets", "sphere", { starRadius, (float)subdivisions }, [&] {
+			return optimized("stars", ew::createSphere(starRadius, subdivisions));
+		}).getView(), ew::getSphereGeometricError(starRadius, subdivisions), ew::VertexFormat::NORMALIZED);
+	}
 	ew::Transform starTransform;
 	cloudTransform.position = ew::Vec3(0.0f, 0.0f, 0.0f);
 	cloudTransform.rotation = ew::Vec3(0.0f, 0.0f, 0.0f);
 
+	//---------------Virtual texture feedback---------------
+
+	//Visible tiles are rendered at 1/8 resolution and read back a frame later
+	const int FEEDBACK_DOWNSCALE = 8;
+	ew::VirtualTextureFeedback virtualTextureFeedback(SCREEN_WIDTH / FEEDBACK_DOWNSCALE, SCREEN_HEIGHT / FEEDBACK_DOWNSCALE);
+	//Index + 1 is what the feedback shader writes
+	ew::VirtualTexture* virtualTextures[] = { &earthVirtualTexture, &starVirtualTexture };
+
+	//--------------------Programs--------------------
+
+	//Show progress while the rest of the batch compiles. Benchmarks just wait, since they time frames, not startup.
+	if (benchmarkSettings.enabled) {
+		shaderBatch.finish();
+	}
+	while (!shaderBatch.poll() && !glfwWindowShouldClose(window)) {
+		glfwPollEvents();
+		textureStreamer.update();
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		ImGui_ImplGlfw_NewFrame();
+		ImGui_ImplOpenGL3_NewFrame();
+		ImGui::NewFrame();
+		ImGui::SetNextWindowPos(ImVec2(SCREEN_WIDTH * 0.5f, SCREEN_HEIGHT * 0.5f), ImGuiCond_Always, ImVec2(0.5f, 0.5f));
+		ImGui::Begin("Loading", nullptr, ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize);
+		ImGui::Text("Compiling shaders %d/%d%s", shaderBatch.getNumReady(), shaderBatch.getNumPrograms(), shaderBatch.isParallel() ? " (parallel)" : "");
+		ImGui::End();
+		ImGui::Render();
+		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+
+		glfwSwapBuffers(window);
+	}
+
+	ew::Shader earthShader = shaderBatch.getShader(earthProgram);
+	LitUniforms earthUniforms = getLitUniforms(earthShader);
+	ew::UniformHandle<float> earthMorphWeight = earthShader.getUniformHandle<float>("_MorphWeight");
+	VertexDecodeUniforms earthDecodeUniforms = getVertexDecodeUniforms(earthShader);
+	earthShader.use();
+	earthShader.setInt("_TileAtlas", 0);
+	earthShader.setInt("_PageTable", 5);
+	earthShader.setInt("_TextureNight", 1);
+	setVirtualTextureUniforms(earthShader, earthVirtualTexture);
+
+	ew::Shader terrainShader = shaderBatch.getShader(terrainProgram);
+	LitUniforms terrainUniforms = getLitUniforms(terrainShader);
+	ew::TerrainUniforms terrainNodeUniforms = ew::getTerrainUniforms(terrainShader);
+	terrainShader.use();
+	terrainShader.setInt("_TileAtlas", 0);
+	terrainShader.setInt("_PageTable", 5);
+	terrainShader.setInt("_TextureNight", 1);
+	setVirtualTextureUniforms(terrainShader, earthVirtualTexture);
+
+	ew::Shader sphereShader = shaderBatch.getShader(cloudProgram);
+	LitUniforms cloudUniforms = getLitUniforms(sphereShader);
+	VertexDecodeUniforms cloudDecodeUniforms = getVertexDecodeUniforms(sphereShader);
+	sphereShader.use();
+	sphereShader.setInt("_Texture", 2);
+
+	ew::Shader moonShader = shaderBatch.getShader(moonProgram);
+	LitUniforms moonUniforms = getLitUniforms(moonShader);
+	moonShader.use();
+	moonShader.setInt("_Texture", 4);
+	VertexDecodeUniforms moonDecodeUniforms = getVertexDecodeUniforms(moonShader);
+	setVertexDecodeUniforms(moonShader, moonDecodeUniforms, moonMesh);
+
+	ew::Shader emissiveShader = shaderBatch.getShader(emissiveProgram);
+	UnlitUniforms emissiveUniforms = getUnlitUniforms(emissiveShader);
+
+	ew::Shader starShader = shaderBatch.getShader(starProgram);
+	UnlitUniforms starUniforms = getUnlitUniforms(starShader);
+	VertexDecodeUniforms starDecodeUniforms = getVertexDecodeUniforms(starShader);
+	starShader.use();
+	starShader.setInt("_TileAtlas", 3);
+	starShader.setInt("_PageTable", 6);
+	setVirtualTextureUniforms(starShader, starVirtualTexture);
+
+	ew::Shader feedbackShader = shaderBatch.getShader(feedbackProgram);
+	FeedbackUniforms feedbackUniforms = getFeedbackUniforms(feedbackShader);
+	ew::Shader terrainFeedbackShader = shaderBatch.getShader(terrainFeedbackProgram);
+	FeedbackUniforms terrainFeedbackUniforms = getFeedbackUniforms(terrainFeedbackShader);
+	ew::TerrainUniforms terrainFeedbackNodeUniforms = ew::getTerrainUniforms(terrainFeedbackShader);
+
 	camera.farPlane = 20000.0f;
 	resetCamera(camera, cameraController);
+
+	//Camera and light data are uploaded once per frame and read by every program
+	ew::UniformBuffer frameBuffer(ew::UBO_BINDING_FRAME, sizeof(ew::FrameUniforms));
+	ew::UniformBuffer lightBuffer(ew::UBO_BINDING_LIGHTS, sizeof(ew::LightUniforms));
+	ew::FrameUniforms frameUniforms = {};
+	ew::LightUniforms lightUniforms = {};
+	ew::RenderQueue renderQueue;
+
+	ew::Profiler profiler;
+	const int updateZone = profiler.getZoneId("Update", false);
+	const int streamingZone = profiler.getZoneId("Texture streaming");
+	const int earthZone = profiler.getZoneId("Earth");
+	const int cloudZone = profiler.getZoneId("Clouds");
+	const int moonZone = profiler.getZoneId("Moon");
+	const int starZone = profiler.getZoneId("Stars");
+	const int sunZone = profiler.getZoneId("Sun");
+	const int feedbackZone = profiler.getZoneId("Virtual texture feedback");
+	const int uiZone = profiler.getZoneId("UI");
+
+	std::unique_ptr<ew::Benchmark> benchmark;
+	if (benchmarkSettings.enabled) {
+		benchmark.reset(new ew::Benchmark(benchmarkSettings));
+	}
 	
-	while (!glfwWindowShouldClose(window)) {
+	while (benchmark ? benchmark->isRunning() : !glfwWindowShouldClose(window)) {
+		if (benchmark) {
+			benchmark->beginFrame();
+		}
+		profiler.beginFrame();
 		glfwPollEvents();
+		profiler.beginZone(streamingZone);
+		textureStreamer.update();
+		profiler.endZone(streamingZone);
 
-		float time = (float)glfwGetTime();
-		float deltaTime = time - prevTime;
+		//Benchmarks step simulated time by a fixed amount each frame, so every run sees the same frames
+		float time = benchmark ? benchmark->getTime() : (float)glfwGetTime();
+		float deltaTime = benchmark ? benchmark->getTimestep() : time - prevTime;
 		prevTime = time;
 
+		profiler.beginZone(updateZone);
+
 		//Update camera
 		camera.aspectRatio = (float)SCREEN_WIDTH / SCREEN_HEIGHT;
-		cameraController.Move(window, &camera, deltaTime);
+		if (benchmark) {
+			ew::evaluateCameraPath(BENCH_CAMERA_PATH, sizeof(BENCH_CAMERA_PATH) / sizeof(BENCH_CAMERA_PATH[0]), time, camera);
+		}
+		else {
+			cameraController.Move(window, &camera, deltaTime);
+		}
 
 		//RENDER
 		glClearColor(bgColor.x, bgColor.y,bgColor.z,1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		glEnable(GL_BLEND);
 
-		//--------------------Earth------------------
+		frameUniforms.viewProjection = camera.ProjectionMatrix() * camera.ViewMatrix();
+		frameUniforms.viewPosition = camera.position;
+		frameBuffer.update(frameUniforms);
 
-		earthRotY += earthSpinSpeed * deltaTime;
-		float scale = (cos(time) + 1.0f) / 2.0f;
-		//scale = 1;
-		earthMesh.load(ew::createEarth(40075.0f * Constants::scaleRatio, 20000.0f * Constants::scaleRatio, 6357.0f * Constants::scaleRatio, 64, scale, 0.0f));
+		//Pick each LOD chain's level from its on screen error. Levels have their own position decode.
+		//The terrain only exists as a globe, so the flat map animation holds there while it is shown
+		float scale = useTerrain ? 1.0f : (cos(time) + 1.0f) / 2.0f;
+		earthLod.selectLevel(camera, SCREEN_HEIGHT, earthTransform.position, lerp(flatMapRadius, earthRadius, scale));
+		cloudLod.selectLevel(camera, SCREEN_HEIGHT, cloudTransform.position, cloudRadius);
+		starLod.selectLevel(camera, SCREEN_HEIGHT, starTransform.position, starRadius);
+		const ew::Mesh& earthMesh = earthLod.getCurrentMesh();
+		const ew::Mesh& cloudMesh = cloudLod.getCurrentMesh();
+		const ew::Mesh& starMesh = starLod.getCurrentMesh();
 
+		//-----Move everything for this frame
+
+		earthRotY += earthSpinSpeed * deltaTime;
 		earthTransform.rotation = ew::Vec3(
 			lerp(180.0f, earthAxialTilt, scale),
 			lerp(earthRotY / 365.25f + 90.f, earthRotY, scale),
 			lerp(180.0f, 0.0f, scale));
-
-		earthShader.use();
-
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, earthTexture);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, nightTexture);
-		earthShader.setInt("_Texture", 0);
-		earthShader.setInt("_TextureNight", 1);
-
-		earthShader.setMat4("_ViewProjection", camera.ProjectionMatrix() * camera.ViewMatrix());
-
-		earthShader.setFloat("ambientK", material.ambientK);
-		earthShader.setFloat("diffuseK", material.diffuseK);
-		earthShader.setFloat("specularK", material.specular);
-		earthShader.setFloat("shininess", material.shininess);
-		earthShader.setVec3("_ViewPosition", camera.position);
-		earthShader.setInt("numLights", 1);
-		earthShader.setInt("useBlinnPhong", true);
-
-		earthShader.setVec3("_Lights[0].position", sunLight.position);
-		earthShader.setVec3("_Lights[0].color", colorOnEarth);
-
-		earthShader.setMat4("_Model", earthTransform.getModelMatrix());
-		earthMesh.draw();
-
-		//-----------------Clouds----------------------
-
 		cloudTransform.rotation = ew::Vec3(earthAxialTilt, earthRotY / 1.2f, 0.0f);
 
-		sphereShader.use();
-		glActiveTexture(GL_TEXTURE2);
-		glBindTexture(GL_TEXTURE_2D, cloudTexture);
-		sphereShader.setInt("_Texture", 2);
-
-		sphereShader.setMat4("_Model", cloudTransform.getModelMatrix());
-		sphereShader.setMat4("_ViewProjection", camera.ProjectionMatrix() * camera.ViewMatrix());
-
-		sphereShader.setFloat("ambientK", material.ambientK);
-		sphereShader.setFloat("diffuseK", material.diffuseK);
-		sphereShader.setFloat("specularK", material.specular);
-		sphereShader.setFloat("shininess", material.shininess);
-		sphereShader.setVec3("_ViewPosition", camera.position);
-		sphereShader.setInt("numLights", 1);
-		sphereShader.setInt("useBlinnPhong", true);
+		float spaceRotation = -earthRotY / 365.25f;
+		moonTransform.position = moveOnUnitCircle(spaceRotation * 12.4f, moonDistance);
+		moonTransform.rotation = ew::Vec3(0.0f, -spaceRotation * 12.4f, 0.0f);
+		if (time - moonTrailTime >= MOON_TRAIL_INTERVAL) {
+			ew::Vertex trailVertex = {};
+			trailVertex.pos = moonTransform.position;
+			moonTrail.updateVertices(&trailVertex, moonTrailNext, 1);
+			moonTrailNext = (moonTrailNext + 1) % MOON_TRAIL_LENGTH;
+			moonTrailTime = time;
+		}
+		starTransform.rotation = ew::Vec3(0.0f, spaceRotation, 0.0f);
+		sunLight.position = moveOnUnitCircle(spaceRotation, sunDistance);
+		sunSphereTransform.position = sunLight.position;
 
-		sphereShader.setVec3("_Lights[0].position", sunLight.position);
-		sphereShader.setVec3("_Lights[0].color", colorOnEarth);
+		lightUniforms.numLights = 1;
+		lightUniforms.lights[0].position = sunLight.position;
+		lightUniforms.lights[0].color = colorOnEarth;
+		lightBuffer.update(lightUniforms);
 
-		cloudMesh.draw();
+		//-----Frustum culling. The star dome surrounds the camera and is always drawn.
 
-		//-----Math for sun, moon, and stars
+		ew::Frustum frustum = ew::extractFrustum(frameUniforms.viewProjection);
+		ew::BoundingSphere worldBounds[NUM_CULLED_OBJECTS];
+		worldBounds[CULL_EARTH] = ew::transformBoundingSphere(earthTransform.getModelMatrix(), earthMesh.getBounds().center, earthMesh.getBounds().radius);
+		worldBounds[CULL_CLOUDS] = ew::transformBoundingSphere(cloudTransform.getModelMatrix(), cloudMesh.getBounds().center, cloudMesh.getBounds().radius);
+		worldBounds[CULL_MOON] = ew::transformBoundingSphere(moonTransform.getModelMatrix(), moonMesh.getBounds().center, moonMesh.getBounds().radius);
+		worldBounds[CULL_SUN] = ew::transformBoundingSphere(sunSphereTransform.getModelMatrix(), sunMesh.getBounds().center, sunMesh.getBounds().radius);
+		uint8_t isVisible[NUM_CULLED_OBJECTS];
+		ew::cullSpheres(frustum, worldBounds, NUM_CULLED_OBJECTS, isVisible);
+		profiler.endZone(updateZone);
 
-		float spaceRotation = -earthRotY / 365.25f;
+		//Draws are queued, then sorted by pass, program and textures and submitted through a state cache
 
-		//-----------------------Moon-------------------------
+		//--------------------Earth------------------
 
-		moonTransform.position = moveOnUnitCircle(spaceRotation * 12.4f, moonDistance);
-		moonTransform.rotation = ew::Vec3(0.0f, -spaceRotation * 12.4f, 0.0f);
+		if (isVisible[CULL_EARTH]) {
+			ew::DrawItem item;
+			item.depth = ew::Magnitude(earthTransform.position - camera.position);
+			item.profileZone = earthZone;
+			item.addTexture(0, GL_TEXTURE_2D, earthVirtualTexture.getAtlas());
+			item.addTexture(5, GL_TEXTURE_2D_ARRAY, earthVirtualTexture.getPageTable());
+			item.addTexture(1, GL_TEXTURE_2D, nightTexture);
+			if (useTerrain) {
+				terrain.select(camera, earthTransform.getModelMatrix());
+				item.shader = &terrainShader;
+				item.setUniforms = [&] {
+					setMaterialUniforms(terrainShader, terrainUniforms, material);
+					terrainShader.set(terrainUniforms.model, earthTransform.getModelMatrix());
+				};
+				item.draw = [&] {
+					terrain.draw(terrainShader, terrainNodeUniforms);
+				};
+			}
+			else {
+				item.shader = &earthShader;
+				item.mesh = &earthMesh;
+				item.setUniforms = [&] {
+					setMaterialUniforms(earthShader, earthUniforms, material);
+					earthShader.set(earthMorphWeight, scale);
+					earthShader.set(earthUniforms.model, earthTransform.getModelMatrix());
+					setVertexDecodeUniforms(earthShader, earthDecodeUniforms, earthMesh);
+				};
+			}
+			renderQueue.submit(item);
+		}
 
-		moonShader.use();
-		glActiveTexture(GL_TEXTURE4);
-		glBindTexture(GL_TEXTURE_2D, moonTexture);
-		moonShader.setInt("_Texture", 4);
-		moonShader.setMat4("_ViewProjection", camera.ProjectionMatrix() * camera.ViewMatrix());
+		//-----------------Clouds----------------------
 
-		moonShader.setFloat("ambientK", moonMaterial.ambientK);
-		moonShader.setFloat("diffuseK", moonMaterial.diffuseK);
-		moonShader.setFloat("specularK", moonMaterial.specular);
-		moonShader.setFloat("shininess", moonMaterial.shininess);
-		moonShader.setVec3("_ViewPosition", camera.position);
-		moonShader.setInt("numLights", 1);
-		moonShader.setInt("useBlinnPhong", true);
+		if (isVisible[CULL_CLOUDS]) {
+			ew::DrawItem item;
+			item.pass = ew::RenderPass::BLENDED;
+			item.depth = ew::Magnitude(cloudTransform.position - camera.position);
+			item.profileZone = cloudZone;
+			item.shader = &sphereShader;
+			item.mesh = &cloudMesh;
+			item.addTexture(2, GL_TEXTURE_2D, cloudTexture);
+			item.setUniforms = [&] {
+				sphereShader.set(cloudUniforms.model, cloudTransform.getModelMatrix());
+				setMaterialUniforms(sphereShader, cloudUniforms, material);
+				setVertexDecodeUniforms(sphereShader, cloudDecodeUniforms, cloudMesh);
+			};
+			renderQueue.submit(item);
+		}
 
-		moonShader.setVec3("_Lights[0].position", sunLight.position);
-		moonShader.setVec3("_Lights[0].color", colorOnEarth);
+		//-----------------------Moon-------------------------
 
-		moonShader.setMat4("_Model", moonTransform.getModelMatrix());
-		moonMesh.draw();
+		if (isVisible[CULL_MOON]) {
+			ew::DrawItem item;
+			item.depth = ew::Magnitude(moonTransform.position - camera.position);
+			item.profileZone = moonZone;
+			item.shader = &moonShader;
+			item.mesh = &moonMesh;
+			item.addTexture(4, GL_TEXTURE_2D, moonTexture);
+			item.setUniforms = [&] {
+				setMaterialUniforms(moonShader, moonUniforms, moonMaterial);
+				moonShader.set(moonUniforms.model, moonTransform.getModelMatrix());
+			};
+			renderQueue.submit(item);
+		}
 
 		//------------------------Stars---------------------
 
-		starTransform.rotation = ew::Vec3(0.0f, spaceRotation, 0.0f);
+		{
+			ew::DrawItem item;
+			item.depth = starRadius;
+			item.profileZone = starZone;
+			item.shader = &starShader;
+			item.mesh = &starMesh;
+			item.addTexture(3, GL_TEXTURE_2D, starVirtualTexture.getAtlas());
+			item.addTexture(6, GL_TEXTURE_2D_ARRAY, starVirtualTexture.getPageTable());
+			item.setUniforms = [&] {
+				starShader.set(starUniforms.model, starTransform.getModelMatrix());
+				setVertexDecodeUniforms(starShader, starDecodeUniforms, starMesh);
+			};
+			renderQueue.submit(item);
+		}
 
-		starShader.use();
-		glActiveTexture(GL_TEXTURE3);
-		glBindTexture(GL_TEXTURE_2D, starTexture);
-		starShader.setInt("_Texture", 3);
+		//-------------------------Sun---------------------
 
-		starShader.setMat4("_Model", starTransform.getModelMatrix());
-		starShader.setMat4("_ViewProjection", camera.ProjectionMatrix() * camera.ViewMatrix());
+		if (isVisible[CULL_SUN]) {
+			ew::DrawItem item;
+			item.depth = ew::Magnitude(sunSphereTransform.position - camera.position);
+			item.profileZone = sunZone;
+			item.shader = &emissiveShader;
+			item.mesh = &sunMesh;
+			item.setUniforms = [&] {
+				emissiveShader.set(emissiveUniforms.color, sunLight.color);
+				emissiveShader.set(emissiveUniforms.model, sunSphereTransform.getModelMatrix());
+			};
+			renderQueue.submit(item);
+		}
 
-		starMesh.draw();
+		//--------------------Moon trail--------------------
+
+		if (showMoonTrail) {
+			ew::DrawItem item;
+			item.profileZone = moonZone;
+			item.shader = &emissiveShader;
+			item.setUniforms = [&] {
+				emissiveShader.set(emissiveUniforms.color, ew::Vec3(0.6f));
+				emissiveShader.set(emissiveUniforms.model, ew::IdentityMatrix());
+			};
+			item.draw = [&] {
+				moonTrail.draw(ew::DrawMode::POINTS);
+			};
+			renderQueue.submit(item);
+		}
 
-		//-------------------------Sun---------------------
+		renderQueue.flush(&profiler);
 
-		sunLight.position = moveOnUnitCircle(spaceRotation, sunDistance);
+		//-----------------Virtual texture feedback-----------------
 
-		emissiveShader.use();
-		emissiveShader.setVec3("_Color", sunLight.color);
-		emissiveShader.setMat4("_ViewProjection", camera.ProjectionMatrix() * camera.ViewMatrix());
+		profiler.beginZone(feedbackZone);
+		feedbackShader.use();
+		virtualTextureFeedback.begin();
+		float lodBias = log2f((float)SCREEN_WIDTH / virtualTextureFeedback.getWidth());
+		feedbackShader.set(feedbackUniforms.lodBias, lodBias);
 
-		sunSphereTransform.position = sunLight.position;
+		if (isVisible[CULL_EARTH] && useTerrain) {
+			terrainFeedbackShader.use();
+			terrainFeedbackShader.set(terrainFeedbackUniforms.lodBias, lodBias);
+			setFeedbackUniforms(terrainFeedbackShader, terrainFeedbackUniforms, earthVirtualTexture, earthMesh, 1);
+			terrainFeedbackShader.set(terrainFeedbackUniforms.model, earthTransform.getModelMatrix());
+			terrain.draw(terrainFeedbackShader, terrainFeedbackNodeUniforms);
+			feedbackShader.use();
+		}
+		else if (isVisible[CULL_EARTH]) {
+			setFeedbackUniforms(feedbackShader, feedbackUniforms, earthVirtualTexture, earthMesh, 1);
+			feedbackShader.set(feedbackUniforms.morphWeight, scale);
+			feedbackShader.set(feedbackUniforms.model, earthTransform.getModelMatrix());
+			earthMesh.draw();
+		}
+
+		setFeedbackUniforms(feedbackShader, feedbackUniforms, starVirtualTexture, starMesh, 2);
+		feedbackShader.set(feedbackUniforms.morphWeight, 0.0f);
+		feedbackShader.set(feedbackUniforms.model, starTransform.getModelMatrix());
+		starMesh.draw();
 
-		emissiveShader.setMat4("_Model", sunSphereTransform.getModelMatrix());
-		sunMesh.draw();
+		virtualTextureFeedback.end(virtualTextures, 2);
+		earthVirtualTexture.update();
+		starVirtualTexture.update();
+		profiler.endZone(feedbackZone);
 
 		//Render UI
 		{
+			ew::ProfileScope uiScope(profiler, uiZone);
 			ImGui_ImplGlfw_NewFrame();
 			ImGui_ImplOpenGL3_NewFrame();
 			ImGui::NewFrame();
@@ -327,14 +678,59 @@ int main() {
 
 			ImGui::SliderFloat("Spin Speed", &earthSpinSpeed, 0.0f, 360.0f);
 
+			if (ImGui::CollapsingHeader("Terrain")) {
+				ImGui::Checkbox("CDLOD Terrain", &useTerrain);
+				float heightScale = terrain.getHeightScale();
+				if (ImGui::SliderFloat("Height Scale", &heightScale, 0.0f, 0.05f, "%.4f")) {
+					terrain.setHeightScale(heightScale);
+				}
+				ImGui::Text("%d nodes, %d culled, %d triangles", terrain.getNumSelectedNodes(), terrain.getNumCulledNodes(), terrain.getNumSelectedTriangles());
+			}
+			if (ImGui::CollapsingHeader("Render Queue")) {
+				const ew::RenderQueueStats& stats = renderQueue.getStats();
+				ImGui::Text("%d draws, %d binds saved", stats.numItems, stats.getNumSaved());
+				ImGui::Text("Programs: %d bound, %d skipped", stats.state.programBinds, stats.state.programBindsSkipped);
+				ImGui::Text("Vertex arrays: %d bound, %d skipped", stats.state.vertexArrayBinds, stats.state.vertexArrayBindsSkipped);
+				ImGui::Text("Textures: %d bound, %d skipped", stats.state.textureBinds, stats.state.textureBindsSkipped);
+			}
+			if (ImGui::CollapsingHeader("Moon Trail")) {
+				ImGui::Checkbox("Show", &showMoonTrail);
+				ImGui::Text("%d points, %d deferred updates", moonTrail.getNumVertices(), moonTrail.getNumDeferredUpdates());
+			}
+			if (ImGui::CollapsingHeader("LOD")) {
+				float maxPixelError = earthLod.getMaxPixelError();
+				if (ImGui::SliderFloat("Max Pixel Error", &maxPixelError, 0.25f, 16.0f)) {
+					earthLod.setMaxPixelError(maxPixelError);
+					cloudLod.setMaxPixelError(maxPixelError);
+					starLod.setMaxPixelError(maxPixelError);
+				}
+				ImGui::Text("Earth: %d subdivisions, %d triangles", LOD_SUBDIVISIONS[earthLod.getCurrentLevel()], earthMesh.getNumIndices() / 3);
+				ImGui::Text("Clouds: %d subdivisions, %d triangles", LOD_SUBDIVISIONS[cloudLod.getCurrentLevel()], cloudMesh.getNumIndices() / 3);
+				ImGui::Text("Stars: %d subdivisions, %d triangles", LOD_SUBDIVISIONS[starLod.getCurrentLevel()], starMesh.getNumIndices() / 3);
+			}
+
 
 			ImGui::End();
+
+			ew::drawProfilerWindow(profiler);
 			
 			ImGui::Render();
 			ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 		}
 
-		glfwSwapBuffers(window);
+		profiler.endFrame();
+		if (benchmark) {
+			benchmark->endFrame();
+		}
+		else {
+			glfwSwapBuffers(window);
+		}
+	}
+	if (benchmark) {
+		ew::printBenchmarkSummary("final_terragen", benchmark->getSummary());
+		if (benchmark->writeResults("final_terragen")) {
+			printf("Wrote %s.csv and %s.json\n", benchmarkSettings.outputPath.c_str(), benchmarkSettings.outputPath.c_str());
+		}
 	}
 	printf("Shutting down...");
 }
@@ -375,4 +771,92 @@ void resetCamera(ew::Camera& camera, ew::CameraController& cameraController) {
 	cameraController.pitch = 0.0f;
 }
 
+LitUniforms getLitUniforms(const ew::Shader& shader) {
+	LitUniforms uniforms;
+	uniforms.model = shader.getUniformHandle<ew::Mat4>("_Model");
+	uniforms.ambientK = shader.getUniformHandle<float>("ambientK");
+	uniforms.diffuseK = shader.getUniformHandle<float>("diffuseK");
+	uniforms.specularK = shader.getUniformHandle<float>("specularK");
+	uniforms.shininess = shader.getUniformHandle<float>("shininess");
+	uniforms.useBlinnPhong = shader.getUniformHandle<int>("useBlinnPhong");
+	return uniforms;
+}
+
+UnlitUniforms getUnlitUniforms(const ew::Shader& shader) {
+	UnlitUniforms uniforms;
+	uniforms.model = shader.getUniformHandle<ew::Mat4>("_Model");
+	uniforms.color = shader.getUniformHandle<ew::Vec3>("_Color");
+	return uniforms;
+}
+
+FeedbackUniforms getFeedbackUniforms(const ew::Shader& shader) {
+	FeedbackUniforms uniforms;
+	uniforms.model = shader.getUniformHandle<ew::Mat4>("_Model");
+	uniforms.morphWeight = shader.getUniformHandle<float>("_MorphWeight");
+	uniforms.size = shader.getUniformHandle<ew::Vec2>("_VTSize");
+	uniforms.numLevels = shader.getUniformHandle<int>("_VTNumLevels");
+	uniforms.tileSize = shader.getUniformHandle<int>("_VTTileSize");
+	uniforms.index = shader.getUniformHandle<int>("_VTIndex");
+	uniforms.lodBias = shader.getUniformHandle<float>("_VTLodBias");
+	uniforms.vertexDecode = getVertexDecodeUniforms(shader);
+	return uniforms;
+}
+
+VertexDecodeUniforms getVertexDecodeUniforms(const ew::Shader& shader) {
+	VertexDecodeUniforms uniforms;
+	uniforms.positionScale = shader.getUniformHandle<ew::Vec3>("_PositionScale");
+	uniforms.positionOffset = shader.getUniformHandle<ew::Vec3>("_PositionOffset");
+	uniforms.octahedralNormals = shader.getUniformHandle<int>("_OctahedralNormals");
+	return uniforms;
+}
+
+//Sets the constant virtual texture layout uniforms used by sampleVirtual(). Shader must be in use.
+void setVirtualTextureUniforms(const ew::Shader& shader, const ew::VirtualTexture& virtualTexture) {
+	if (!virtualTexture.isValid())
+		return;
+	shader.setVec2("_VTSize", (float)virtualTexture.getWidth(), (float)virtualTexture.getHeight());
+	shader.setInt("_VTNumLevels", virtualTexture.getNumLevels());
+	shader.setInt("_VTTileSize", virtualTexture.getTileSize());
+	shader.setInt("_VTTileBorder", virtualTexture.getTileBorder());
+	shader.setInt("_VTAtlasTiles", virtualTexture.getAtlasTilesPerSide());
+}
 
+//Sets how a shader decodes the vertices of mesh, unless they're already set for it. Shader must be in use.
+void setVertexDecodeUniforms(const ew::Shader& shader, VertexDecodeUniforms& uniforms, const ew::Mesh& mesh) {
+	if (uniforms.mesh == &mesh)
+		return;
+	uniforms.mesh = &mesh;
+	shader.set(uniforms.positionScale, mesh.getPositionScale());
+	shader.set(uniforms.positionOffset, mesh.getPositionOffset());
+	shader.set(uniforms.octahedralNormals, mesh.getVertexFormat() != ew::VertexFormat::FLOAT);
+}
+
+//Runs the mesh optimizer on freshly generated mesh data and logs how much each pass improved it
+ew::MeshData optimized(const char* name, ew::MeshData meshData) {
+	ew::MeshOptimizationReport report = ew::optimizeMesh(meshData);
+	ew::printMeshOptimizationReport(name, report);
+	return meshData;
+}
+
+//Points the feedback shader at a virtual texture drawn on mesh. Shader must be in use.
+void setFeedbackUniforms(const ew::Shader& shader, FeedbackUniforms& uniforms, const ew::VirtualTexture& virtualTexture, const ew::Mesh& mesh, int index) {
+	setVertexDecodeUniforms(shader, uniforms.vertexDecode, mesh);
+	//Writing index 0 means "no texture", so nothing is requested for an invalid one
+	if (!virtualTexture.isValid()) {
+		shader.set(uniforms.index, 0);
+		return;
+	}
+	shader.set(uniforms.size, ew::Vec2((float)virtualTexture.getWidth(), (float)virtualTexture.getHeight()));
+	shader.set(uniforms.numLevels, virtualTexture.getNumLevels());
+	shader.set(uniforms.tileSize, virtualTexture.getTileSize());
+	shader.set(uniforms.index, index);
+}
+
+//Sets the material of a lit shader. Shader must be in use.
+void setMaterialUniforms(const ew::Shader& shader, const LitUniforms& uniforms, const Material& material) {
+	shader.set(uniforms.ambientK, material.ambientK);
+	shader.set(uniforms.diffuseK, material.diffuseK);
+	shader.set(uniforms.specularK, material.specular);
+	shader.set(uniforms.shininess, material.shininess);
+	shader.set(uniforms.useBlinnPhong, true);
+}
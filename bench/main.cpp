@@ -0,0 +1,409 @@
+//Microbenchmarks for ewMath, ew noise and the procedural mesh generators of ew and myLib (bb).
+//Usage: core_bench [--filter TEXT] [--min-time SECONDS] [--csv PATH]
+//Each benchmark reports time per operation, heap bytes and allocations per operation and, for mesh generators, vertices per second.
+//Write a CSV on two commits and compare them to see what an optimization changed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <new>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <ew/ewMath/ewMath.h>
+#include <ew/ewMath/transformations.h>
+#include <ew/transform.h>
+#include <ew/transformSystem.h>
+#include <ew/procGen.h>
+#include <ew/noise.h>
+#include <bb/procGen.h>
+
+//-----Allocation counting. Every operator new in the process goes through these.
+
+static std::atomic<size_t> s_allocatedBytes(0);
+static std::atomic<size_t> s_numAllocations(0);
+
+static void* allocate(size_t size) {
+	s_allocatedBytes += size;
+	s_numAllocations++;
+	void* p = malloc(size == 0 ? 1 : size);
+	if (p == nullptr)
+		throw std::bad_alloc();
+	return p;
+}
+static void release(void* p) {
+	free(p);
+}
+void* operator new(size_t size) {
+	return allocate(size);
+}
+void* operator new[](size_t size) {
+	return allocate(size);
+}
+void operator delete(void* p) noexcept {
+	release(p);
+}
+void operator delete[](void* p) noexcept {
+	release(p);
+}
+void operator delete(void* p, size_t) noexcept {
+	release(p);
+}
+void operator delete[](void* p, size_t) noexcept {
+	release(p);
+}
+
+//Keeps the compiler from discarding a result it can prove is unused
+template<typename T>
+static void doNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+	asm volatile("" : : "r,m"(value) : "memory");
+#else
+	static volatile char sink;
+	sink = *(const volatile char*)&value;
+#endif
+}
+
+struct BenchmarkResult {
+	std::string name;
+	double nsPerOp;
+	double bytesPerOp;
+	double allocationsPerOp;
+	double verticesPerSecond; //0 for benchmarks that produce no vertices
+};
+
+struct BenchmarkOptions {
+	const char* filter = nullptr;
+	double minTime = 0.25; //Seconds each sample runs for at least
+	const char* csvPath = nullptr;
+};
+
+//Samples per benchmark. The fastest is reported, as the one least disturbed by the rest of the system.
+const int NUM_SAMPLES = 5;
+
+/// <summary>
+/// Times run, which performs opsPerRun operations and returns the number of vertices it produced.
+/// The run count doubles until a sample takes minTime, then NUM_SAMPLES samples are taken at that count.
+/// </summary>
+static BenchmarkResult runBenchmark(const BenchmarkOptions& options, const std::string& name, int opsPerRun, const std::function<size_t()>& run) {
+	typedef std::chrono::steady_clock Clock;
+	run(); //Warm caches and lazily created state
+	int numRuns = 1;
+	for (;;)
+	{
+		Clock::time_point start = Clock::now();
+		for (int i = 0; i < numRuns; i++)
+		{
+			run();
+		}
+		double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		if (seconds >= options.minTime || numRuns >= (1 << 30))
+			break;
+		numRuns *= 2;
+	}
+
+	BenchmarkResult result = { name, 1e300, 0.0, 0.0, 0.0 };
+	for (int sample = 0; sample < NUM_SAMPLES; sample++)
+	{
+		size_t bytesBefore = s_allocatedBytes;
+		size_t allocationsBefore = s_numAllocations;
+		size_t numVertices = 0;
+		Clock::time_point start = Clock::now();
+		for (int i = 0; i < numRuns; i++)
+		{
+			numVertices += run();
+		}
+		double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		double numOps = (double)numRuns * opsPerRun;
+		double nsPerOp = seconds * 1e9 / numOps;
+		if (nsPerOp < result.nsPerOp) {
+			result.nsPerOp = nsPerOp;
+			result.verticesPerSecond = seconds > 0.0 ? numVertices / seconds : 0.0;
+		}
+		result.bytesPerOp = (s_allocatedBytes - bytesBefore) / numOps;
+		result.allocationsPerOp = (s_numAllocations - allocationsBefore) / numOps;
+	}
+	return result;
+}
+
+//-----Benchmarks
+
+//Math benchmarks run over arrays of varied inputs, so results can't be folded into constants
+const int MATH_BATCH = 1024;
+
+static float randomFloat(float min, float max) {
+	return min + (max - min) * (rand() / (float)RAND_MAX);
+}
+static ew::Vec3 randomVec3(float min, float max) {
+	return ew::Vec3(randomFloat(min, max), randomFloat(min, max), randomFloat(min, max));
+}
+
+struct Benchmark {
+	std::string name;
+	int opsPerRun;
+	std::function<size_t()> run;
+};
+
+static void addMathBenchmarks(std::vector<Benchmark>& benchmarks) {
+	//Shared inputs, filled once
+	static std::vector<ew::Mat4> matrices(MATH_BATCH);
+	static std::vector<ew::Vec3> vectorsA(MATH_BATCH);
+	static std::vector<ew::Vec3> vectorsB(MATH_BATCH);
+	static std::vector<ew::Transform> transforms(MATH_BATCH);
+	srand(1);
+	for (int i = 0; i < MATH_BATCH; i++)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			for (int r = 0; r < 4; r++)
+			{
+				matrices[i][c][r] = randomFloat(-1.0f, 1.0f);
+			}
+		}
+		vectorsA[i] = randomVec3(-10.0f, 10.0f);
+		vectorsB[i] = randomVec3(-10.0f, 10.0f);
+		transforms[i].position = randomVec3(-10.0f, 10.0f);
+		transforms[i].rotation = randomVec3(0.0f, 360.0f);
+		transforms[i].scale = randomVec3(0.5f, 2.0f);
+	}
+	static ew::TransformSystem transformSystem;
+	for (int i = 0; i < MATH_BATCH; i++)
+	{
+		transformSystem.create(transforms[i]);
+	}
+	transformSystem.update();
+
+	benchmarks.push_back({ "Mat4 multiply", MATH_BATCH, [] {
+		ew::Mat4 result = ew::Mat4(1.0f);
+		for (int i = 0; i < MATH_BATCH; i++)
+		{
+			result = matrices[i] * result;
+		}
+		doNotOptimize(result);
+		return (size_t)0;
+	} });
+	benchmarks.push_back({ "Transform::getModelMatrix", MATH_BATCH, [] {
+		for (int i = 0; i < MATH_BATCH; i++)
+		{
+			ew::Mat4 model = transforms[i].getModelMatrix();
+			doNotOptimize(model);
+		}
+		return (size_t)0;
+	} });
+	//Every transform rotated each run, then only one in 16, so the cost of dirty tracking shows
+	benchmarks.push_back({ "TransformSystem::update", MATH_BATCH, [] {
+		for (int i = 0; i < MATH_BATCH; i++)
+		{
+			transformSystem.setRotation(i, transforms[i].rotation);
+		}
+		transformSystem.update();
+		doNotOptimize(transformSystem.getModelMatrices());
+		return (size_t)0;
+	} });
+	benchmarks.push_back({ "TransformSystem::update 1/16", MATH_BATCH / 16, [] {
+		for (int i = 0; i < MATH_BATCH; i += 16)
+		{
+			transformSystem.setRotation(i, transforms[i].rotation);
+		}
+		transformSystem.update();
+		doNotOptimize(transformSystem.getModelMatrices());
+		return (size_t)0;
+	} });
+	benchmarks.push_back({ "LookAt", MATH_BATCH, [] {
+		for (int i = 0; i < MATH_BATCH; i++)
+		{
+			ew::Mat4 view = ew::LookAt(vectorsA[i], vectorsB[i], ew::Vec3(0.0f, 1.0f, 0.0f));
+			doNotOptimize(view);
+		}
+		return (size_t)0;
+	} });
+	benchmarks.push_back({ "Perspective", MATH_BATCH, [] {
+		for (int i = 0; i < MATH_BATCH; i++)
+		{
+			ew::Mat4 projection = ew::Perspective(ew::Radians(30.0f + vectorsA[i].x), 1.77f, 0.1f, 100.0f + vectorsB[i].y);
+			doNotOptimize(projection);
+		}
+		return (size_t)0;
+	} });
+	benchmarks.push_back({ "Vec3 Normalize", MATH_BATCH, [] {
+		for (int i = 0; i < MATH_BATCH; i++)
+		{
+			ew::Vec3 n = ew::Normalize(vectorsA[i]);
+			doNotOptimize(n);
+		}
+		return (size_t)0;
+	} });
+	benchmarks.push_back({ "Vec3 Cross", MATH_BATCH, [] {
+		for (int i = 0; i < MATH_BATCH; i++)
+		{
+			ew::Vec3 c = ew::Cross(vectorsA[i], vectorsB[i]);
+			doNotOptimize(c);
+		}
+		return (size_t)0;
+	} });
+}
+
+static void addNoiseBenchmarks(std::vector<Benchmark>& benchmarks) {
+	static std::vector<float> x(MATH_BATCH);
+	static std::vector<float> y(MATH_BATCH);
+	static std::vector<float> z(MATH_BATCH);
+	static std::vector<float> result(MATH_BATCH);
+	srand(1);
+	for (int i = 0; i < MATH_BATCH; i++)
+	{
+		x[i] = randomFloat(-100.0f, 100.0f);
+		y[i] = randomFloat(-100.0f, 100.0f);
+		z[i] = randomFloat(-100.0f, 100.0f);
+	}
+	static ew::FbmSettings fbmSettings;
+
+	benchmarks.push_back({ "simplexNoise", MATH_BATCH, [] {
+		for (int i = 0; i < MATH_BATCH; i++)
+		{
+			float n = ew::simplexNoise(x[i], y[i], z[i], 1);
+			doNotOptimize(n);
+		}
+		return (size_t)0;
+	} });
+	benchmarks.push_back({ "simplexNoiseBatch", MATH_BATCH, [] {
+		ew::simplexNoiseBatch(x.data(), y.data(), z.data(), result.data(), MATH_BATCH, 1);
+		doNotOptimize(result.data());
+		return (size_t)0;
+	} });
+	benchmarks.push_back({ "fbmNoise", MATH_BATCH, [] {
+		for (int i = 0; i < MATH_BATCH; i++)
+		{
+			float n = ew::fbmNoise(x[i], y[i], z[i], fbmSettings);
+			doNotOptimize(n);
+		}
+		return (size_t)0;
+	} });
+	benchmarks.push_back({ "fbmNoiseBatch", MATH_BATCH, [] {
+		ew::fbmNoiseBatch(x.data(), y.data(), z.data(), result.data(), MATH_BATCH, fbmSettings);
+		doNotOptimize(result.data());
+		return (size_t)0;
+	} });
+	benchmarks.push_back({ "fbmNoiseSphereRow", MATH_BATCH, [] {
+		ew::fbmNoiseSphereRow(1.0f, ew::TAU / (MATH_BATCH - 1), MATH_BATCH, fbmSettings, result.data());
+		doNotOptimize(result.data());
+		return (size_t)0;
+	} });
+}
+
+/// <summary>
+/// Adds one benchmark per subdivision count. Each run generates one mesh, which is one operation.
+/// </summary>
+static void addMeshBenchmarks(std::vector<Benchmark>& benchmarks, const char* name, const std::vector<int>& sweep, const std::function<ew::MeshData(int)>& generate) {
+	for (int subdivisions : sweep)
+	{
+		benchmarks.push_back({ std::string(name) + "/" + std::to_string(subdivisions), 1, [=] {
+			ew::MeshData mesh = generate(subdivisions);
+			doNotOptimize(mesh.vertices.data());
+			return mesh.vertices.size();
+		} });
+	}
+}
+
+static void addProcGenBenchmarks(std::vector<Benchmark>& benchmarks) {
+	const std::vector<int> sphereSweep = { 16, 64, 256, 640 };
+	const std::vector<int> planeSweep = { 16, 64, 256, 1024 };
+	const std::vector<int> cylinderSweep = { 16, 64, 256, 1024 };
+
+	addMeshBenchmarks(benchmarks, "ew::createSphere", sphereSweep, [](int n) { return ew::createSphere(1.0f, n); });
+	addMeshBenchmarks(benchmarks, "ew::createEarth", sphereSweep, [](int n) { return ew::createEarth(4.0f, 2.0f, 0.63f, n, 0.0f); });
+	addMeshBenchmarks(benchmarks, "ew::createEarth(noise)", sphereSweep, [](int n) { return ew::createEarth(4.0f, 2.0f, 0.63f, n, 0.01f); });
+	addMeshBenchmarks(benchmarks, "ew::createPlane", planeSweep, [](int n) { return ew::createPlane(1.0f, 1.0f, n); });
+	addMeshBenchmarks(benchmarks, "ew::createCylinder", cylinderSweep, [](int n) { return ew::createCylinder(1.0f, 1.0f, n); });
+
+	addMeshBenchmarks(benchmarks, "myLib::createSphere", sphereSweep, [](int n) { return myLib::createSphere(1.0f, n); });
+	addMeshBenchmarks(benchmarks, "myLib::createPlane", planeSweep, [](int n) { return myLib::createPlane(1.0f, 1.0f, n); });
+	addMeshBenchmarks(benchmarks, "myLib::createCylinder", cylinderSweep, [](int n) { return myLib::createCylinder(1.0f, 1.0f, n); });
+}
+
+//-----Output
+
+/// <summary>
+/// Formats a time with the unit that keeps it readable
+/// </summary>
+static std::string formatTime(double ns) {
+	char text[32];
+	if (ns < 1e3) {
+		snprintf(text, sizeof(text), "%.2f ns", ns);
+	}
+	else if (ns < 1e6) {
+		snprintf(text, sizeof(text), "%.2f us", ns / 1e3);
+	}
+	else {
+		snprintf(text, sizeof(text), "%.2f ms", ns / 1e6);
+	}
+	return text;
+}
+
+static bool writeCsv(const char* path, const std::vector<BenchmarkResult>& results) {
+	FILE* file = fopen(path, "w");
+	if (file == NULL) {
+		printf("Failed to open %s\n", path);
+		return false;
+	}
+	fprintf(file, "name,ns_per_op,bytes_per_op,allocations_per_op,vertices_per_second\n");
+	for (const BenchmarkResult& result : results)
+	{
+		fprintf(file, "\"%s\",%.3f,%.1f,%.3f,%.0f\n", result.name.c_str(), result.nsPerOp, result.bytesPerOp, result.allocationsPerOp, result.verticesPerSecond);
+	}
+	fclose(file);
+	return true;
+}
+
+int main(int argc, char** argv) {
+	BenchmarkOptions options;
+	for (int i = 1; i < argc; i++)
+	{
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (strcmp(argv[i], "--filter") == 0 && value != nullptr) {
+			options.filter = value;
+			i++;
+		}
+		else if (strcmp(argv[i], "--min-time") == 0 && value != nullptr) {
+			options.minTime = atof(value);
+			i++;
+		}
+		else if (strcmp(argv[i], "--csv") == 0 && value != nullptr) {
+			options.csvPath = value;
+			i++;
+		}
+		else {
+			printf("Usage: %s [--filter TEXT] [--min-time SECONDS] [--csv PATH]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	std::vector<Benchmark> benchmarks;
+	addMathBenchmarks(benchmarks);
+	addNoiseBenchmarks(benchmarks);
+	addProcGenBenchmarks(benchmarks);
+
+	printf("%-32s %12s %14s %12s %16s\n", "Benchmark", "Time/op", "Bytes/op", "Allocs/op", "Vertices/s");
+	std::vector<BenchmarkResult> results;
+	for (const Benchmark& benchmark : benchmarks)
+	{
+		if (options.filter != nullptr && benchmark.name.find(options.filter) == std::string::npos)
+			continue;
+		BenchmarkResult result = runBenchmark(options, benchmark.name, benchmark.opsPerRun, benchmark.run);
+		if (result.verticesPerSecond > 0.0) {
+			printf("%-32s %12s %14.0f %12.2f %16.0f\n", result.name.c_str(), formatTime(result.nsPerOp).c_str(), result.bytesPerOp, result.allocationsPerOp, result.verticesPerSecond);
+		}
+		else {
+			printf("%-32s %12s %14.0f %12.2f %16s\n", result.name.c_str(), formatTime(result.nsPerOp).c_str(), result.bytesPerOp, result.allocationsPerOp, "-");
+		}
+		fflush(stdout);
+		results.push_back(result);
+	}
+	if (options.csvPath != nullptr && writeCsv(options.csvPath, results)) {
+		printf("Wrote %s\n", options.csvPath);
+	}
+	return 0;
+}
@@ -1,29 +1,38 @@
 #include "procGen.h"
+#include "../ew/noise.h"
 #include <cmath>
-#include <cstdlib>
+#include <vector>
 
 namespace myLib {
-	ew::MeshData myLib::createSphere(float radius, int numSegments)
+	ew::MeshData createSphere(float radius, int numSegments)
 	{
 		ew::MeshData sphereData;
 
 		float thetaStep = 2 * 3.1415f / numSegments;
 		float phiStep = 3.1415f / numSegments;
 
+		//Bumps of up to 10 units, the same on every run
+		ew::FbmSettings noiseSettings;
+		noiseSettings.seed = 1;
+		noiseSettings.octaves = 4;
+		noiseSettings.frequency = 2.0f;
+		std::vector<float> rowNoise(numSegments + 1);
+
 		for (int row = 0; row <= numSegments; row++) 
 		{
 			//First and last row converge at poles
 			float phi = row * phiStep;
+			ew::fbmNoiseSphereRow(phi, thetaStep, numSegments + 1, noiseSettings, rowNoise.data());
 			for (int col = 0; col <= numSegments; col++) {//Duplicate column for each row
 				float theta = (float)col * thetaStep;
 
 				ew::Vertex v;
 
-				srand((unsigned)time(0));
+				float displacement = (rowNoise[col] * 0.5f + 0.5f) * 10.0f;
 
-				v.pos.x = ((rand() % 10) + radius) * cos(theta) * sin(phi);
-				v.pos.y = ((rand() % 10) + radius) * cos(phi);
-				v.pos.z = ((rand() % 10) + radius) * sin(theta) * sin(phi);
+				v.pos.x = (displacement + radius) * cos(theta) * sin(phi);
+				v.pos.y = (displacement + radius) * cos(phi);
+				v.pos.z = (displacement + radius) * sin(theta) * sin(phi);
 
 				v.normal = ew::Normalize(ew::Vec3(cos(theta) * sin(phi), cos(phi), sin(theta) * sin(phi)));
 
@@ -56,7 +65,7 @@ namespace myLib {
 		return sphereData;
 	}
 
-	ew::MeshData myLib::createCylinder(float height, float radius, int numSegments)
+	ew::MeshData createCylinder(float height, float radius, int numSegments)
 	{
         ew::MeshData cylinderData;
 
@@ -187,7 +196,7 @@ namespace myLib {
         return cylinderData;
 	}
 
-	ew::MeshData myLib::createPlane(float width, float height, int subdivisions)
+	ew::MeshData createPlane(float width, float height, int subdivisions)
 	{
 		ew::MeshData planeData;
 
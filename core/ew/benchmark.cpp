@@ -0,0 +1,280 @@
+#include "benchmark.h"
+#include "renderStats.h"
+#include "external/glad.h"
+#include <GLFW/glfw3.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+namespace ew {
+	/// <summary>
+	/// Reads --bench, --frames N, --warmup N, --size WIDTHxHEIGHT and --out PATH. Other arguments are ignored.
+	/// </summary>
+	BenchmarkSettings parseBenchmarkArgs(int argc, char** argv)
+	{
+		BenchmarkSettings settings;
+		for (int i = 1; i < argc; i++)
+		{
+			const char* arg = argv[i];
+			const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+			if (strcmp(arg, "--bench") == 0) {
+				settings.enabled = true;
+			}
+			else if (strcmp(arg, "--frames") == 0 && value != nullptr) {
+				settings.numFrames = std::max(1, atoi(value));
+				i++;
+			}
+			else if (strcmp(arg, "--warmup") == 0 && value != nullptr) {
+				settings.warmupFrames = std::max(0, atoi(value));
+				i++;
+			}
+			else if (strcmp(arg, "--size") == 0 && value != nullptr) {
+				int width, height;
+				if (sscanf(value, "%dx%d", &width, &height) == 2 && width > 0 && height > 0) {
+					settings.width = width;
+					settings.height = height;
+				}
+				else {
+					printf("Ignoring benchmark size %s, expected WIDTHxHEIGHT\n", value);
+				}
+				i++;
+			}
+			else if (strcmp(arg, "--out") == 0 && value != nullptr) {
+				settings.outputPath = value;
+				i++;
+			}
+		}
+		return settings;
+	}
+
+	/// <summary>
+	/// Creates a hidden window with vsync off, to own the GL context of a benchmark run. glfwInit must have been called.
+	/// Falls back from the native context API to EGL, then OSMesa, so software drivers such as Mesa llvmpipe work on machines without a GPU.
+	/// GLFW 3.3 still needs a display server, so on a headless box run under a virtual one (xvfb-run).
+	/// </summary>
+	GLFWwindow* createBenchmarkWindow(const BenchmarkSettings& settings, const char* title)
+	{
+		const int contextApis[] = { GLFW_NATIVE_CONTEXT_API, GLFW_EGL_CONTEXT_API, GLFW_OSMESA_CONTEXT_API };
+		GLFWwindow* window = nullptr;
+		for (int contextApi : contextApis)
+		{
+			glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+			glfwWindowHint(GLFW_CONTEXT_CREATION_API, contextApi);
+			window = glfwCreateWindow(settings.width, settings.height, title, NULL, NULL);
+			if (window != nullptr)
+				break;
+		}
+		glfwDefaultWindowHints();
+		if (window == nullptr)
+			return nullptr;
+		glfwMakeContextCurrent(window);
+		glfwSwapInterval(0);
+		return window;
+	}
+
+	/// <summary>
+	/// Uniform Catmull-Rom spline from p1 (t = 0) to p2 (t = 1)
+	/// </summary>
+	static ew::Vec3 catmullRom(const ew::Vec3& p0, const ew::Vec3& p1, const ew::Vec3& p2, const ew::Vec3& p3, float t) {
+		float t2 = t * t;
+		float t3 = t2 * t;
+		return (p1 * 2.0f + (p2 - p0) * t + (p0 * 2.0f - p1 * 5.0f + p2 * 4.0f - p3) * t2 + (p1 * 3.0f - p0 - p2 * 3.0f + p3) * t3) * 0.5f;
+	}
+
+	/// <summary>
+	/// Moves the camera along a smooth curve through the keyframes, which must be sorted by time.
+	/// Before the first and after the last keyframe the camera holds still.
+	/// </summary>
+	void evaluateCameraPath(const CameraKeyframe* keyframes, int numKeyframes, float time, ew::Camera& camera)
+	{
+		if (numKeyframes <= 0)
+			return;
+		if (time <= keyframes[0].time || numKeyframes == 1) {
+			camera.position = keyframes[0].position;
+			camera.target = keyframes[0].target;
+			return;
+		}
+		int last = numKeyframes - 1;
+		if (time >= keyframes[last].time) {
+			camera.position = keyframes[last].position;
+			camera.target = keyframes[last].target;
+			return;
+		}
+		int i = 0;
+		while (time > keyframes[i + 1].time)
+		{
+			i++;
+		}
+		const CameraKeyframe& k0 = keyframes[std::max(i - 1, 0)];
+		const CameraKeyframe& k1 = keyframes[i];
+		const CameraKeyframe& k2 = keyframes[i + 1];
+		const CameraKeyframe& k3 = keyframes[std::min(i + 2, last)];
+		float t = (time - k1.time) / (k2.time - k1.time);
+		camera.position = catmullRom(k0.position, k1.position, k2.position, k3.position, t);
+		camera.target = catmullRom(k0.target, k1.target, k2.target, k3.target, t);
+	}
+
+	/// <summary>
+	/// Creates the offscreen color and depth target. Needs a current GL context.
+	/// </summary>
+	Benchmark::Benchmark(const BenchmarkSettings& settings)
+		:m_settings(settings)
+	{
+		glGenRenderbuffers(1, &m_colorBuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, m_colorBuffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, settings.width, settings.height);
+		glGenRenderbuffers(1, &m_depthBuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, m_depthBuffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, settings.width, settings.height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+		glGenFramebuffers(1, &m_fbo);
+		glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_colorBuffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthBuffer);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			printf("Benchmark framebuffer incomplete\n");
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		m_frames.reserve(settings.numFrames);
+	}
+	Benchmark::~Benchmark()
+	{
+		glDeleteFramebuffers(1, &m_fbo);
+		glDeleteRenderbuffers(1, &m_colorBuffer);
+		glDeleteRenderbuffers(1, &m_depthBuffer);
+	}
+
+	/// <summary>
+	/// Binds the offscreen target and starts counting
+	/// </summary>
+	void Benchmark::beginFrame()
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+		glViewport(0, 0, m_settings.width, m_settings.height);
+		resetRenderStats();
+		m_frameStart = std::chrono::steady_clock::now();
+	}
+
+	/// <summary>
+	/// Waits for the GPU to finish the frame, so its time covers the work it queued, and records it unless warming up
+	/// </summary>
+	void Benchmark::endFrame()
+	{
+		glFinish();
+		float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_frameStart).count();
+		if (!isWarmingUp()) {
+			const RenderStats& stats = getRenderStats();
+			m_frames.push_back({ ms, stats.drawCalls, stats.triangles, stats.uploadBytes });
+		}
+		m_frame++;
+	}
+
+	/// <summary>
+	/// Nearest rank percentile of sorted values
+	/// </summary>
+	static float percentile(const std::vector<float>& sorted, float p) {
+		size_t rank = (size_t)ceil(p / 100.0 * sorted.size());
+		rank = rank < 1 ? 1 : (rank > sorted.size() ? sorted.size() : rank);
+		return sorted[rank - 1];
+	}
+
+	BenchmarkSummary Benchmark::getSummary()const
+	{
+		BenchmarkSummary summary;
+		summary.numFrames = (int)m_frames.size();
+		if (m_frames.empty())
+			return summary;
+		std::vector<float> times;
+		times.reserve(m_frames.size());
+		double totalMs = 0.0;
+		for (const BenchmarkFrame& frame : m_frames)
+		{
+			times.push_back(frame.ms);
+			totalMs += frame.ms;
+			summary.meanDrawCalls += (double)frame.drawCalls;
+			summary.meanTriangles += (double)frame.triangles;
+			summary.totalUploadBytes += frame.uploadBytes;
+		}
+		std::sort(times.begin(), times.end());
+		summary.minMs = times.front();
+		summary.maxMs = times.back();
+		summary.meanMs = (float)(totalMs / times.size());
+		summary.p50Ms = percentile(times, 50.0f);
+		summary.p90Ms = percentile(times, 90.0f);
+		summary.p95Ms = percentile(times, 95.0f);
+		summary.p99Ms = percentile(times, 99.0f);
+		summary.meanDrawCalls /= m_frames.size();
+		summary.meanTriangles /= m_frames.size();
+		return summary;
+	}
+
+	/// <summary>
+	/// Writes a JSON string with quotes and backslashes escaped
+	/// </summary>
+	static void writeJsonString(FILE* file, const char* value) {
+		fputc('"', file);
+		for (const char* c = value; *c != '\0'; c++)
+		{
+			if (*c == '"' || *c == '\\') {
+				fputc('\\', file);
+			}
+			fputc(*c, file);
+		}
+		fputc('"', file);
+	}
+
+	/// <summary>
+	/// Writes every recorded frame to outputPath.csv and the summary, settings and GL driver to outputPath.json
+	/// </summary>
+	/// <param name="name">Name of the scene, recorded in the JSON</param>
+	bool Benchmark::writeResults(const char* name)const
+	{
+		std::string csvPath = m_settings.outputPath + ".csv";
+		FILE* csv = fopen(csvPath.c_str(), "w");
+		if (csv == NULL) {
+			printf("Failed to open %s\n", csvPath.c_str());
+			return false;
+		}
+		fprintf(csv, "frame,ms,draw_calls,triangles,upload_bytes\n");
+		for (size_t i = 0; i < m_frames.size(); i++)
+		{
+			const BenchmarkFrame& frame = m_frames[i];
+			fprintf(csv, "%zu,%.4f,%lld,%lld,%lld\n", i, frame.ms, (long long)frame.drawCalls, (long long)frame.triangles, (long long)frame.uploadBytes);
+		}
+		fclose(csv);
+
+		std::string jsonPath = m_settings.outputPath + ".json";
+		FILE* json = fopen(jsonPath.c_str(), "w");
+		if (json == NULL) {
+			printf("Failed to open %s\n", jsonPath.c_str());
+			return false;
+		}
+		BenchmarkSummary summary = getSummary();
+		fprintf(json, "{\n\t\"name\": ");
+		writeJsonString(json, name);
+		fprintf(json, ",\n\t\"renderer\": ");
+		writeJsonString(json, (const char*)glGetString(GL_RENDERER));
+		fprintf(json, ",\n\t\"version\": ");
+		writeJsonString(json, (const char*)glGetString(GL_VERSION));
+		fprintf(json, ",\n\t\"width\": %d,\n\t\"height\": %d,\n", m_settings.width, m_settings.height);
+		fprintf(json, "\t\"frames\": %d,\n\t\"warmup_frames\": %d,\n\t\"timestep\": %g,\n", summary.numFrames, m_settings.warmupFrames, m_settings.timestep);
+		fprintf(json, "\t\"frame_ms\": { \"min\": %.4f, \"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f },\n",
+			summary.minMs, summary.meanMs, summary.p50Ms, summary.p90Ms, summary.p95Ms, summary.p99Ms, summary.maxMs);
+		fprintf(json, "\t\"draw_calls_per_frame\": %.2f,\n\t\"triangles_per_frame\": %.0f,\n", summary.meanDrawCalls, summary.meanTriangles);
+		fprintf(json, "\t\"upload_bytes\": %lld,\n\t\"upload_bytes_per_frame\": %.0f\n}\n",
+			(long long)summary.totalUploadBytes, summary.numFrames > 0 ? (double)summary.totalUploadBytes / summary.numFrames : 0.0);
+		fclose(json);
+		return true;
+	}
+
+	void printBenchmarkSummary(const char* name, const BenchmarkSummary& summary)
+	{
+		printf("%s: %d frames, %.3f ms mean, p50 %.3f, p90 %.3f, p95 %.3f, p99 %.3f, max %.3f\n",
+			name, summary.numFrames, summary.meanMs, summary.p50Ms, summary.p90Ms, summary.p95Ms, summary.p99Ms, summary.maxMs);
+		printf("  %.1f draw calls, %.0f triangles per frame, %lld bytes uploaded\n",
+			summary.meanDrawCalls, summary.meanTriangles, (long long)summary.totalUploadBytes);
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "camera.h"
+
+struct GLFWwindow;
+
+namespace ew {
+	//Parsed from the command line by parseBenchmarkArgs
+	struct BenchmarkSettings {
+		bool enabled = false; //--bench
+		int width = 1280; //--size WIDTHxHEIGHT
+		int height = 720;
+		int numFrames = 600; //--frames N, recorded frames
+		int warmupFrames = 60; //--warmup N, rendered first and not recorded, so shader compilation and streaming settle
+		float timestep = 1.0f / 60.0f; //Simulated seconds per frame, independent of how long frames take
+		std::string outputPath = "benchmark"; //--out PATH, results go to PATH.csv and PATH.json
+	};
+
+	BenchmarkSettings parseBenchmarkArgs(int argc, char** argv);
+	GLFWwindow* createBenchmarkWindow(const BenchmarkSettings& settings, const char* title);
+
+	//Camera position and target at a point in simulated time
+	struct CameraKeyframe {
+		float time;
+		ew::Vec3 position;
+		ew::Vec3 target;
+	};
+	void evaluateCameraPath(const CameraKeyframe* keyframes, int numKeyframes, float time, ew::Camera& camera);
+
+	struct BenchmarkFrame {
+		float ms; //CPU submission plus GPU completion, since the frame ends with glFinish
+		int64_t drawCalls;
+		int64_t triangles;
+		int64_t uploadBytes;
+	};
+
+	struct BenchmarkSummary {
+		int numFrames = 0;
+		float minMs = 0.0f, meanMs = 0.0f, maxMs = 0.0f;
+		float p50Ms = 0.0f, p90Ms = 0.0f, p95Ms = 0.0f, p99Ms = 0.0f;
+		double meanDrawCalls = 0.0;
+		double meanTriangles = 0.0;
+		int64_t totalUploadBytes = 0;
+	};
+
+	/// <summary>
+	/// Renders a fixed number of frames into an offscreen framebuffer at a fixed size and simulated timestep,
+	/// recording the time, draw calls and upload bytes of each, so runs are repeatable without a visible window or vsync.
+	/// Usage: while (benchmark.isRunning()) { benchmark.beginFrame(); update with getTime()/getTimestep(); draw; benchmark.endFrame(); }
+	/// </summary>
+	class Benchmark {
+	public:
+		Benchmark(const BenchmarkSettings& settings);
+		~Benchmark();
+		Benchmark(const Benchmark&) = delete;
+		Benchmark& operator=(const Benchmark&) = delete;
+		void beginFrame();
+		void endFrame();
+		inline bool isRunning()const { return m_frame < m_settings.warmupFrames + m_settings.numFrames; }
+		inline bool isWarmingUp()const { return m_frame < m_settings.warmupFrames; }
+		inline float getTime()const { return m_frame * m_settings.timestep; }
+		inline float getTimestep()const { return m_settings.timestep; }
+		inline unsigned int getFramebuffer()const { return m_fbo; }
+		inline const std::vector<BenchmarkFrame>& getFrames()const { return m_frames; }
+		BenchmarkSummary getSummary()const;
+		bool writeResults(const char* name)const;
+	private:
+		BenchmarkSettings m_settings;
+		unsigned int m_fbo = 0;
+		unsigned int m_colorBuffer = 0;
+		unsigned int m_depthBuffer = 0;
+		int m_frame = 0;
+		std::chrono::steady_clock::time_point m_frameStart;
+		std::vector<BenchmarkFrame> m_frames;
+	};
+
+	void printBenchmarkSummary(const char* name, const BenchmarkSummary& summary);
+}
@@ -0,0 +1,207 @@
+#include "cdlodTerrain.h"
+#include <float.h>
+#include <math.h>
+#include "meshOptimizer.h"
+
+namespace ew {
+	//Outward normal, right and up axis of each cube face. right x up = normal, so grids wind counter clockwise seen from outside.
+	static const ew::Vec3 FACE_AXES[6][3] = {
+		{ ew::Vec3(1, 0, 0), ew::Vec3(0, 0, -1), ew::Vec3(0, 1, 0) },
+		{ ew::Vec3(-1, 0, 0), ew::Vec3(0, 0, 1), ew::Vec3(0, 1, 0) },
+		{ ew::Vec3(0, 1, 0), ew::Vec3(1, 0, 0), ew::Vec3(0, 0, -1) },
+		{ ew::Vec3(0, -1, 0), ew::Vec3(1, 0, 0), ew::Vec3(0, 0, 1) },
+		{ ew::Vec3(0, 0, 1), ew::Vec3(1, 0, 0), ew::Vec3(0, 1, 0) },
+		{ ew::Vec3(0, 0, -1), ew::Vec3(-1, 0, 0), ew::Vec3(0, 1, 0) }
+	};
+
+	TerrainUniforms getTerrainUniforms(const ew::Shader& shader) {
+		TerrainUniforms uniforms;
+		uniforms.faceNormal = shader.getUniformHandle<ew::Vec3>("_FaceNormal");
+		uniforms.faceRight = shader.getUniformHandle<ew::Vec3>("_FaceRight");
+		uniforms.faceUp = shader.getUniformHandle<ew::Vec3>("_FaceUp");
+		uniforms.nodeOffset = shader.getUniformHandle<ew::Vec2>("_NodeOffset");
+		uniforms.nodeSize = shader.getUniformHandle<float>("_NodeSize");
+		uniforms.gridSize = shader.getUniformHandle<float>("_GridSize");
+		uniforms.morphRange = shader.getUniformHandle<ew::Vec2>("_MorphRange");
+		uniforms.radius = shader.getUniformHandle<float>("_Radius");
+		uniforms.heightScale = shader.getUniformHandle<float>("_HeightScale");
+		return uniforms;
+	}
+
+	/// <summary>
+	/// Flat grid of subdivisions x subdivisions quads, positions and UVs from 0 to 1 in x and y
+	/// </summary>
+	static MeshData createGrid(int subdivisions) {
+		MeshData mesh;
+		int columns = subdivisions + 1;
+		mesh.vertices.resize((size_t)columns * columns);
+		for (int row = 0; row <= subdivisions; row++)
+		{
+			for (int col = 0; col <= subdivisions; col++)
+			{
+				Vertex& v = mesh.vertices[row * columns + col];
+				v.uv = ew::Vec2((float)col / subdivisions, (float)row / subdivisions);
+				v.pos = ew::Vec3(v.uv.x, v.uv.y, 0.0f);
+				v.normal = ew::Vec3(0.0f, 0.0f, 1.0f);
+			}
+		}
+		mesh.indices.reserve((size_t)subdivisions * subdivisions * 6);
+		for (int row = 0; row < subdivisions; row++)
+		{
+			for (int col = 0; col < subdivisions; col++)
+			{
+				unsigned int start = row * columns + col;
+				mesh.indices.insert(mesh.indices.end(), { start, start + 1, start + columns + 1 });
+				mesh.indices.insert(mesh.indices.end(), { start, start + columns + 1, start + columns });
+			}
+		}
+		optimizeMesh(mesh);
+		return mesh;
+	}
+
+	/// <summary>
+	/// Point on the unit sphere for face coordinates (x, y) of a cube face
+	/// </summary>
+	static ew::Vec3 faceToSphere(int face, float x, float y) {
+		return ew::Normalize(FACE_AXES[face][0] + FACE_AXES[face][1] * x + FACE_AXES[face][2] * y);
+	}
+
+	/// <param name="radius">Radius of the undisplaced sphere</param>
+	/// <param name="heightScale">Largest displacement from the sphere the vertex shader may apply</param>
+	/// <param name="numLevels">Quadtree depth. Finest nodes are 2^(numLevels-1) times smaller than a face.</param>
+	/// <param name="gridSize">Quads per node side, must be even</param>
+	CdlodTerrain::CdlodTerrain(float radius, float heightScale, int numLevels, int gridSize)
+		:m_radius(radius), m_heightScale(heightScale), m_gridSize(gridSize)
+	{
+		m_numLevels = numLevels < 1 ? 1 : (numLevels > CDLOD_MAX_LEVELS ? CDLOD_MAX_LEVELS : numLevels);
+		//Each level reaches twice as far as the next finer one. A face is 2 units wide in face coordinates,
+		//and a face coordinate unit is at most radius long on the sphere.
+		float leafSize = 2.0f * radius / (float)(1 << (m_numLevels - 1));
+		for (int i = 0; i < m_numLevels; i++)
+		{
+			m_lodRanges[i] = CDLOD_LEAF_RANGE_FACTOR * leafSize * (float)(1 << i);
+		}
+		//Whole faces are always drawn at some level
+		m_lodRanges[m_numLevels - 1] = FLT_MAX;
+
+		m_grid.load(createGrid(gridSize));
+		m_halfGrid.load(createGrid(gridSize / 2));
+	}
+
+	/// <summary>
+	/// World space bounding sphere of a node's surface, including the largest displacement
+	/// </summary>
+	BoundingSphere CdlodTerrain::getNodeBounds(const Node& node, const ew::Mat4& model)const
+	{
+		//Corners, edge midpoints and center
+		ew::Vec3 points[9];
+		ew::Vec3 sum = ew::Vec3(0.0f);
+		for (int i = 0; i < 9; i++)
+		{
+			points[i] = faceToSphere(node.face, node.x + node.size * 0.5f * (i % 3), node.y + node.size * 0.5f * (i / 3)) * m_radius;
+			sum += points[i];
+		}
+		ew::Vec3 center = sum / 9.0f;
+		float radius = 0.0f;
+		for (int i = 0; i < 9; i++)
+		{
+			float distance = ew::Magnitude(points[i] - center);
+			radius = distance > radius ? distance : radius;
+		}
+		//The sphere bulges out between sample points, which are at most half the node size (in radians) apart
+		radius += m_radius * (1.0f - cosf(node.size * 0.5f)) + m_heightScale;
+		return transformBoundingSphere(model, center, radius);
+	}
+
+	/// <summary>
+	/// Adds node, or its children, to the selection.
+	/// Returns false if node is out of its level's range, so the parent has to cover its area.
+	/// </summary>
+	bool CdlodTerrain::selectNode(const Node& node, const ew::Vec3& cameraPosition, const Frustum& frustum, const ew::Mat4& model)
+	{
+		BoundingSphere bounds = getNodeBounds(node, model);
+		float distance = ew::Magnitude(bounds.center - cameraPosition) - bounds.radius;
+		if (distance > m_lodRanges[node.level])
+			return false;
+		if (!isSphereInFrustum(frustum, bounds)) {
+			m_numCulledNodes++;
+			return true;
+		}
+		if (node.level == 0 || distance > m_lodRanges[node.level - 1]) {
+			m_selection.push_back({ node, false });
+			return true;
+		}
+		float childSize = node.size * 0.5f;
+		for (int i = 0; i < 4; i++)
+		{
+			Node child = { node.face, node.level - 1, node.x + childSize * (i % 2), node.y + childSize * (i / 2), childSize };
+			if (selectNode(child, cameraPosition, frustum, model))
+				continue;
+			//Child is too far for the finer level; cover it with this node's resolution instead
+			if (!isSphereInFrustum(frustum, getNodeBounds(child, model))) {
+				m_numCulledNodes++;
+				continue;
+			}
+			child.level = node.level;
+			m_selection.push_back({ child, true });
+		}
+		return true;
+	}
+
+	/// <summary>
+	/// Selects the nodes to draw this frame from the camera position and frustum.
+	/// model places the terrain in the world; it may rotate and translate, but not scale.
+	/// </summary>
+	void CdlodTerrain::select(const ew::Camera& camera, const ew::Mat4& model)
+	{
+		m_selection.clear();
+		m_numCulledNodes = 0;
+
+		Frustum frustum = extractFrustum(camera.ProjectionMatrix() * camera.ViewMatrix());
+		for (int face = 0; face < 6; face++)
+		{
+			Node root = { face, m_numLevels - 1, -1.0f, -1.0f, 2.0f };
+			selectNode(root, camera.position, frustum, model);
+		}
+	}
+
+	/// <summary>
+	/// Draws the selected nodes. Shader must be in use and have its model matrix set.
+	/// </summary>
+	void CdlodTerrain::draw(const ew::Shader& shader, const TerrainUniforms& uniforms)const
+	{
+		shader.set(uniforms.radius, m_radius);
+		shader.set(uniforms.heightScale, m_heightScale);
+		for (const SelectedNode& selected : m_selection)
+		{
+			const Node& node = selected.node;
+			shader.set(uniforms.faceNormal, FACE_AXES[node.face][0]);
+			shader.set(uniforms.faceRight, FACE_AXES[node.face][1]);
+			shader.set(uniforms.faceUp, FACE_AXES[node.face][2]);
+			shader.set(uniforms.nodeOffset, ew::Vec2(node.x, node.y));
+			shader.set(uniforms.nodeSize, node.size);
+			shader.set(uniforms.gridSize, (float)(selected.isQuarter ? m_gridSize / 2 : m_gridSize));
+			//Morph into the next coarser level over the last part of this level's range
+			float morphEnd = m_lodRanges[node.level];
+			float prevRange = node.level > 0 ? m_lodRanges[node.level - 1] : 0.0f;
+			shader.set(uniforms.morphRange, ew::Vec2(prevRange + (morphEnd - prevRange) * CDLOD_MORPH_START_RATIO, morphEnd));
+			if (selected.isQuarter) {
+				m_halfGrid.draw();
+			}
+			else {
+				m_grid.draw();
+			}
+		}
+	}
+
+	int CdlodTerrain::getNumSelectedTriangles()const
+	{
+		int numTriangles = 0;
+		for (const SelectedNode& selected : m_selection)
+		{
+			int gridSize = selected.isQuarter ? m_gridSize / 2 : m_gridSize;
+			numTriangles += gridSize * gridSize * 2;
+		}
+		return numTriangles;
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <vector>
+#include "mesh.h"
+#include "shader.h"
+#include "camera.h"
+#include "frustum.h"
+
+namespace ew {
+	constexpr int CDLOD_MAX_LEVELS = 20;
+	//LOD range of the finest level, in multiples of a finest level node's size. Large enough that neighboring nodes differ by at most one level
+	//and a coarser neighbor has not started morphing where they meet.
+	constexpr float CDLOD_LEAF_RANGE_FACTOR = 5.0f;
+	//Fraction of a level's range after which its vertices start morphing into the next coarser level
+	constexpr float CDLOD_MORPH_START_RATIO = 0.66f;
+
+	//Uniforms read by a CDLOD terrain vertex shader (see assets/terrain.vert)
+	struct TerrainUniforms {
+		ew::UniformHandle<ew::Vec3> faceNormal;
+		ew::UniformHandle<ew::Vec3> faceRight;
+		ew::UniformHandle<ew::Vec3> faceUp;
+		ew::UniformHandle<ew::Vec2> nodeOffset;
+		ew::UniformHandle<float> nodeSize;
+		ew::UniformHandle<float> gridSize;
+		ew::UniformHandle<ew::Vec2> morphRange;
+		ew::UniformHandle<float> radius;
+		ew::UniformHandle<float> heightScale;
+	};
+	TerrainUniforms getTerrainUniforms(const ew::Shader& shader);
+
+	/// <summary>
+	/// Planet terrain rendered as six cube face quadtrees projected onto a sphere (continuous distance-dependent LOD).
+	/// Every selected node draws the same small grid mesh, which the vertex shader places on the sphere, displaces by the height function
+	/// and morphs into the next coarser level towards the end of the node's LOD range, so neighboring levels meet without cracks.
+	/// Nodes are selected and frustum culled on the CPU each frame.
+	/// </summary>
+	class CdlodTerrain {
+	public:
+		CdlodTerrain(float radius, float heightScale, int numLevels = 10, int gridSize = 32);
+		void select(const ew::Camera& camera, const ew::Mat4& model);
+		void draw(const ew::Shader& shader, const TerrainUniforms& uniforms)const;
+		inline int getNumLevels()const { return m_numLevels; }
+		inline int getGridSize()const { return m_gridSize; }
+		inline float getRadius()const { return m_radius; }
+		inline float getHeightScale()const { return m_heightScale; }
+		inline void setHeightScale(float heightScale) { m_heightScale = heightScale; }
+		inline float getLodRange(int level)const { return m_lodRanges[level]; }
+		inline int getNumSelectedNodes()const { return (int)m_selection.size(); }
+		inline int getNumCulledNodes()const { return m_numCulledNodes; }
+		int getNumSelectedTriangles()const;
+	private:
+		//Node of a face quadtree, in face coordinates (-1 to 1 on both axes)
+		struct Node {
+			int face;
+			int level; //0 is the finest level, m_numLevels - 1 is a whole face
+			float x, y; //Minimum corner
+			float size;
+		};
+		struct SelectedNode {
+			Node node;
+			bool isQuarter; //Quarter of a coarser node, drawn with the half resolution grid
+		};
+		bool selectNode(const Node& node, const ew::Vec3& cameraPosition, const Frustum& frustum, const ew::Mat4& model);
+		BoundingSphere getNodeBounds(const Node& node, const ew::Mat4& model)const;
+
+		float m_radius;
+		float m_heightScale; //Largest displacement from the sphere
+		int m_numLevels;
+		int m_gridSize; //Quads per node side
+		float m_lodRanges[CDLOD_MAX_LEVELS];
+		Mesh m_grid; //gridSize x gridSize quads over 0-1
+		Mesh m_halfGrid; //gridSize/2 x gridSize/2 quads, for nodes drawn as a quarter of their parent
+		std::vector<SelectedNode> m_selection;
+		int m_numCulledNodes = 0;
+	};
+}
@@ -0,0 +1,249 @@
+#include "dynamicMesh.h"
+#include "renderStats.h"
+#include "external/glad.h"
+#include <string.h>
+#include <stdio.h>
+
+namespace ew {
+	/// <summary>
+	/// Creates buffers large enough for maxVertices and maxIndices
+	/// </summary>
+	/// <param name="maxVertices">Vertex capacity</param>
+	/// <param name="maxIndices">Index capacity</param>
+	/// <param name="usage">STREAM for per-frame updates through persistently mapped memory</param>
+	DynamicMesh::DynamicMesh(int maxVertices, int maxIndices, MeshUsage usage)
+		:m_usage(usage), m_maxVertices(maxVertices), m_maxIndices(maxIndices)
+	{
+		m_numRegions = usage == MeshUsage::STREAM ? DYNAMIC_MESH_REGIONS : 1;
+		m_vertices.resize(maxVertices);
+		m_indices.resize(maxIndices);
+
+		glGenVertexArrays(1, &m_vao);
+		glBindVertexArray(m_vao);
+
+		glGenBuffers(1, &m_vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+
+		glGenBuffers(1, &m_ebo);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+
+		//Zero sized storage is an error, and point meshes may have no indices
+		GLsizeiptr vertexBytes = sizeof(Vertex) * (maxVertices > 0 ? maxVertices : 1) * m_numRegions;
+		GLsizeiptr indexBytes = sizeof(unsigned int) * (maxIndices > 0 ? maxIndices : 1) * m_numRegions;
+		if (usage == MeshUsage::STREAM) {
+			//Immutable storage that stays mapped for the lifetime of the mesh
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(GL_ARRAY_BUFFER, vertexBytes, NULL, flags);
+			glBufferStorage(GL_ELEMENT_ARRAY_BUFFER, indexBytes, NULL, flags);
+			m_mappedVertices = (Vertex*)glMapBufferRange(GL_ARRAY_BUFFER, 0, vertexBytes, flags);
+			m_mappedIndices = (unsigned int*)glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0, indexBytes, flags);
+			if (m_mappedVertices == NULL || m_mappedIndices == NULL) {
+				printf("Failed to map dynamic mesh buffers, using glBufferSubData instead\n");
+				//Immutable storage can't be respecified, so replace the buffers. Deleting them also unmaps them.
+				glDeleteBuffers(1, &m_vbo);
+				glDeleteBuffers(1, &m_ebo);
+				m_mappedVertices = nullptr;
+				m_mappedIndices = nullptr;
+				glGenBuffers(1, &m_vbo);
+				glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+				glGenBuffers(1, &m_ebo);
+				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+				m_numRegions = 1;
+				vertexBytes /= DYNAMIC_MESH_REGIONS;
+				indexBytes /= DYNAMIC_MESH_REGIONS;
+			}
+		}
+		if (m_mappedVertices == nullptr) {
+			GLenum bufferUsage = usage == MeshUsage::STATIC ? GL_STATIC_DRAW : (usage == MeshUsage::STREAM ? GL_STREAM_DRAW : GL_DYNAMIC_DRAW);
+			glBufferData(GL_ARRAY_BUFFER, vertexBytes, NULL, bufferUsage);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, NULL, bufferUsage);
+		}
+
+		//Position attribute
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)offsetof(Vertex, pos));
+		glEnableVertexAttribArray(0);
+
+		//Normal attribute
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)offsetof(Vertex, normal));
+		glEnableVertexAttribArray(1);
+
+		//UV attribute
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, uv)));
+		glEnableVertexAttribArray(2);
+
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+	DynamicMesh::~DynamicMesh()
+	{
+		for (int i = 0; i < m_numRegions; i++)
+		{
+			if (m_fences[i] != nullptr) {
+				glDeleteSync((GLsync)m_fences[i]);
+			}
+		}
+		if (m_mappedVertices != nullptr) {
+			glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+		if (m_mappedIndices != nullptr) {
+			glBindVertexArray(m_vao);
+			glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+			glBindVertexArray(0);
+		}
+		glDeleteBuffers(1, &m_vbo);
+		glDeleteBuffers(1, &m_ebo);
+		glDeleteVertexArrays(1, &m_vao);
+	}
+	/// <summary>
+	/// Replaces the entire contents of the mesh. Data beyond the capacity is dropped.
+	/// </summary>
+	void DynamicMesh::load(const MeshData& meshData)
+	{
+		m_numVertices = 0;
+		m_numIndices = 0;
+		updateVertices(meshData.vertices.data(), 0, meshData.vertices.size());
+		updateIndices(meshData.indices.data(), 0, meshData.indices.size());
+	}
+	/// <summary>
+	/// Overwrites count vertices starting at first. Only this range is uploaded.
+	/// </summary>
+	void DynamicMesh::updateVertices(const Vertex* vertices, int first, int count)
+	{
+		if (first < 0 || first + count > m_maxVertices) {
+			//Reported once per mesh, since an oversized update usually repeats every frame
+			if (!m_reportedOverflow) {
+				printf("DynamicMesh vertex update [%d, %d) exceeds capacity %d, clipping this and later updates\n", first, first + count, m_maxVertices);
+				m_reportedOverflow = true;
+			}
+			if (first < 0 || first >= m_maxVertices)
+				return;
+			count = m_maxVertices - first;
+		}
+		if (count <= 0)
+			return;
+		memcpy(&m_vertices[first], vertices, sizeof(Vertex) * count);
+		for (int i = 0; i < m_numRegions; i++)
+		{
+			m_vertexDirty[i].add(first, count);
+		}
+		if (first + count > m_numVertices) {
+			m_numVertices = first + count;
+		}
+	}
+	/// <summary>
+	/// Overwrites count indices starting at first. Only this range is uploaded.
+	/// </summary>
+	void DynamicMesh::updateIndices(const unsigned int* indices, int first, int count)
+	{
+		if (first < 0 || first + count > m_maxIndices) {
+			//Reported once per mesh, since an oversized update usually repeats every frame
+			if (!m_reportedOverflow) {
+				printf("DynamicMesh index update [%d, %d) exceeds capacity %d, clipping this and later updates\n", first, first + count, m_maxIndices);
+				m_reportedOverflow = true;
+			}
+			if (first < 0 || first >= m_maxIndices)
+				return;
+			count = m_maxIndices - first;
+		}
+		if (count <= 0)
+			return;
+		memcpy(&m_indices[first], indices, sizeof(unsigned int) * count);
+		for (int i = 0; i < m_numRegions; i++)
+		{
+			m_indexDirty[i].add(first, count);
+		}
+		if (first + count > m_numIndices) {
+			m_numIndices = first + count;
+		}
+	}
+	/// <summary>
+	/// Whether the GPU has finished the last draw that read from region. Polls the fence without waiting.
+	/// With three regions this is normally already signaled.
+	/// </summary>
+	bool DynamicMesh::isRegionFree(int region)
+	{
+		GLsync fence = (GLsync)m_fences[region];
+		if (fence == nullptr)
+			return true;
+		//The flush makes sure the fence reaches the GPU, so it signals without waiting for the end of the frame
+		if (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED)
+			return false;
+		glDeleteSync(fence);
+		m_fences[region] = nullptr;
+		return true;
+	}
+	/// <summary>
+	/// Copies the ranges changed since region was last drawn
+	/// </summary>
+	void DynamicMesh::flushRegion(int region)
+	{
+		DirtyRange& vertexRange = m_vertexDirty[region];
+		DirtyRange& indexRange = m_indexDirty[region];
+		int vertexCount = vertexRange.end - vertexRange.begin;
+		int indexCount = indexRange.end - indexRange.begin;
+		countUpload(sizeof(Vertex) * (vertexRange.isEmpty() ? 0 : vertexCount) + sizeof(unsigned int) * (indexRange.isEmpty() ? 0 : indexCount));
+		if (m_mappedVertices != nullptr) {
+			if (!vertexRange.isEmpty()) {
+				memcpy(m_mappedVertices + region * m_maxVertices + vertexRange.begin, &m_vertices[vertexRange.begin], sizeof(Vertex) * vertexCount);
+			}
+			if (!indexRange.isEmpty()) {
+				memcpy(m_mappedIndices + region * m_maxIndices + indexRange.begin, &m_indices[indexRange.begin], sizeof(unsigned int) * indexCount);
+			}
+		}
+		else {
+			if (!vertexRange.isEmpty()) {
+				glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+				glBufferSubData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertexRange.begin, sizeof(Vertex) * vertexCount, &m_vertices[vertexRange.begin]);
+				glBindBuffer(GL_ARRAY_BUFFER, 0);
+			}
+			if (!indexRange.isEmpty()) {
+				//Element buffer binding is VAO state
+				glBindVertexArray(m_vao);
+				glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indexRange.begin, sizeof(unsigned int) * indexCount, &m_indices[indexRange.begin]);
+			}
+		}
+		vertexRange = DirtyRange();
+		indexRange = DirtyRange();
+		m_regionNumVertices[region] = m_numVertices;
+		m_regionNumIndices[region] = m_numIndices;
+	}
+	/// <summary>
+	/// Uploads pending changes and draws. When streaming, each draw consumes one region.
+	/// If that region is still in use, draws the previous contents again and leaves the changes for the next draw.
+	/// </summary>
+	void DynamicMesh::draw(DrawMode drawMode)
+	{
+		int region = m_region;
+		if (isRegionFree(region)) {
+			flushRegion(region);
+			m_writtenRegion = region;
+			m_region = (region + 1) % m_numRegions;
+		}
+		else {
+			region = m_writtenRegion;
+			m_numDeferredUpdates++;
+		}
+
+		glBindVertexArray(m_vao);
+		if (drawMode == DrawMode::TRIANGLES) {
+			const void* indexOffset = (const void*)(sizeof(unsigned int) * region * m_maxIndices);
+			glDrawElementsBaseVertex(GL_TRIANGLES, m_regionNumIndices[region], GL_UNSIGNED_INT, indexOffset, region * m_maxVertices);
+			countDrawCall(m_regionNumIndices[region] / 3);
+		}
+		else {
+			glDrawArrays(GL_POINTS, region * m_maxVertices, m_regionNumVertices[region]);
+			countDrawCall(0);
+		}
+
+		if (m_numRegions > 1) {
+			//A region drawn again only becomes free after its latest draw
+			if (m_fences[region] != nullptr) {
+				glDeleteSync((GLsync)m_fences[region]);
+			}
+			m_fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		}
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include "mesh.h"
+
+namespace ew {
+	//Number of buffer regions a streamed DynamicMesh cycles through, so the CPU never writes what the GPU is reading
+	constexpr int DYNAMIC_MESH_REGIONS = 3;
+
+	//Half open range [begin, end) of elements that need to be copied to the GPU
+	struct DirtyRange {
+		int begin = 0;
+		int end = 0;
+		inline bool isEmpty()const { return end <= begin; }
+		inline void add(int first, int count) {
+			if (isEmpty()) {
+				begin = first;
+				end = first + count;
+			}
+			else {
+				begin = first < begin ? first : begin;
+				end = first + count > end ? first + count : end;
+			}
+		}
+	};
+
+	/// <summary>
+	/// Mesh with fixed capacity whose vertices and indices can be partially updated.
+	/// MeshUsage::STREAM uses persistently mapped storage split into DYNAMIC_MESH_REGIONS regions guarded by fences.
+	/// Draws never wait on a fence: if the next region is still in use, the last written region is drawn again
+	/// and the update is deferred to the next draw.
+	/// Other usages, and STREAM if mapping fails, keep a single buffer and upload dirty ranges with glBufferSubData.
+	/// </summary>
+	class DynamicMesh {
+	public:
+		DynamicMesh(int maxVertices, int maxIndices, MeshUsage usage = MeshUsage::STREAM);
+		~DynamicMesh();
+		DynamicMesh(const DynamicMesh&) = delete;
+		DynamicMesh& operator=(const DynamicMesh&) = delete;
+		void load(const MeshData& meshData);
+		void updateVertices(const Vertex* vertices, int first, int count);
+		void updateIndices(const unsigned int* indices, int first, int count);
+		void draw(DrawMode drawMode = DrawMode::TRIANGLES);
+		inline int getNumVertices()const { return m_numVertices; }
+		inline int getNumIndices()const { return m_numIndices; }
+		inline int getMaxVertices()const { return m_maxVertices; }
+		inline int getMaxIndices()const { return m_maxIndices; }
+		inline int getNumDeferredUpdates()const { return m_numDeferredUpdates; }
+	private:
+		bool isRegionFree(int region);
+		void flushRegion(int region);
+
+		MeshUsage m_usage;
+		int m_numRegions = 1;
+		int m_region = 0; //Region the next draw will write and use
+		int m_writtenRegion = 0; //Region with the most recent complete contents
+		int m_numDeferredUpdates = 0; //Draws that found their region busy
+		bool m_reportedOverflow = false; //Set once an update past the capacity has been printed
+		int m_maxVertices = 0;
+		int m_maxIndices = 0;
+		int m_numVertices = 0;
+		int m_numIndices = 0;
+		unsigned int m_vao = 0;
+		unsigned int m_vbo = 0;
+		unsigned int m_ebo = 0;
+		Vertex* m_mappedVertices = nullptr; //Persistent mapping (STREAM only)
+		unsigned int* m_mappedIndices = nullptr; //Persistent mapping (STREAM only)
+		void* m_fences[DYNAMIC_MESH_REGIONS] = {}; //GLsync per region, signaled once the GPU is done reading it
+		DirtyRange m_vertexDirty[DYNAMIC_MESH_REGIONS];
+		DirtyRange m_indexDirty[DYNAMIC_MESH_REGIONS];
+		int m_regionNumVertices[DYNAMIC_MESH_REGIONS] = {}; //Counts as of each region's last flush
+		int m_regionNumIndices[DYNAMIC_MESH_REGIONS] = {};
+		std::vector<Vertex> m_vertices; //CPU copy used to bring each region up to date
+		std::vector<unsigned int> m_indices;
+	};
+}
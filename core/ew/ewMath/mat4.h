@@ -4,6 +4,7 @@
 
 #pragma once
 #include "vec4.h"
+#include "simd.h"
 #include <cstddef>
 
 namespace ew {
@@ -41,16 +42,64 @@ namespace ew {
 		inline const Vec4& operator[](int i) const{
 			return (*reinterpret_cast<const Vec4*>(n[i]));
 		}
+		//SIMD paths multiply then add in the same order as the scalar path (no fused multiply-add), so results match exactly
+		//as long as the compiler doesn't fuse the scalar path either (-ffp-contract=off with FMA enabled). See tests/mat4SimdTest.cpp.
 		inline friend Vec4 operator * (const Mat4& m, const Vec4& v) {
+#if defined(EW_SIMD_SSE)
+			__m128 r = _mm_mul_ps(_mm_loadu_ps(m.n[0]), _mm_set1_ps(v.x));
+			r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(m.n[1]), _mm_set1_ps(v.y)));
+			r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(m.n[2]), _mm_set1_ps(v.z)));
+			r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(m.n[3]), _mm_set1_ps(v.w)));
+			Vec4 result;
+			_mm_storeu_ps(&result.x, r);
+			return result;
+#elif defined(EW_SIMD_NEON)
+			float32x4_t r = vmulq_n_f32(vld1q_f32(m.n[0]), v.x);
+			r = vaddq_f32(r, vmulq_n_f32(vld1q_f32(m.n[1]), v.y));
+			r = vaddq_f32(r, vmulq_n_f32(vld1q_f32(m.n[2]), v.z));
+			r = vaddq_f32(r, vmulq_n_f32(vld1q_f32(m.n[3]), v.w));
+			Vec4 result;
+			vst1q_f32(&result.x, r);
+			return result;
+#else
 			return Vec4(
 				m[0][0] * v.x + m[1][0] * v.y + m[2][0] * v.z + m[3][0] * v.w,
 				m[0][1] * v.x + m[1][1] * v.y + m[2][1] * v.z + m[3][1] * v.w,
 				m[0][2] * v.x + m[1][2] * v.y + m[2][2] * v.z + m[3][2] * v.w,
 				m[0][3] * v.x + m[1][3] * v.y + m[2][3] * v.z + m[3][3] * v.w
 			);
+#endif
 		}
 		inline friend Mat4 operator * (const Mat4& l, const Mat4& r) {
 			Mat4 m;
+#if defined(EW_SIMD_SSE)
+			//Each result column is the left columns weighted by one right column
+			__m128 l0 = _mm_loadu_ps(l.n[0]);
+			__m128 l1 = _mm_loadu_ps(l.n[1]);
+			__m128 l2 = _mm_loadu_ps(l.n[2]);
+			__m128 l3 = _mm_loadu_ps(l.n[3]);
+			for (int c = 0; c < 4; c++)
+			{
+				__m128 col = _mm_mul_ps(l0, _mm_set1_ps(r.n[c][0]));
+				col = _mm_add_ps(col, _mm_mul_ps(l1, _mm_set1_ps(r.n[c][1])));
+				col = _mm_add_ps(col, _mm_mul_ps(l2, _mm_set1_ps(r.n[c][2])));
+				col = _mm_add_ps(col, _mm_mul_ps(l3, _mm_set1_ps(r.n[c][3])));
+				_mm_storeu_ps(m.n[c], col);
+			}
+#elif defined(EW_SIMD_NEON)
+			float32x4_t l0 = vld1q_f32(l.n[0]);
+			float32x4_t l1 = vld1q_f32(l.n[1]);
+			float32x4_t l2 = vld1q_f32(l.n[2]);
+			float32x4_t l3 = vld1q_f32(l.n[3]);
+			for (int c = 0; c < 4; c++)
+			{
+				float32x4_t col = vmulq_n_f32(l0, r.n[c][0]);
+				col = vaddq_f32(col, vmulq_n_f32(l1, r.n[c][1]));
+				col = vaddq_f32(col, vmulq_n_f32(l2, r.n[c][2]));
+				col = vaddq_f32(col, vmulq_n_f32(l3, r.n[c][3]));
+				vst1q_f32(m.n[c], col);
+			}
+#else
 			//Row 0
 			m[0][0] = l[0][0] * r[0][0] + l[1][0] * r[0][1] + l[2][0] * r[0][2] + l[3][0] * r[0][3];//dot(l_row_0,r_col_0)
 			m[1][0] = l[0][0] * r[1][0] + l[1][0] * r[1][1] + l[2][0] * r[1][2] + l[3][0] * r[1][3];//dot(l_row_0,r_col_1)
@@ -71,9 +120,50 @@ namespace ew {
 			m[1][3] = l[0][3] * r[1][0] + l[1][3] * r[1][1] + l[2][3] * r[1][2] + l[3][3] * r[1][3];//dot(l_row_3,r_col_1)
 			m[2][3] = l[0][3] * r[2][0] + l[1][3] * r[2][1] + l[2][3] * r[2][2] + l[3][3] * r[2][3];//dot(l_row_3,r_col_2)
 			m[3][3] = l[0][3] * r[3][0] + l[1][3] * r[3][1] + l[2][3] * r[3][2] + l[3][3] * r[3][3];//dot(l_row_3,r_col_3)
+#endif
 			return m;		  
 		}
 	};
+	/// <summary>
+	/// Multiplies count vectors by the same matrix. out may alias in.
+	/// </summary>
+	inline void TransformVec4Batch(const Mat4& m, const Vec4* in, Vec4* out, size_t count) {
+		size_t i = 0;
+#if defined(EW_SIMD_AVX)
+		//Two vectors per iteration, one per 128 bit lane
+		__m256 c0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&m[0]));
+		__m256 c1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&m[1]));
+		__m256 c2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&m[2]));
+		__m256 c3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&m[3]));
+		for (; i + 2 <= count; i += 2)
+		{
+			__m256 v = _mm256_loadu_ps(&in[i].x);
+			__m256 r = _mm256_mul_ps(c0, _mm256_permute_ps(v, 0x00));
+			r = _mm256_add_ps(r, _mm256_mul_ps(c1, _mm256_permute_ps(v, 0x55)));
+			r = _mm256_add_ps(r, _mm256_mul_ps(c2, _mm256_permute_ps(v, 0xAA)));
+			r = _mm256_add_ps(r, _mm256_mul_ps(c3, _mm256_permute_ps(v, 0xFF)));
+			_mm256_storeu_ps(&out[i].x, r);
+		}
+#elif defined(EW_SIMD_SSE)
+		__m128 c0 = _mm_loadu_ps(&m[0].x);
+		__m128 c1 = _mm_loadu_ps(&m[1].x);
+		__m128 c2 = _mm_loadu_ps(&m[2].x);
+		__m128 c3 = _mm_loadu_ps(&m[3].x);
+		for (; i < count; i++)
+		{
+			__m128 v = _mm_loadu_ps(&in[i].x);
+			__m128 r = _mm_mul_ps(c0, _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)));
+			r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+			r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))));
+			r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))));
+			_mm_storeu_ps(&out[i].x, r);
+		}
+#endif
+		for (; i < count; i++)
+		{
+			out[i] = m * in[i];
+		}
+	}
 	inline Mat4 IdentityMatrix() {
 		return Mat4(
 			1.0f, 0.0f, 0.0f, 0.0f,
@@ -0,0 +1,18 @@
+/*
+	Compile time SIMD selection for ewMath.
+	Define EW_NO_SIMD to force the scalar code paths.
+*/
+
+#pragma once
+
+#if !defined(EW_NO_SIMD) && (defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#define EW_SIMD_SSE 1
+#include <xmmintrin.h>
+#if defined(__AVX__)
+#define EW_SIMD_AVX 1
+#include <immintrin.h>
+#endif
+#elif !defined(EW_NO_SIMD) && (defined(__ARM_NEON) || defined(_M_ARM64))
+#define EW_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
@@ -0,0 +1,124 @@
+#include "frustum.h"
+#include "ewMath/simd.h"
+
+namespace ew {
+	/// <summary>
+	/// World space frustum planes of a camera, from its projection * view matrix (Gribb-Hartmann).
+	/// Each plane is the last row of the matrix plus or minus one of the other rows.
+	/// Pass projection * view * model to get the planes in that model's space instead.
+	/// </summary>
+	Frustum extractFrustum(const ew::Mat4& viewProjection) {
+		Frustum frustum;
+		for (int i = 0; i < 3; i++)
+		{
+			for (int j = 0; j < 2; j++)
+			{
+				float sign = j == 0 ? 1.0f : -1.0f;
+				ew::Vec4& plane = frustum.planes[i * 2 + j];
+				plane.x = viewProjection[0][3] + sign * viewProjection[0][i];
+				plane.y = viewProjection[1][3] + sign * viewProjection[1][i];
+				plane.z = viewProjection[2][3] + sign * viewProjection[2][i];
+				plane.w = viewProjection[3][3] + sign * viewProjection[3][i];
+				float length = sqrtf(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+				plane.x /= length;
+				plane.y /= length;
+				plane.z /= length;
+				plane.w /= length;
+			}
+		}
+		return frustum;
+	}
+
+	/// <summary>
+	/// Moves a mesh space sphere into world space. The radius grows by the largest axis scale of model.
+	/// </summary>
+	BoundingSphere transformBoundingSphere(const ew::Mat4& model, const ew::Vec3& center, float radius) {
+		BoundingSphere sphere;
+		sphere.center = (model * ew::Vec4(center, 1.0f)).toVec3();
+		float maxScaleSquared = 0.0f;
+		for (int i = 0; i < 3; i++)
+		{
+			const ew::Vec4& axis = model[i];
+			float scaleSquared = axis.x * axis.x + axis.y * axis.y + axis.z * axis.z;
+			maxScaleSquared = scaleSquared > maxScaleSquared ? scaleSquared : maxScaleSquared;
+		}
+		sphere.radius = radius * sqrtf(maxScaleSquared);
+		return sphere;
+	}
+
+	bool isSphereInFrustum(const Frustum& frustum, const BoundingSphere& sphere) {
+		for (int i = 0; i < 6; i++)
+		{
+			const ew::Vec4& plane = frustum.planes[i];
+			if (plane.x * sphere.center.x + plane.y * sphere.center.y + plane.z * sphere.center.z + plane.w < -sphere.radius)
+				return false;
+		}
+		return true;
+	}
+
+	/// <summary>
+	/// Tests count world space spheres against the frustum, four at a time where SIMD is available.
+	/// Writes 1 to visible[i] if sphere i touches the frustum, 0 if it is entirely outside a plane.
+	/// </summary>
+	/// <returns>Number of visible spheres</returns>
+	int cullSpheres(const Frustum& frustum, const BoundingSphere* spheres, size_t count, uint8_t* visible) {
+		size_t i = 0;
+		int numVisible = 0;
+#if defined(EW_SIMD_SSE)
+		for (; i + 4 <= count; i += 4)
+		{
+			//Four (x, y, z, radius) rows become x, y, z and radius columns
+			__m128 x = _mm_loadu_ps(&spheres[i].center.x);
+			__m128 y = _mm_loadu_ps(&spheres[i + 1].center.x);
+			__m128 z = _mm_loadu_ps(&spheres[i + 2].center.x);
+			__m128 r = _mm_loadu_ps(&spheres[i + 3].center.x);
+			_MM_TRANSPOSE4_PS(x, y, z, r);
+			__m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), r);
+			__m128 outside = _mm_setzero_ps();
+			for (int p = 0; p < 6; p++)
+			{
+				const ew::Vec4& plane = frustum.planes[p];
+				__m128 d = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_mul_ps(y, _mm_set1_ps(plane.y)));
+				d = _mm_add_ps(d, _mm_mul_ps(z, _mm_set1_ps(plane.z)));
+				d = _mm_add_ps(d, _mm_set1_ps(plane.w));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(d, negRadius));
+			}
+			int mask = ~_mm_movemask_ps(outside);
+			for (int j = 0; j < 4; j++)
+			{
+				visible[i + j] = (mask >> j) & 1;
+				numVisible += visible[i + j];
+			}
+		}
+#elif defined(EW_SIMD_NEON)
+		for (; i + 4 <= count; i += 4)
+		{
+			//De-interleaving load gives x, y, z and radius columns directly
+			float32x4x4_t s = vld4q_f32(&spheres[i].center.x);
+			float32x4_t negRadius = vnegq_f32(s.val[3]);
+			uint32x4_t outside = vdupq_n_u32(0);
+			for (int p = 0; p < 6; p++)
+			{
+				const ew::Vec4& plane = frustum.planes[p];
+				float32x4_t d = vaddq_f32(vmulq_n_f32(s.val[0], plane.x), vmulq_n_f32(s.val[1], plane.y));
+				d = vaddq_f32(d, vmulq_n_f32(s.val[2], plane.z));
+				d = vaddq_f32(d, vdupq_n_f32(plane.w));
+				outside = vorrq_u32(outside, vcltq_f32(d, negRadius));
+			}
+			uint32_t lanes[4];
+			vst1q_u32(lanes, outside);
+			for (int j = 0; j < 4; j++)
+			{
+				visible[i + j] = lanes[j] ? 0 : 1;
+				numVisible += visible[i + j];
+			}
+		}
+#endif
+		for (; i < count; i++)
+		{
+			visible[i] = isSphereInFrustum(frustum, spheres[i]) ? 1 : 0;
+			numVisible += visible[i];
+		}
+		return numVisible;
+	}
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "ewMath/ewMath.h"
+
+namespace ew {
+	//Same layout as a Vec4 (x, y, z, radius), so batches load straight into SIMD registers
+	struct BoundingSphere {
+		ew::Vec3 center;
+		float radius;
+	};
+	static_assert(sizeof(BoundingSphere) == 16, "BoundingSphere must stay 16 bytes");
+
+	//Left, right, bottom, top, near and far planes, normalized and pointing inward:
+	//a point p is inside a plane when dot(plane.xyz, p) + plane.w >= 0
+	struct Frustum {
+		ew::Vec4 planes[6];
+	};
+
+	Frustum extractFrustum(const ew::Mat4& viewProjection);
+	BoundingSphere transformBoundingSphere(const ew::Mat4& model, const ew::Vec3& center, float radius);
+	bool isSphereInFrustum(const Frustum& frustum, const BoundingSphere& sphere);
+	int cullSpheres(const Frustum& frustum, const BoundingSphere* spheres, size_t count, uint8_t* visible);
+}
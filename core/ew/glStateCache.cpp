@@ -0,0 +1,65 @@
+#include "glStateCache.h"
+#include <stdint.h>
+#include "external/glad.h"
+
+namespace ew {
+	void GLStateCache::useProgram(unsigned int program)
+	{
+		if (program == m_program) {
+			m_stats.programBindsSkipped++;
+			return;
+		}
+		glUseProgram(program);
+		m_program = program;
+		m_stats.programBinds++;
+	}
+	void GLStateCache::bindVertexArray(unsigned int vertexArray)
+	{
+		if (vertexArray == m_vertexArray) {
+			m_stats.vertexArrayBindsSkipped++;
+			return;
+		}
+		glBindVertexArray(vertexArray);
+		m_vertexArray = vertexArray;
+		m_stats.vertexArrayBinds++;
+	}
+	/// <summary>
+	/// Binds texture to target on a texture unit, switching the active unit only when needed.
+	/// Units past STATE_CACHE_TEXTURE_UNITS are bound without caching.
+	/// </summary>
+	void GLStateCache::bindTexture(int unit, unsigned int target, unsigned int texture)
+	{
+		if (unit >= 0 && unit < STATE_CACHE_TEXTURE_UNITS && m_textures[unit] == texture && m_textureTargets[unit] == target) {
+			m_stats.textureBindsSkipped++;
+			return;
+		}
+		if (m_activeUnit != (unsigned int)unit) {
+			glActiveTexture(GL_TEXTURE0 + unit);
+			m_activeUnit = unit;
+		}
+		glBindTexture(target, texture);
+		if (unit >= 0 && unit < STATE_CACHE_TEXTURE_UNITS) {
+			m_textures[unit] = texture;
+			m_textureTargets[unit] = target;
+		}
+		m_stats.textureBinds++;
+	}
+	/// <summary>
+	/// Forgets every binding, e.g. at the start of a frame or after code that binds directly
+	/// </summary>
+	void GLStateCache::invalidate()
+	{
+		m_program = UINT32_MAX;
+		m_vertexArray = UINT32_MAX;
+		m_activeUnit = UINT32_MAX;
+		for (int i = 0; i < STATE_CACHE_TEXTURE_UNITS; i++)
+		{
+			m_textures[i] = UINT32_MAX;
+			m_textureTargets[i] = UINT32_MAX;
+		}
+	}
+	void GLStateCache::invalidateVertexArray()
+	{
+		m_vertexArray = UINT32_MAX;
+	}
+}
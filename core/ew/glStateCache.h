@@ -0,0 +1,39 @@
+#pragma once
+
+namespace ew {
+	constexpr int STATE_CACHE_TEXTURE_UNITS = 16;
+
+	//Bind calls issued and skipped by a GLStateCache since its last resetStats()
+	struct StateCacheStats {
+		int programBinds = 0;
+		int programBindsSkipped = 0;
+		int vertexArrayBinds = 0;
+		int vertexArrayBindsSkipped = 0;
+		int textureBinds = 0; //Counts glActiveTexture + glBindTexture as one
+		int textureBindsSkipped = 0;
+	};
+
+	/// <summary>
+	/// Shadow copy of the program, vertex array and texture bindings, so binding what is already bound costs no GL call.
+	/// Anything that binds behind the cache's back must be followed by invalidate().
+	/// </summary>
+	class GLStateCache {
+	public:
+		GLStateCache() { invalidate(); }
+		void useProgram(unsigned int program);
+		void bindVertexArray(unsigned int vertexArray);
+		void bindTexture(int unit, unsigned int target, unsigned int texture);
+		void invalidate();
+		void invalidateVertexArray();
+		inline const StateCacheStats& getStats()const { return m_stats; }
+		inline void resetStats() { m_stats = StateCacheStats(); }
+	private:
+		//UINT32_MAX = unknown, bind unconditionally
+		unsigned int m_program;
+		unsigned int m_vertexArray;
+		unsigned int m_activeUnit;
+		unsigned int m_textures[STATE_CACHE_TEXTURE_UNITS];
+		unsigned int m_textureTargets[STATE_CACHE_TEXTURE_UNITS];
+		StateCacheStats m_stats;
+	};
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+namespace ew {
+	constexpr uint64_t HASH_SEED = 14695981039346656037ull;
+
+	//FNV-1a style 64 bit hash, consuming 8 bytes per step. Used to key on-disk caches, not for security.
+	inline uint64_t hashBytes(const void* data, size_t size, uint64_t hash = HASH_SEED) {
+		const uint64_t prime = 1099511628211ull;
+		const unsigned char* bytes = (const unsigned char*)data;
+		size_t i = 0;
+		for (; i + 8 <= size; i += 8)
+		{
+			uint64_t word;
+			memcpy(&word, bytes + i, 8);
+			hash = (hash ^ word) * prime;
+			hash ^= hash >> 29;
+		}
+		for (; i < size; i++)
+		{
+			hash = (hash ^ bytes[i]) * prime;
+		}
+		return hash;
+	}
+}
@@ -0,0 +1,51 @@
+#include "lodMesh.h"
+
+namespace ew {
+	/// <summary>
+	/// Appends a level. Levels must be added finest first, with increasing geometric error.
+	/// </summary>
+	void LodMesh::addLevel(const MeshDataView& meshData, float geometricError, VertexFormat format)
+	{
+		m_levels.push_back({ Mesh(meshData, MeshUsage::STATIC, format), geometricError });
+	}
+	/// <summary>
+	/// Size in pixels of a level's geometric error on screen, measured at the point of the bounding sphere closest to the camera.
+	/// Works from inside the sphere as well, e.g. for a sky dome.
+	/// </summary>
+	float LodMesh::getProjectedError(int level, const ew::Camera& camera, int screenHeight, const ew::Vec3& center, float boundingRadius)const
+	{
+		float geometricError = m_levels[level].geometricError;
+		if (camera.orthographic) {
+			return geometricError * screenHeight / camera.orthoHeight;
+		}
+		float distance = fabsf(ew::Magnitude(camera.position - center) - boundingRadius);
+		distance = distance > camera.nearPlane ? distance : camera.nearPlane;
+		float pixelsPerUnit = screenHeight / (2.0f * distance * tanf(ew::Radians(camera.fov) * 0.5f));
+		return geometricError * pixelsPerUnit;
+	}
+	/// <summary>
+	/// Picks the coarsest level whose projected error is within maxPixelError and makes it current.
+	/// Going coarser needs the error to be LOD_HYSTERESIS times smaller than that.
+	/// </summary>
+	/// <param name="center">World space center of the mesh's bounding sphere</param>
+	/// <param name="boundingRadius">World space radius of the mesh's bounding sphere</param>
+	/// <returns>The selected level</returns>
+	int LodMesh::selectLevel(const ew::Camera& camera, int screenHeight, const ew::Vec3& center, float boundingRadius)
+	{
+		int level = (int)m_levels.size() - 1;
+		for (; level > 0; level--)
+		{
+			float allowedError = level > m_currentLevel ? m_maxPixelError * LOD_HYSTERESIS : m_maxPixelError;
+			if (getProjectedError(level, camera, screenHeight, center, boundingRadius) <= allowedError)
+				break;
+		}
+		m_currentLevel = level > 0 ? level : 0;
+		return m_currentLevel;
+	}
+	/// <summary>
+	/// Geometric error of createSphere/createEarth globes: the gap between the true sphere and the middle of a grid cell's longest chord
+	/// </summary>
+	float getSphereGeometricError(float radius, int subdivisions) {
+		return radius * (1.0f - cosf(ew::PI / subdivisions));
+	}
+}
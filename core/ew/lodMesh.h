@@ -0,0 +1,40 @@
+#pragma once
+#include <vector>
+#include "mesh.h"
+#include "camera.h"
+
+namespace ew {
+	//A level only becomes coarser once its projected error drops below this fraction of the allowed error,
+	//so the selection doesn't flicker between two levels at the switching distance
+	constexpr float LOD_HYSTERESIS = 0.75f;
+
+	/// <summary>
+	/// Chain of meshes of the same surface at decreasing detail, finest first.
+	/// Each frame the coarsest level whose geometric error projects to at most maxPixelError pixels is selected.
+	/// Levels snap, they are not blended.
+	/// </summary>
+	class LodMesh {
+	public:
+		LodMesh(float maxPixelError = 1.0f) :m_maxPixelError(maxPixelError) {};
+		void addLevel(const MeshDataView& meshData, float geometricError, VertexFormat format = VertexFormat::FLOAT);
+		int selectLevel(const ew::Camera& camera, int screenHeight, const ew::Vec3& center, float boundingRadius);
+		float getProjectedError(int level, const ew::Camera& camera, int screenHeight, const ew::Vec3& center, float boundingRadius)const;
+		inline const Mesh& getMesh(int level)const { return m_levels[level].mesh; }
+		inline const Mesh& getCurrentMesh()const { return m_levels[m_currentLevel].mesh; }
+		inline int getCurrentLevel()const { return m_currentLevel; }
+		inline int getNumLevels()const { return (int)m_levels.size(); }
+		inline float getGeometricError(int level)const { return m_levels[level].geometricError; }
+		inline float getMaxPixelError()const { return m_maxPixelError; }
+		inline void setMaxPixelError(float maxPixelError) { m_maxPixelError = maxPixelError; }
+	private:
+		struct Level {
+			Mesh mesh;
+			float geometricError; //Largest distance from the mesh to the true surface, in mesh units
+		};
+		std::vector<Level> m_levels;
+		int m_currentLevel = 0;
+		float m_maxPixelError;
+	};
+
+	float getSphereGeometricError(float radius, int subdivisions);
+}
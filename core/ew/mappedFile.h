@@ -0,0 +1,31 @@
+#pragma once
+#include <stddef.h>
+
+namespace ew {
+	/// <summary>
+	/// Read only memory mapping of a whole file. The mapping is released on close() or destruction.
+	/// </summary>
+	class MappedFile {
+	public:
+		MappedFile() {};
+		~MappedFile();
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		bool open(const char* filePath);
+		void close();
+		inline bool isOpen()const { return m_data != nullptr; }
+		inline const unsigned char* getData()const { return m_data; }
+		inline size_t getSize()const { return m_size; }
+	private:
+		const unsigned char* m_data = nullptr;
+		size_t m_size = 0;
+#ifdef _WIN32
+		void* m_file = nullptr; //HANDLE
+		void* m_mapping = nullptr; //HANDLE
+#else
+		int m_file = -1;
+#endif
+	};
+}
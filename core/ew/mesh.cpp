@@ -4,65 +4,342 @@
 
 #include "mesh.h"
 #include "ewMath/ewMath.h"
+#include "vertexFormat.h"
+#include "renderStats.h"
 #include "external/glad.h"
+#include <stdio.h>
 
 namespace ew {
-	Mesh::Mesh(const MeshData& meshData)
+	/// <summary>
+	/// Converts a MeshUsage hint to the matching GL buffer usage
+	/// </summary>
+	static GLenum getBufferUsage(MeshUsage usage) {
+		switch (usage) {
+		default:
+			return GL_STATIC_DRAW;
+		case MeshUsage::DYNAMIC:
+			return GL_DYNAMIC_DRAW;
+		case MeshUsage::STREAM:
+			return GL_STREAM_DRAW;
+		}
+	}
+	/// <summary>
+	/// Describes position, normal and UV of format at locations firstLocation..firstLocation+2, read from vertex buffer binding
+	/// </summary>
+	static void setVertexAttribFormats(VertexFormat format, unsigned int firstLocation, unsigned int binding) {
+		if (format == VertexFormat::FLOAT) {
+			glVertexAttribFormat(firstLocation, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, pos));
+			glVertexAttribFormat(firstLocation + 1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, normal));
+			glVertexAttribFormat(firstLocation + 2, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, uv));
+		}
+		else {
+			if (format == VertexFormat::HALF) {
+				glVertexAttribFormat(firstLocation, 3, GL_HALF_FLOAT, GL_FALSE, offsetof(PackedVertex, pos));
+			}
+			else {
+				glVertexAttribFormat(firstLocation, 3, GL_SHORT, GL_TRUE, offsetof(PackedVertex, pos));
+			}
+			//Two component octahedral normal, z reads as 0 in the shader
+			glVertexAttribFormat(firstLocation + 1, 2, GL_SHORT, GL_TRUE, offsetof(PackedVertex, normal));
+			glVertexAttribFormat(firstLocation + 2, 2, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(PackedVertex, uv));
+		}
+		for (unsigned int i = 0; i < 3; i++)
+		{
+			glVertexAttribBinding(firstLocation + i, binding);
+			glEnableVertexAttribArray(firstLocation + i);
+		}
+	}
+	/// <summary>
+	/// Uploads vertices and then duplicatedVertices to buffer, packing them first unless format is FLOAT
+	/// </summary>
+	static void uploadVertices(unsigned int buffer, const Vertex* vertices, size_t count, const std::vector<unsigned int>& duplicatedVertices, VertexFormat format, const ew::Vec3& positionScale, const ew::Vec3& positionOffset, GLenum bufferUsage) {
+		//Copies for triangles too wide for 16 bit indices go after the mesh's own vertices, see buildIndexChunks
+		std::vector<Vertex> withDuplicates;
+		if (!duplicatedVertices.empty()) {
+			withDuplicates.reserve(count + duplicatedVertices.size());
+			withDuplicates.assign(vertices, vertices + count);
+			for (unsigned int v : duplicatedVertices)
+			{
+				withDuplicates.push_back(vertices[v]);
+			}
+			vertices = withDuplicates.data();
+			count = withDuplicates.size();
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		if (format == VertexFormat::FLOAT) {
+			glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * count, vertices, bufferUsage);
+			countUpload(sizeof(Vertex) * count);
+			return;
+		}
+		std::vector<PackedVertex> packed(count);
+		packVertices(vertices, count, format, positionScale, positionOffset, packed.data());
+		glBufferData(GL_ARRAY_BUFFER, sizeof(PackedVertex) * count, packed.data(), bufferUsage);
+		countUpload(sizeof(PackedVertex) * count);
+	}
+	static void getIndexRange(const unsigned int* indices, size_t count, unsigned int& min, unsigned int& max) {
+		min = UINT32_MAX;
+		max = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			min = indices[i] < min ? indices[i] : min;
+			max = indices[i] > max ? indices[i] : max;
+		}
+	}
+	/// <summary>
+	/// Splits indices into runs of whole triangles whose vertices fit in 16 bits once the run's base vertex is subtracted.
+	/// Triangles spanning more than 65536 vertices can't fit any run. They are moved to the end and drawn from copies
+	/// of their vertices, listed in duplicatedVertices, which are appended after the mesh's own numVertices vertices.
+	/// Every other triangle keeps its order.
+	/// </summary>
+	void buildIndexChunks(const unsigned int* indices, size_t numIndices, size_t numVertices, IndexChunks& result) {
+		const unsigned int maxRange = 0xFFFF;
+		result.indices.resize(numIndices);
+		result.chunks.clear();
+		result.duplicatedVertices.clear();
+
+		//Narrow triangles in their original order, then the wide ones rewritten onto duplicated vertices.
+		//Copies are shared between wide triangles within a window of 65536 duplicates, so each stays narrow.
+		std::vector<unsigned int> ordered;
+		ordered.reserve(numIndices);
+		std::vector<unsigned int> wide;
+		std::vector<unsigned int> copyOf; //Index of each source vertex's latest copy, allocated on the first wide triangle
+		unsigned int windowStart = (unsigned int)numVertices;
+		for (size_t i = 0; i < numIndices; i += 3)
+		{
+			size_t end = i + 3 < numIndices ? i + 3 : numIndices;
+			unsigned int triMin, triMax;
+			getIndexRange(indices + i, end - i, triMin, triMax);
+			if (triMax - triMin <= maxRange) {
+				ordered.insert(ordered.end(), indices + i, indices + end);
+				continue;
+			}
+			if (copyOf.empty()) {
+				copyOf.resize(numVertices, UINT32_MAX);
+			}
+			if (numVertices + result.duplicatedVertices.size() - windowStart > maxRange - 3) {
+				windowStart = (unsigned int)(numVertices + result.duplicatedVertices.size());
+			}
+			for (size_t j = i; j < end; j++)
+			{
+				unsigned int& copy = copyOf[indices[j]];
+				if (copy == UINT32_MAX || copy < windowStart) {
+					copy = (unsigned int)(numVertices + result.duplicatedVertices.size());
+					result.duplicatedVertices.push_back(indices[j]);
+				}
+				wide.push_back(copy);
+			}
+		}
+		ordered.insert(ordered.end(), wide.begin(), wide.end());
+
+		size_t chunkStart = 0;
+		unsigned int chunkMin = UINT32_MAX, chunkMax = 0;
+		auto closeChunk = [&](size_t end) {
+			for (size_t i = chunkStart; i < end; i++)
+			{
+				result.indices[i] = (uint16_t)(ordered[i] - chunkMin);
+			}
+			result.chunks.push_back({ (int)chunkStart, (int)(end - chunkStart), (int)chunkMin });
+		};
+		for (size_t i = 0; i < numIndices; i += 3)
+		{
+			size_t end = i + 3 < numIndices ? i + 3 : numIndices;
+			unsigned int triMin, triMax;
+			getIndexRange(ordered.data() + i, end - i, triMin, triMax);
+			unsigned int newMin = triMin < chunkMin ? triMin : chunkMin;
+			unsigned int newMax = triMax > chunkMax ? triMax : chunkMax;
+			if (newMax - newMin > maxRange) {
+				closeChunk(i);
+				chunkStart = i;
+				newMin = triMin;
+				newMax = triMax;
+			}
+			chunkMin = newMin;
+			chunkMax = newMax;
+		}
+		if (numIndices > 0) {
+			closeChunk(numIndices);
+		}
+	}
+	MeshBounds computeMeshBounds(const MeshDataView& meshData) {
+		MeshBounds bounds;
+		getPositionBounds(meshData, bounds.min, bounds.max);
+		bounds.center = (bounds.min + bounds.max) * 0.5f;
+		//Tighter than the box's half diagonal for round meshes
+		float radiusSquared = 0.0f;
+		const Vertex* arrays[2] = { meshData.vertices, meshData.morphVertices };
+		size_t counts[2] = { meshData.numVertices, meshData.numMorphVertices };
+		for (int a = 0; a < 2; a++)
+		{
+			for (size_t i = 0; i < counts[a]; i++)
+			{
+				ew::Vec3 d = arrays[a][i].pos - bounds.center;
+				float distanceSquared = d.x * d.x + d.y * d.y + d.z * d.z;
+				radiusSquared = distanceSquared > radiusSquared ? distanceSquared : radiusSquared;
+			}
+		}
+		bounds.radius = sqrtf(radiusSquared);
+		return bounds;
+	}
+	Mesh::Mesh(const MeshData& meshData, MeshUsage usage, VertexFormat format)
+	{
+		load(meshData, usage, format);
+	}
+	Mesh::Mesh(const MeshDataView& meshData, MeshUsage usage, VertexFormat format)
 	{
-		load(meshData);
+		load(meshData, usage, format);
 	}
-	void Mesh::load(const MeshData& meshData)
+	void Mesh::load(const MeshData& meshData, MeshUsage usage, VertexFormat format)
 	{
+		load(MeshDataView(meshData), usage, format);
+	}
+	/// <summary>
+	/// Uploads straight from the viewed arrays, so a mapped cache file goes to the driver without an intermediate copy.
+	/// Packed formats quantize into a temporary buffer first.
+	/// </summary>
+	void Mesh::load(const MeshDataView& meshData, MeshUsage usage, VertexFormat format)
+	{
+		GLenum bufferUsage = getBufferUsage(usage);
 		if (!m_initialized) {
 			glGenVertexArrays(1, &m_vao);
-			glBindVertexArray(m_vao);
-
 			glGenBuffers(1, &m_vbo);
-			glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-
 			glGenBuffers(1, &m_ebo);
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
-			//Position attribute
-			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)offsetof(Vertex, pos));
-			glEnableVertexAttribArray(0);
-
-			//Normal attribute
-			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)offsetof(Vertex, normal));
-			glEnableVertexAttribArray(1);
+			m_initialized = true;
+		}
 
-			//UV attribute
-			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, uv)));
-			glEnableVertexAttribArray(2);
+		m_vertexFormat = format;
+		m_bounds = computeMeshBounds(meshData);
+		m_positionScale = ew::Vec3(1.0f);
+		m_positionOffset = ew::Vec3(0.0f);
+		if (format == VertexFormat::NORMALIZED) {
+			//Vertices and morph vertices share one range so the shader needs a single decode
+			m_positionOffset = m_bounds.center;
+			ew::Vec3 extents = (m_bounds.max - m_bounds.min) * 0.5f;
+			m_positionScale = ew::Vec3(extents.x > 0.0f ? extents.x : 1.0f, extents.y > 0.0f ? extents.y : 1.0f, extents.z > 0.0f ? extents.z : 1.0f);
+		}
 
-			m_initialized = true;
+		//16 bit indices where possible. Meshes with more than 65536 vertices are drawn in chunks with a base vertex each,
+		//and triangles wider than that from duplicated vertices, unless the copies would cost more than the 2 bytes saved per index.
+		IndexChunks indexChunks;
+		bool shortIndices = false;
+		if (meshData.numIndices > 0) {
+			buildIndexChunks(meshData.indices, meshData.numIndices, meshData.numVertices, indexChunks);
+			size_t numCopies = indexChunks.duplicatedVertices.size() * (meshData.numMorphVertices > 0 ? 2 : 1);
+			shortIndices = numCopies * getVertexSize(format) < meshData.numIndices * (sizeof(unsigned int) - sizeof(uint16_t));
+			if (!shortIndices) {
+				printf("Mesh with %zu vertices and %zu indices would need %zu duplicated vertices for 16 bit indices, using 32 bit indices\n",
+					meshData.numVertices, meshData.numIndices, indexChunks.duplicatedVertices.size());
+				indexChunks.duplicatedVertices.clear();
+			}
 		}
 
 		glBindVertexArray(m_vao);
-		glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
 
-		if (meshData.vertices.size() > 0) {
-			glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * meshData.vertices.size(), meshData.vertices.data(), GL_STATIC_DRAW);
+		//Position, normal and UV (attributes 0-2) from binding 0
+		setVertexAttribFormats(format, 0, 0);
+		glBindVertexBuffer(0, m_vbo, 0, getVertexSize(format));
+		if (meshData.numVertices > 0) {
+			uploadVertices(m_vbo, meshData.vertices, meshData.numVertices, indexChunks.duplicatedVertices, format, m_positionScale, m_positionOffset, bufferUsage);
+		}
+		m_indexChunks.clear();
+		if (shortIndices) {
+			m_indexSize = sizeof(uint16_t);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint16_t) * indexChunks.indices.size(), indexChunks.indices.data(), bufferUsage);
+			countUpload(sizeof(uint16_t) * indexChunks.indices.size());
+			m_indexChunks = indexChunks.chunks;
+		}
+		else if (meshData.numIndices > 0) {
+			m_indexSize = sizeof(unsigned int);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * meshData.numIndices, meshData.indices, bufferUsage);
+			countUpload(sizeof(unsigned int) * meshData.numIndices);
+			m_indexChunks.push_back({ 0, (int)meshData.numIndices, 0 });
 		}
-		if (meshData.indices.size() > 0) {
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * meshData.indices.size(), meshData.indices.data(), GL_STATIC_DRAW);
+		if (meshData.numMorphVertices > 0) {
+			if (m_morphVbo == 0) {
+				glGenBuffers(1, &m_morphVbo);
+			}
+			//Morph target position, normal and UV (attributes 3-5) from binding 1
+			setVertexAttribFormats(format, 3, 1);
+			glBindVertexBuffer(1, m_morphVbo, 0, getVertexSize(format));
+			uploadVertices(m_morphVbo, meshData.morphVertices, meshData.numMorphVertices, indexChunks.duplicatedVertices, format, m_positionScale, m_positionOffset, bufferUsage);
 		}
-		m_numVertices = meshData.vertices.size();
-		m_numIndices = meshData.indices.size();
+		m_numVertices = (int)meshData.numVertices;
+		m_numIndices = (int)meshData.numIndices;
 
 		glBindVertexArray(0);
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	}
-	void Mesh::draw(ew::DrawMode drawMode) const
+	/// <summary>
+	/// Uploads per instance model matrices and colors for drawInstanced, replacing the previous set.
+	/// The whole set goes up in one call, so thousands of instances cost one upload per frame.
+	/// </summary>
+	void Mesh::setInstances(const InstanceData* instances, int count)
 	{
 		glBindVertexArray(m_vao);
+		if (m_instanceVbo == 0) {
+			glGenBuffers(1, &m_instanceVbo);
+			//Model matrix columns (attributes 6-9) and color (attribute 10) from binding 2, advancing once per instance
+			for (unsigned int i = 0; i < 4; i++)
+			{
+				glVertexAttribFormat(6 + i, 4, GL_FLOAT, GL_FALSE, offsetof(InstanceData, model) + sizeof(ew::Vec4) * i);
+				glVertexAttribBinding(6 + i, 2);
+				glEnableVertexAttribArray(6 + i);
+			}
+			glVertexAttribFormat(10, 4, GL_FLOAT, GL_FALSE, offsetof(InstanceData, color));
+			glVertexAttribBinding(10, 2);
+			glEnableVertexAttribArray(10);
+			glVertexBindingDivisor(2, 1);
+			glBindVertexBuffer(2, m_instanceVbo, 0, sizeof(InstanceData));
+		}
+		//Respecifying the store every upload lets the driver hand back fresh memory instead of waiting on draws still reading the old data
+		glBindBuffer(GL_ARRAY_BUFFER, m_instanceVbo);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(InstanceData) * count, instances, GL_STREAM_DRAW);
+		countUpload(sizeof(InstanceData) * count);
+		m_numInstances = count;
+
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+	void Mesh::draw(ew::DrawMode drawMode, bool bindVertexArray) const
+	{
+		if (bindVertexArray) {
+			glBindVertexArray(m_vao);
+		}
 		if (drawMode == DrawMode::TRIANGLES) {
-			glDrawElements(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, NULL);
+			GLenum indexType = m_indexSize == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+			for (const IndexChunk& chunk : m_indexChunks)
+			{
+				glDrawElementsBaseVertex(GL_TRIANGLES, chunk.numIndices, indexType, (const void*)((size_t)chunk.firstIndex * m_indexSize), chunk.baseVertex);
+				countDrawCall(chunk.numIndices / 3);
+			}
 		}
 		else {
 			glDrawArrays(GL_POINTS, 0, m_numVertices);
+			countDrawCall(0);
 		}
 		
 	}
+	/// <summary>
+	/// Draws the first count instances uploaded by setInstances in a single call per index chunk
+	/// </summary>
+	void Mesh::drawInstanced(int count, ew::DrawMode drawMode) const
+	{
+		count = count < m_numInstances ? count : m_numInstances;
+		if (count <= 0)
+			return;
+		glBindVertexArray(m_vao);
+		if (drawMode == DrawMode::TRIANGLES) {
+			GLenum indexType = m_indexSize == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+			for (const IndexChunk& chunk : m_indexChunks)
+			{
+				glDrawElementsInstancedBaseVertex(GL_TRIANGLES, chunk.numIndices, indexType, (const void*)((size_t)chunk.firstIndex * m_indexSize), count, chunk.baseVertex);
+				countDrawCall((int64_t)(chunk.numIndices / 3) * count);
+			}
+		}
+		else {
+			glDrawArraysInstanced(GL_POINTS, 0, m_numVertices, count);
+			countDrawCall(0);
+		}
+	}
 }
\ No newline at end of file
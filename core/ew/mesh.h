@@ -3,6 +3,7 @@
 */
 
 #pragma once
+#include <stdint.h>
 #include "ewMath/ewMath.h"
 
 namespace ew {
@@ -15,27 +16,117 @@ namespace ew {
 	struct MeshData {
 		std::vector<Vertex> vertices;
 		std::vector<unsigned int> indices;
+		//Optional morph target. When filled it must match vertices 1:1 and is blended in the vertex shader.
+		std::vector<Vertex> morphVertices;
 	};
 
+	//Non-owning view of mesh arrays, e.g. into a MeshData or a memory mapped mesh cache file
+	struct MeshDataView {
+		const Vertex* vertices = nullptr;
+		size_t numVertices = 0;
+		const unsigned int* indices = nullptr;
+		size_t numIndices = 0;
+		const Vertex* morphVertices = nullptr; //Optional, numMorphVertices must be 0 or numVertices
+		size_t numMorphVertices = 0;
+		MeshDataView() {};
+		MeshDataView(const MeshData& meshData)
+			: vertices(meshData.vertices.data()), numVertices(meshData.vertices.size()),
+			indices(meshData.indices.data()), numIndices(meshData.indices.size()),
+			morphVertices(meshData.morphVertices.data()), numMorphVertices(meshData.morphVertices.size()) {};
+	};
+
+	//Axis aligned box and bounding sphere of a mesh's positions, including morph target positions, in mesh space
+	struct MeshBounds {
+		ew::Vec3 min = ew::Vec3(0.0f);
+		ew::Vec3 max = ew::Vec3(0.0f);
+		ew::Vec3 center = ew::Vec3(0.0f); //Center of the box
+		float radius = 0.0f; //Sphere around center that holds every position
+	};
+	MeshBounds computeMeshBounds(const MeshDataView& meshData);
+
+	//Run of indices drawn with one glDrawElementsBaseVertex call
+	struct IndexChunk {
+		int firstIndex;
+		int numIndices;
+		int baseVertex;
+	};
+
+	//A mesh's indices split for a 16 bit index buffer, see buildIndexChunks
+	struct IndexChunks {
+		std::vector<uint16_t> indices; //Each chunk's indices minus its base vertex
+		std::vector<IndexChunk> chunks;
+		//Vertices to append after the mesh's own, as the index of the vertex each one copies.
+		//Triangles spanning more than 65536 vertices are drawn from these copies instead.
+		std::vector<unsigned int> duplicatedVertices;
+	};
+	void buildIndexChunks(const unsigned int* indices, size_t numIndices, size_t numVertices, IndexChunks& result);
+
 	enum class DrawMode {
 		TRIANGLES = 0,
 		POINTS = 1
 	};
 
+	//How often the mesh contents are expected to change
+	enum class MeshUsage {
+		STATIC = 0, //Uploaded once
+		DYNAMIC = 1, //Updated occasionally
+		STREAM = 2 //Updated every frame
+	};
+
+	//How vertices are stored in the vertex buffer. Packed formats are 16 bytes instead of 32
+	//and are decoded by decodePosition()/decodeNormal() in the vertex shader.
+	enum class VertexFormat {
+		FLOAT = 0, //vec3 position, vec3 normal, vec2 uv
+		HALF = 1, //Half float position, octahedral snorm16 normal, unorm16 uv
+		NORMALIZED = 2 //snorm16 position relative to the mesh bounds, octahedral snorm16 normal, unorm16 uv
+	};
+
+	//Per instance attributes for Mesh::drawInstanced, read from vertex buffer binding 2:
+	//model matrix columns at locations 6-9 (declare as "layout(location = 6) in mat4"), color at location 10
+	struct InstanceData {
+		ew::Mat4 model;
+		ew::Vec4 color = ew::Vec4(1.0f);
+	};
+
 	class Mesh {
 	public:
 		Mesh() {};
-		Mesh(const MeshData& meshData);
-		void load(const MeshData& meshData);
-		void draw(DrawMode drawMode = DrawMode::TRIANGLES)const;
+		Mesh(const MeshData& meshData, MeshUsage usage = MeshUsage::STATIC, VertexFormat format = VertexFormat::FLOAT);
+		Mesh(const MeshDataView& meshData, MeshUsage usage = MeshUsage::STATIC, VertexFormat format = VertexFormat::FLOAT);
+		void load(const MeshData& meshData, MeshUsage usage = MeshUsage::STATIC, VertexFormat format = VertexFormat::FLOAT);
+		void load(const MeshDataView& meshData, MeshUsage usage = MeshUsage::STATIC, VertexFormat format = VertexFormat::FLOAT);
+		//Pass bindVertexArray = false when the caller already bound getVertexArray(), e.g. through a GLStateCache
+		void draw(DrawMode drawMode = DrawMode::TRIANGLES, bool bindVertexArray = true)const;
+		void setInstances(const InstanceData* instances, int count);
+		void drawInstanced(int count, DrawMode drawMode = DrawMode::TRIANGLES)const;
+		inline unsigned int getVertexArray()const { return m_vao; }
 		inline int getNumVertices()const { return m_numVertices; }
 		inline int getNumIndices()const { return m_numIndices; }
+		inline bool hasMorphTarget()const { return m_morphVbo != 0; }
+		inline VertexFormat getVertexFormat()const { return m_vertexFormat; }
+		//Shader decode: position = stored * scale + offset. Identity unless the format is NORMALIZED.
+		inline const ew::Vec3& getPositionScale()const { return m_positionScale; }
+		inline const ew::Vec3& getPositionOffset()const { return m_positionOffset; }
+		//Bytes per index in the index buffer, 2 unless duplicating the vertices of triangles spanning more than 65536 vertices would cost more than it saves
+		inline int getIndexSize()const { return m_indexSize; }
+		inline int getNumIndexChunks()const { return (int)m_indexChunks.size(); }
+		inline const MeshBounds& getBounds()const { return m_bounds; }
+		inline int getNumInstances()const { return m_numInstances; }
 	private:
 		bool m_initialized = false;
 		unsigned int m_vao = 0;
 		unsigned int m_vbo = 0;
 		unsigned int m_ebo = 0;
+		unsigned int m_morphVbo = 0; //Morph target vertices, attributes 3-5
+		unsigned int m_instanceVbo = 0; //InstanceData, attributes 6-10
+		int m_numInstances = 0;
 		int m_numVertices = 0;
 		int m_numIndices = 0;
+		int m_indexSize = 4;
+		std::vector<IndexChunk> m_indexChunks;
+		VertexFormat m_vertexFormat = VertexFormat::FLOAT;
+		ew::Vec3 m_positionScale = ew::Vec3(1.0f);
+		ew::Vec3 m_positionOffset = ew::Vec3(0.0f);
+		MeshBounds m_bounds;
 	};
 }
\ No newline at end of file
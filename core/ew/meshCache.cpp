@@ -0,0 +1,102 @@
+#include "meshCache.h"
+#include "hash.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+namespace ew {
+	static uint64_t alignOffset(uint64_t offset) {
+		return (offset + 15) & ~15ull;
+	}
+
+	static bool isHeaderValid(const MappedFile& file, uint64_t key) {
+		if (file.getSize() < sizeof(MeshCacheHeader))
+			return false;
+		const MeshCacheHeader* header = (const MeshCacheHeader*)file.getData();
+		if (memcmp(header->magic, "EWMS", 4) != 0 || header->version != MESH_CACHE_VERSION || header->key != key)
+			return false;
+		if (header->numMorphVertices != 0 && header->numMorphVertices != header->numVertices)
+			return false;
+		return header->verticesOffset + header->numVertices * sizeof(Vertex) <= file.getSize()
+			&& header->indicesOffset + header->numIndices * sizeof(unsigned int) <= file.getSize()
+			&& header->morphVerticesOffset + header->numMorphVertices * sizeof(Vertex) <= file.getSize();
+	}
+
+	static bool writeMeshFile(const std::string& filePath, uint64_t key, const MeshData& meshData) {
+		MeshCacheHeader header = {};
+		memcpy(header.magic, "EWMS", 4);
+		header.version = MESH_CACHE_VERSION;
+		header.key = key;
+		header.numVertices = meshData.vertices.size();
+		header.numIndices = meshData.indices.size();
+		header.numMorphVertices = meshData.morphVertices.size();
+		header.verticesOffset = alignOffset(sizeof(MeshCacheHeader));
+		header.indicesOffset = alignOffset(header.verticesOffset + header.numVertices * sizeof(Vertex));
+		header.morphVerticesOffset = alignOffset(header.indicesOffset + header.numIndices * sizeof(unsigned int));
+
+		//Write to a temporary file first so a partial write is never mistaken for a valid cache
+		std::string tempPath = filePath + ".tmp";
+		FILE* file = fopen(tempPath.c_str(), "wb");
+		if (file == NULL)
+			return false;
+		const unsigned char padding[16] = {};
+		uint64_t position = 0;
+		auto writeAt = [&](uint64_t offset, const void* data, size_t size) {
+			bool ok = fwrite(padding, 1, (size_t)(offset - position), file) == offset - position;
+			ok &= fwrite(data, 1, size, file) == size;
+			position = offset + size;
+			return ok;
+		};
+		bool written = writeAt(0, &header, sizeof(header));
+		written &= writeAt(header.verticesOffset, meshData.vertices.data(), meshData.vertices.size() * sizeof(Vertex));
+		written &= writeAt(header.indicesOffset, meshData.indices.data(), meshData.indices.size() * sizeof(unsigned int));
+		written &= writeAt(header.morphVerticesOffset, meshData.morphVertices.data(), meshData.morphVertices.size() * sizeof(Vertex));
+		fclose(file);
+		remove(filePath.c_str());
+		if (!written || rename(tempPath.c_str(), filePath.c_str()) != 0) {
+			remove(tempPath.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	/// <summary>
+	/// Returns the mesh produced by generate() for these parameters. A hit maps the cache file and views it directly,
+	/// so it can go to Mesh::load without parsing or copying. A miss calls generate() and writes the result for next time.
+	/// </summary>
+	/// <param name="directory">Folder holding the cache files, which are named name_key.ewmesh</param>
+	/// <param name="name">Generator name, e.g. "sphere"</param>
+	/// <param name="params">Every parameter that affects the generated mesh</param>
+	/// <param name="generate">Builds the mesh on a cache miss</param>
+	CachedMeshData loadCachedMesh(const char* directory, const char* name, std::initializer_list<float> params, const std::function<MeshData()>& generate)
+	{
+		uint64_t key = hashBytes(name, strlen(name));
+		key = hashBytes(params.begin(), params.size() * sizeof(float), key);
+		char fileName[64];
+		snprintf(fileName, sizeof(fileName), "_%016llx.ewmesh", (unsigned long long)key);
+		std::string filePath = std::string(directory) + "/" + name + fileName;
+
+		CachedMeshData cached;
+		if (cached.m_file.open(filePath.c_str())) {
+			if (isHeaderValid(cached.m_file, key)) {
+				const unsigned char* data = cached.m_file.getData();
+				const MeshCacheHeader* header = (const MeshCacheHeader*)data;
+				cached.m_view.vertices = (const Vertex*)(data + header->verticesOffset);
+				cached.m_view.numVertices = (size_t)header->numVertices;
+				cached.m_view.indices = (const unsigned int*)(data + header->indicesOffset);
+				cached.m_view.numIndices = (size_t)header->numIndices;
+				cached.m_view.morphVertices = (const Vertex*)(data + header->morphVerticesOffset);
+				cached.m_view.numMorphVertices = (size_t)header->numMorphVertices;
+				return cached;
+			}
+			cached.m_file.close();
+		}
+
+		cached.m_meshData = generate();
+		cached.m_view = MeshDataView(cached.m_meshData);
+		if (!writeMeshFile(filePath, key, cached.m_meshData)) {
+			printf("Failed to write mesh cache %s", filePath.c_str());
+		}
+		return cached;
+	}
+}
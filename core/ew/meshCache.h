@@ -0,0 +1,41 @@
+#pragma once
+#include <stdint.h>
+#include <functional>
+#include <initializer_list>
+#include "mesh.h"
+#include "mappedFile.h"
+
+namespace ew {
+	//Bump when the file layout or the output of a cached generator changes, so stale files are regenerated
+	constexpr uint32_t MESH_CACHE_VERSION = 4;
+
+	//Layout of a .ewmesh file: this header followed by the vertex, index and morph vertex arrays, each 16 byte aligned
+	struct MeshCacheHeader {
+		char magic[4]; //"EWMS"
+		uint32_t version;
+		uint64_t key; //Hash of the generator name and parameters
+		uint64_t numVertices;
+		uint64_t numIndices;
+		uint64_t numMorphVertices;
+		uint64_t verticesOffset; //From the start of the file
+		uint64_t indicesOffset;
+		uint64_t morphVerticesOffset;
+	};
+
+	/// <summary>
+	/// Mesh arrays read from a memory mapped cache file, or generated on a cache miss.
+	/// The view stays valid for the lifetime of this object.
+	/// </summary>
+	class CachedMeshData {
+	public:
+		inline const MeshDataView& getView()const { return m_view; }
+		inline bool isMapped()const { return m_file.isOpen(); }
+	private:
+		friend CachedMeshData loadCachedMesh(const char* directory, const char* name, std::initializer_list<float> params, const std::function<MeshData()>& generate);
+		MappedFile m_file;
+		MeshData m_meshData;
+		MeshDataView m_view;
+	};
+
+	CachedMeshData loadCachedMesh(const char* directory, const char* name, std::initializer_list<float> params, const std::function<MeshData()>& generate);
+}
@@ -0,0 +1,522 @@
+#include "meshOptimizer.h"
+#include <stdio.h>
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+
+namespace ew {
+	//Cache size the vertex cache pass optimizes for. Larger than ACMR_CACHE_SIZE so it degrades gracefully on smaller caches.
+	static const int FORSYTH_CACHE_SIZE = 32;
+	//How much ACMR the overdraw pass may give up. Higher allows smaller clusters, which sort better.
+	static const float OVERDRAW_ACMR_THRESHOLD = 1.05f;
+	//Largest spread of vertex numbers within one optimization window, so a window fits 16 bit indices with one base vertex
+	static const int64_t WINDOW_VERTEX_RANGE = 0xFFFF;
+	//How far in front of a neighbor's plane, relative to edge length, a vertex may be before the mesh counts as concave there
+	static const float CONVEX_TOLERANCE = 1e-4f;
+
+	/// <summary>
+	/// Post-transform cache misses per triangle, simulated with a FIFO cache
+	/// </summary>
+	/// <param name="cacheSize">Entries in the simulated cache</param>
+	float computeACMR(const unsigned int* indices, size_t numIndices, int cacheSize) {
+		if (numIndices < 3)
+			return 0.0f;
+		unsigned int numVertices = *std::max_element(indices, indices + numIndices) + 1;
+		//A vertex is cached if it was inserted less than cacheSize misses ago
+		std::vector<unsigned int> insertedAt(numVertices, 0);
+		unsigned int timestamp = cacheSize + 1;
+		unsigned int misses = 0;
+		for (size_t i = 0; i < numIndices; i++)
+		{
+			unsigned int v = indices[i];
+			if (timestamp - insertedAt[v] > (unsigned int)cacheSize) {
+				insertedAt[v] = timestamp++;
+				misses++;
+			}
+		}
+		return (float)misses / (float)(numIndices / 3);
+	}
+
+	/// <summary>
+	/// Applies remap[oldIndex] = newIndex (or UINT32_MAX to drop) to the vertices, morph vertices and indices
+	/// </summary>
+	static void remapVertices(MeshData& meshData, const std::vector<unsigned int>& remap, unsigned int newCount) {
+		std::vector<Vertex> vertices(newCount);
+		std::vector<Vertex> morphVertices(meshData.morphVertices.empty() ? 0 : newCount);
+		for (size_t i = 0; i < remap.size(); i++)
+		{
+			if (remap[i] == UINT32_MAX)
+				continue;
+			vertices[remap[i]] = meshData.vertices[i];
+			if (!morphVertices.empty()) {
+				morphVertices[remap[i]] = meshData.morphVertices[i];
+			}
+		}
+		for (unsigned int& index : meshData.indices)
+		{
+			index = remap[index];
+		}
+		meshData.vertices.swap(vertices);
+		meshData.morphVertices.swap(morphVertices);
+	}
+
+	static bool hasZeroArea(const Vertex* vertices, unsigned int a, unsigned int b, unsigned int c) {
+		ew::Vec3 e1 = vertices[b].pos - vertices[a].pos;
+		ew::Vec3 e2 = vertices[c].pos - vertices[a].pos;
+		ew::Vec3 n = ew::Cross(e1, e2);
+		return ew::Dot(n, n) <= 1e-12f * ew::Dot(e1, e1) * ew::Dot(e2, e2);
+	}
+
+	/// <summary>
+	/// Drops triangles with repeated indices, or zero area in both the base and morph shapes, then vertices nothing references
+	/// </summary>
+	static void removeDegenerates(MeshData& meshData, MeshOptimizationReport& report) {
+		std::vector<unsigned int>& indices = meshData.indices;
+		bool hasMorph = !meshData.morphVertices.empty();
+		size_t numKept = 0;
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			unsigned int a = indices[i], b = indices[i + 1], c = indices[i + 2];
+			bool degenerate = a == b || b == c || a == c;
+			if (!degenerate) {
+				degenerate = hasZeroArea(meshData.vertices.data(), a, b, c) && (!hasMorph || hasZeroArea(meshData.morphVertices.data(), a, b, c));
+			}
+			if (degenerate) {
+				report.numDegenerateTriangles++;
+				continue;
+			}
+			indices[numKept++] = a;
+			indices[numKept++] = b;
+			indices[numKept++] = c;
+		}
+		indices.resize(numKept);
+
+		//Keep the original order of the surviving vertices
+		std::vector<unsigned int> remap(meshData.vertices.size(), UINT32_MAX);
+		for (unsigned int index : indices)
+		{
+			remap[index] = 0;
+		}
+		unsigned int numUsed = 0;
+		for (unsigned int& r : remap)
+		{
+			if (r != UINT32_MAX) {
+				r = numUsed++;
+			}
+		}
+		report.numUnusedVertices = (int)(meshData.vertices.size() - numUsed);
+		if (report.numUnusedVertices > 0) {
+			remapVertices(meshData, remap, numUsed);
+		}
+	}
+
+	static float forsythScore(int cachePosition, int numRemaining) {
+		if (numRemaining == 0)
+			return -1.0f;
+		float score = 0.0f;
+		if (cachePosition >= 0) {
+			//The last triangle's vertices get a fixed score so the next triangle doesn't just reuse the same edge
+			if (cachePosition < 3) {
+				score = 0.75f;
+			}
+			else {
+				score = powf(1.0f - (float)(cachePosition - 3) / (FORSYTH_CACHE_SIZE - 3), 1.5f);
+			}
+		}
+		//Favor vertices with few triangles left, so they get finished and drop out
+		return score + 2.0f / sqrtf((float)numRemaining);
+	}
+
+	/// <summary>
+	/// Forsyth's linear-speed vertex cache optimization. Greedily emits the highest scoring triangle among those
+	/// touching the simulated LRU cache, so consecutive triangles share vertices.
+	/// </summary>
+	static void optimizeVertexCache(std::vector<unsigned int>& indices, size_t numVertices) {
+		size_t numTriangles = indices.size() / 3;
+		if (numTriangles == 0)
+			return;
+
+		//Triangles adjacent to each vertex. The first numRemaining[v] entries are the ones not yet emitted.
+		std::vector<int> numRemaining(numVertices, 0);
+		for (unsigned int index : indices)
+		{
+			numRemaining[index]++;
+		}
+		std::vector<int> adjacencyStart(numVertices + 1, 0);
+		for (size_t v = 0; v < numVertices; v++)
+		{
+			adjacencyStart[v + 1] = adjacencyStart[v] + numRemaining[v];
+		}
+		std::vector<int> adjacency(indices.size());
+		std::vector<int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			adjacency[fill[indices[i]]++] = (int)(i / 3);
+		}
+
+		std::vector<int> cachePosition(numVertices, -1);
+		std::vector<float> vertexScore(numVertices);
+		for (size_t v = 0; v < numVertices; v++)
+		{
+			vertexScore[v] = forsythScore(-1, numRemaining[v]);
+		}
+		std::vector<char> isEmitted(numTriangles, 0);
+		int best = 0;
+		float bestScore = -1.0f;
+		for (size_t t = 0; t < numTriangles; t++)
+		{
+			float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+			if (score > bestScore) {
+				bestScore = score;
+				best = (int)t;
+			}
+		}
+
+		std::vector<unsigned int> result;
+		result.reserve(indices.size());
+		unsigned int cache[FORSYTH_CACHE_SIZE + 3];
+		int cacheCount = 0;
+		size_t nextUnemitted = 0;
+		while (result.size() < indices.size()) {
+			if (best < 0) {
+				//Nothing in the cache has triangles left, start over anywhere
+				while (isEmitted[nextUnemitted]) {
+					nextUnemitted++;
+				}
+				best = (int)nextUnemitted;
+			}
+			const unsigned int* triangle = &indices[best * 3];
+			isEmitted[best] = 1;
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int v = triangle[k];
+				result.push_back(v);
+				int* list = &adjacency[adjacencyStart[v]];
+				for (int j = 0; j < numRemaining[v]; j++)
+				{
+					if (list[j] == best) {
+						list[j] = list[numRemaining[v] - 1];
+						break;
+					}
+				}
+				numRemaining[v]--;
+			}
+
+			//Emitted vertices move to the front; anything pushed past the end is evicted
+			unsigned int newCache[FORSYTH_CACHE_SIZE + 3];
+			int newCount = 0;
+			for (int k = 0; k < 3; k++)
+			{
+				newCache[newCount++] = triangle[k];
+			}
+			for (int i = 0; i < cacheCount; i++)
+			{
+				unsigned int v = cache[i];
+				if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+					newCache[newCount++] = v;
+				}
+			}
+			for (int i = 0; i < newCount; i++)
+			{
+				unsigned int v = newCache[i];
+				cachePosition[v] = i < FORSYTH_CACHE_SIZE ? i : -1;
+				vertexScore[v] = forsythScore(cachePosition[v], numRemaining[v]);
+			}
+
+			best = -1;
+			bestScore = -1.0f;
+			for (int i = 0; i < newCount; i++)
+			{
+				unsigned int v = newCache[i];
+				const int* list = &adjacency[adjacencyStart[v]];
+				for (int j = 0; j < numRemaining[v]; j++)
+				{
+					int t = list[j];
+					float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+					if (score > bestScore) {
+						bestScore = score;
+						best = t;
+					}
+				}
+			}
+			cacheCount = std::min(newCount, FORSYTH_CACHE_SIZE);
+			std::copy(newCache, newCache + cacheCount, cache);
+		}
+		indices.swap(result);
+	}
+
+	/// <summary>
+	/// Tipsify style overdraw pass. Splits the cache optimized order into clusters, each short enough that starting it
+	/// with a cold cache keeps its ACMR within OVERDRAW_ACMR_THRESHOLD of the whole mesh, then draws outward facing
+	/// clusters first so they occlude the ones behind them. The order within each cluster is preserved.
+	/// </summary>
+	/// <param name="meshCentroid">Center of the whole mesh, which clusters are sorted by facing away from</param>
+	/// <returns>Number of clusters</returns>
+	static int optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, const ew::Vec3& meshCentroid) {
+		size_t numTriangles = indices.size() / 3;
+		if (numTriangles == 0)
+			return 0;
+
+		float targetAcmr = computeACMR(indices.data(), indices.size()) * OVERDRAW_ACMR_THRESHOLD;
+		std::vector<size_t> clusterStarts;
+		std::vector<unsigned int> insertedAt(vertices.size(), 0);
+		unsigned int timestamp = ACMR_CACHE_SIZE + 1;
+		size_t clusterStart = 0;
+		unsigned int clusterMisses = 0;
+		clusterStarts.push_back(0);
+		for (size_t t = 0; t < numTriangles; t++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int v = indices[t * 3 + k];
+				if (timestamp - insertedAt[v] > (unsigned int)ACMR_CACHE_SIZE) {
+					insertedAt[v] = timestamp++;
+					clusterMisses++;
+				}
+			}
+			//Cluster has paid off its cold start, end it and flush the simulated cache
+			if (t + 1 < numTriangles && (float)clusterMisses / (float)(t + 1 - clusterStart) <= targetAcmr) {
+				clusterStart = t + 1;
+				clusterMisses = 0;
+				timestamp += ACMR_CACHE_SIZE + 1;
+				clusterStarts.push_back(clusterStart);
+			}
+		}
+		clusterStarts.push_back(numTriangles);
+		int numClusters = (int)clusterStarts.size() - 1;
+
+		//Sort key: how far the cluster faces away from the mesh center
+		std::vector<float> keys(numClusters);
+		for (int c = 0; c < numClusters; c++)
+		{
+			ew::Vec3 centroid(0.0f);
+			ew::Vec3 normal(0.0f);
+			float area = 0.0f;
+			for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++)
+			{
+				const ew::Vec3& a = vertices[indices[t * 3]].pos;
+				const ew::Vec3& b = vertices[indices[t * 3 + 1]].pos;
+				const ew::Vec3& c2 = vertices[indices[t * 3 + 2]].pos;
+				ew::Vec3 n = ew::Cross(b - a, c2 - a);
+				float triangleArea = ew::Magnitude(n);
+				centroid += (a + b + c2) * (triangleArea / 3.0f);
+				normal += n;
+				area += triangleArea;
+			}
+			if (area > 0.0f) {
+				centroid = centroid * (1.0f / area);
+			}
+			float normalLength = ew::Magnitude(normal);
+			keys[c] = normalLength > 0.0f ? ew::Dot(centroid - meshCentroid, normal * (1.0f / normalLength)) : 0.0f;
+		}
+		std::vector<int> order(numClusters);
+		for (int c = 0; c < numClusters; c++)
+		{
+			order[c] = c;
+		}
+		std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return keys[a] > keys[b]; });
+
+		std::vector<unsigned int> result;
+		result.reserve(indices.size());
+		for (int c : order)
+		{
+			result.insert(result.end(), indices.begin() + clusterStarts[c] * 3, indices.begin() + clusterStarts[c + 1] * 3);
+		}
+		indices.swap(result);
+		return numClusters;
+	}
+
+	/// <summary>
+	/// Whether a triangle's neighbor folds away from it: positive if the neighbor's far vertex p is in front of
+	/// the triangle's plane, negative if behind, 0 if within CONVEX_TOLERANCE of it
+	/// </summary>
+	static int getFoldSide(const Vertex* vertices, const unsigned int* triangle, unsigned int p) {
+		const ew::Vec3& a = vertices[triangle[0]].pos;
+		ew::Vec3 n = ew::Cross(vertices[triangle[1]].pos - a, vertices[triangle[2]].pos - a);
+		ew::Vec3 d = vertices[p].pos - a;
+		float distance = ew::Dot(n, d);
+		float tolerance = CONVEX_TOLERANCE * ew::Magnitude(n) * ew::Magnitude(d);
+		return distance > tolerance ? 1 : (distance < -tolerance ? -1 : 0);
+	}
+
+	/// <summary>
+	/// True if every edge shared by two triangles folds the same way, so the surface never turns back on itself.
+	/// Closed meshes that pass are convex and open ones (planes, caps) can't cover themselves either:
+	/// with back faces culled, nothing in them is ever drawn over, so overdraw ordering gains nothing.
+	/// </summary>
+	static bool isLocallyConvex(const std::vector<unsigned int>& indices, const Vertex* vertices) {
+		//Every edge as (lower vertex, higher vertex, triangle), sorted so the triangles sharing an edge are adjacent
+		std::vector<std::pair<uint64_t, unsigned int>> edges;
+		edges.reserve(indices.size());
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			unsigned int a = indices[i];
+			unsigned int b = indices[i % 3 == 2 ? i - 2 : i + 1];
+			uint64_t key = a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+			edges.push_back({ key, (unsigned int)(i / 3) });
+		}
+		std::sort(edges.begin(), edges.end());
+		bool foldsForward = false;
+		bool foldsBack = false;
+		for (size_t i = 0; i + 1 < edges.size(); i++)
+		{
+			if (edges[i].first != edges[i + 1].first)
+				continue;
+			const unsigned int* triangles[2] = { &indices[edges[i].second * 3], &indices[edges[i + 1].second * 3] };
+			for (int j = 0; j < 2; j++)
+			{
+				//Vertex of the other triangle that isn't on the shared edge
+				const unsigned int* other = triangles[1 - j];
+				unsigned int a = (unsigned int)(edges[i].first >> 32), b = (unsigned int)edges[i].first;
+				unsigned int p = other[0] != a && other[0] != b ? other[0] : (other[1] != a && other[1] != b ? other[1] : other[2]);
+				int side = getFoldSide(vertices, triangles[j], p);
+				foldsForward |= side > 0;
+				foldsBack |= side < 0;
+			}
+			if (foldsForward && foldsBack)
+				return false;
+		}
+		return true;
+	}
+
+	/// <summary>
+	/// Reorders a triangle mesh for the GPU without changing what it looks like:
+	/// removes degenerate triangles and unused vertices, reorders triangles for the post-transform vertex cache and then
+	/// for overdraw, and finally renumbers vertices for fetch locality. Morph vertices are kept 1:1 with the vertices.
+	/// Reordering works on windows of consecutive input triangles, and vertices are numbered by first use as each window is
+	/// finished. A window ends before its vertex numbers would spread over more than 65536, so the result still splits
+	/// into as few 16 bit index chunks as the input (see buildIndexChunks) instead of scattering triangles across the mesh.
+	/// The overdraw pass is skipped for convex meshes, and a window keeps its overdraw order only if ACMR stays within
+	/// OVERDRAW_ACMR_THRESHOLD.
+	/// </summary>
+	/// <returns>ACMR after each pass</returns>
+	MeshOptimizationReport optimizeMesh(MeshData& meshData)
+	{
+		MeshOptimizationReport report;
+		std::vector<unsigned int>& indices = meshData.indices;
+		report.acmrInput = computeACMR(indices.data(), indices.size());
+
+		removeDegenerates(meshData, report);
+		report.acmrCleanup = computeACMR(indices.data(), indices.size());
+
+		report.isConvex = isLocallyConvex(indices, meshData.vertices.data())
+			&& (meshData.morphVertices.empty() || isLocallyConvex(indices, meshData.morphVertices.data()));
+		ew::Vec3 meshCentroid(0.0f);
+		for (const Vertex& v : meshData.vertices)
+		{
+			meshCentroid += v.pos;
+		}
+		meshCentroid = meshCentroid * (1.0f / (meshData.vertices.empty() ? 1 : meshData.vertices.size()));
+
+		size_t numVertices = meshData.vertices.size();
+		size_t numTriangles = indices.size() / 3;
+		std::vector<unsigned int> remap(numVertices, UINT32_MAX); //Final number of each vertex, once a window has used it
+		unsigned int numNumbered = 0;
+		std::vector<size_t> lastUse(numVertices, 0); //Last triangle that references each vertex
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			lastUse[indices[i]] = i / 3;
+		}
+		std::vector<int> windowOf(numVertices, -1); //Last window that referenced each vertex
+		std::vector<unsigned int> localOf(numVertices); //Number within that window
+		std::vector<unsigned int> windowVertices; //Window numbers back to mesh vertices
+		std::vector<unsigned int> window;
+		std::vector<unsigned int> cacheOrder; //Order after the vertex cache pass alone, for the report
+		std::vector<unsigned int> result;
+		cacheOrder.reserve(indices.size());
+		result.reserve(indices.size());
+		for (size_t windowStart = 0; windowStart < numTriangles;)
+		{
+			//Grow the window while the lowest numbered vertex it reuses and the last one it will number stay in range.
+			//A window always takes its first triangle, which only fails to fit if it reuses a vertex from long before.
+			int windowIndex = report.numWindows++;
+			windowVertices.clear();
+			int64_t lowest = numNumbered;
+			int64_t numNew = 0;
+			size_t windowEnd = windowStart;
+			for (; windowEnd < numTriangles; windowEnd++)
+			{
+				int64_t triangleLowest = lowest;
+				int64_t triangleNew = numNew;
+				for (int k = 0; k < 3; k++)
+				{
+					unsigned int v = indices[windowEnd * 3 + k];
+					if (remap[v] != UINT32_MAX) {
+						triangleLowest = std::min(triangleLowest, (int64_t)remap[v]);
+					}
+					else if (windowOf[v] != windowIndex) {
+						triangleNew++;
+					}
+				}
+				if (windowEnd > windowStart && numNumbered + triangleNew - 1 - triangleLowest > WINDOW_VERTEX_RANGE)
+					break;
+				lowest = triangleLowest;
+				numNew = triangleNew;
+				for (int k = 0; k < 3; k++)
+				{
+					unsigned int v = indices[windowEnd * 3 + k];
+					if (windowOf[v] != windowIndex) {
+						windowOf[v] = windowIndex;
+						localOf[v] = (unsigned int)windowVertices.size();
+						windowVertices.push_back(v);
+					}
+				}
+			}
+
+			window.clear();
+			for (size_t i = windowStart * 3; i < windowEnd * 3; i++)
+			{
+				window.push_back(localOf[indices[i]]);
+			}
+			optimizeVertexCache(window, windowVertices.size());
+			for (unsigned int v : window)
+			{
+				cacheOrder.push_back(windowVertices[v]);
+			}
+			if (!report.isConvex) {
+				std::vector<Vertex> localVertices(windowVertices.size());
+				for (size_t v = 0; v < windowVertices.size(); v++)
+				{
+					localVertices[v] = meshData.vertices[windowVertices[v]];
+				}
+				std::vector<unsigned int> overdrawOrder = window;
+				int numClusters = optimizeOverdraw(overdrawOrder, localVertices, meshCentroid);
+				if (computeACMR(overdrawOrder.data(), overdrawOrder.size()) <= computeACMR(window.data(), window.size()) * OVERDRAW_ACMR_THRESHOLD) {
+					window.swap(overdrawOrder);
+					report.numClusters += numClusters;
+				}
+			}
+			//Vertex fetch: number vertices in the order the window first uses them, so fetches walk memory forward.
+			//Vertices later windows share go last, keeping the next window's lowest reused number as high as possible.
+			for (int shared = 0; shared < 2; shared++)
+			{
+				for (unsigned int v : window)
+				{
+					unsigned int vertex = windowVertices[v];
+					if (remap[vertex] == UINT32_MAX && (shared == 1 || lastUse[vertex] < windowEnd)) {
+						remap[vertex] = numNumbered++;
+					}
+				}
+			}
+			for (unsigned int v : window)
+			{
+				result.push_back(windowVertices[v]);
+			}
+			windowStart = windowEnd;
+		}
+		report.acmrVertexCache = computeACMR(cacheOrder.data(), cacheOrder.size());
+		indices.swap(result);
+		report.acmrOverdraw = computeACMR(indices.data(), indices.size());
+
+		remapVertices(meshData, remap, numNumbered);
+		report.acmrVertexFetch = computeACMR(indices.data(), indices.size());
+		return report;
+	}
+
+	void printMeshOptimizationReport(const char* name, const MeshOptimizationReport& report)
+	{
+		printf("%s: ACMR %.3f, cleanup %.3f (-%d triangles, -%d vertices), vertex cache %.3f (%d windows), overdraw %.3f (%s%d clusters), vertex fetch %.3f\n",
+			name, report.acmrInput, report.acmrCleanup, report.numDegenerateTriangles, report.numUnusedVertices,
+			report.acmrVertexCache, report.numWindows, report.acmrOverdraw, report.isConvex ? "convex, " : "", report.numClusters, report.acmrVertexFetch);
+	}
+}
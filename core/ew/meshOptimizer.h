@@ -0,0 +1,25 @@
+#pragma once
+#include "mesh.h"
+
+namespace ew {
+	//Cache size used to measure ACMR, typical of the post-transform cache on current GPUs
+	constexpr int ACMR_CACHE_SIZE = 16;
+
+	//ACMR (post-transform cache misses per triangle, lower is better, 0.5 is ideal for a grid) after each optimizeMesh pass
+	struct MeshOptimizationReport {
+		float acmrInput = 0.0f;
+		float acmrCleanup = 0.0f; //After removing degenerate triangles and unused vertices
+		float acmrVertexCache = 0.0f; //After vertex cache reordering
+		float acmrOverdraw = 0.0f; //After cluster reordering for overdraw
+		float acmrVertexFetch = 0.0f; //After vertex remapping for fetch locality
+		int numDegenerateTriangles = 0;
+		int numUnusedVertices = 0;
+		int numClusters = 0; //Overdraw clusters kept, over all windows
+		int numWindows = 0; //Runs of triangles reordered separately, each within 65536 vertex numbers
+		bool isConvex = false; //Nothing in the mesh can be drawn over the rest, so the overdraw pass was skipped
+	};
+
+	float computeACMR(const unsigned int* indices, size_t numIndices, int cacheSize = ACMR_CACHE_SIZE);
+	MeshOptimizationReport optimizeMesh(MeshData& meshData);
+	void printMeshOptimizationReport(const char* name, const MeshOptimizationReport& report);
+}
@@ -0,0 +1,356 @@
+#include "noise.h"
+#include "ewMath/simd.h"
+#include <math.h>
+
+//Batches need integer lanes: SSE2 on x86, which every x64 CPU has, or NEON
+#if defined(EW_SIMD_SSE) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define EW_NOISE_SSE2 1
+#include <emmintrin.h>
+#if defined(__SSE4_1__) || defined(EW_SIMD_AVX)
+#include <smmintrin.h>
+#endif
+#elif defined(EW_SIMD_NEON)
+#define EW_NOISE_NEON 1
+#endif
+
+//No multiply-add fusing, which would round the scalar and batch paths differently. GCC and Clang get -ffp-contract=off from core/CMakeLists.txt.
+#if defined(_MSC_VER) && !defined(__clang__)
+#pragma fp_contract(off)
+#endif
+
+namespace ew {
+	//Skew from the cubic grid to the grid of simplices (tetrahedra), and back
+	static const float SKEW = 1.0f / 3.0f;
+	static const float UNSKEW = 1.0f / 6.0f;
+	//Lattice coordinates are multiplied by these before hashing so neighbouring cells get unrelated hashes
+	static const uint32_t PRIME_X = 501125321u;
+	static const uint32_t PRIME_Y = 1136930381u;
+	static const uint32_t PRIME_Z = 1720413743u;
+	static const uint32_t HASH_MULTIPLIER = 0x27d4eb2du;
+	//Squared radius each corner contributes within, and the scale that brings the sum to about [-1, 1]
+	static const float CORNER_RADIUS_SQ = 0.6f;
+	static const float NOISE_SCALE = 32.0f;
+	//Directions per stack buffer in fbmNoiseSphereRow
+	static const int ROW_CHUNK = 256;
+
+	static inline int fastFloor(float v) {
+		int i = (int)v;
+		return v < (float)i ? i - 1 : i;
+	}
+
+	static inline uint32_t hashCorner(uint32_t seed, uint32_t xPrimed, uint32_t yPrimed, uint32_t zPrimed) {
+		uint32_t hash = (seed ^ xPrimed ^ yPrimed ^ zPrimed) * HASH_MULTIPLIER;
+		return hash ^ (hash >> 15);
+	}
+
+	/// <summary>
+	/// Dot product of an offset with one of the 12 cube edge gradients, picked by the low 4 bits of hash (as in Perlin's improved noise)
+	/// </summary>
+	static inline float gradientDot(uint32_t hash, float x, float y, float z) {
+		uint32_t h = hash & 15;
+		float u = (h & 8) == 0 ? x : y;
+		float v = (h & 12) == 0 ? y : ((h & 13) == 12 ? x : z);
+		return ((h & 1) ? -u : u) + ((h & 2) ? -v : v);
+	}
+
+	static inline float cornerContribution(uint32_t hash, float x, float y, float z) {
+		float t = CORNER_RADIUS_SQ - x * x - y * y - z * z;
+		if (t <= 0.0f)
+			return 0.0f;
+		t *= t;
+		return t * t * gradientDot(hash, x, y, z);
+	}
+
+	/// <summary>
+	/// Gustavson's 3D simplex noise with a seeded hash in place of the permutation table
+	/// </summary>
+	float simplexNoise(float x, float y, float z, uint32_t seed)
+	{
+		//Cell of the skewed grid that contains the point, and the offset from its origin
+		float s = (x + y + z) * SKEW;
+		int i = fastFloor(x + s);
+		int j = fastFloor(y + s);
+		int k = fastFloor(z + s);
+		float t = (float)(i + j + k) * UNSKEW;
+		float x0 = x - ((float)i - t);
+		float y0 = y - ((float)j - t);
+		float z0 = z - ((float)k - t);
+
+		//The order of the offsets picks which of the cell's 6 tetrahedra the point is in, and so its second and third corners
+		bool xy = x0 >= y0;
+		bool yz = y0 >= z0;
+		bool xz = x0 >= z0;
+		int i1 = xy && xz;
+		int j1 = !xy && yz;
+		int k1 = !xz && !yz;
+		int i2 = xy || xz;
+		int j2 = !xy || yz;
+		int k2 = !(xz && yz);
+
+		float x1 = x0 - (float)i1 + UNSKEW;
+		float y1 = y0 - (float)j1 + UNSKEW;
+		float z1 = z0 - (float)k1 + UNSKEW;
+		float x2 = x0 - (float)i2 + 2.0f * UNSKEW;
+		float y2 = y0 - (float)j2 + 2.0f * UNSKEW;
+		float z2 = z0 - (float)k2 + 2.0f * UNSKEW;
+		float x3 = x0 - 1.0f + 3.0f * UNSKEW;
+		float y3 = y0 - 1.0f + 3.0f * UNSKEW;
+		float z3 = z0 - 1.0f + 3.0f * UNSKEW;
+
+		uint32_t xPrimed = (uint32_t)i * PRIME_X;
+		uint32_t yPrimed = (uint32_t)j * PRIME_Y;
+		uint32_t zPrimed = (uint32_t)k * PRIME_Z;
+		float n = cornerContribution(hashCorner(seed, xPrimed, yPrimed, zPrimed), x0, y0, z0);
+		n += cornerContribution(hashCorner(seed, xPrimed + (i1 ? PRIME_X : 0), yPrimed + (j1 ? PRIME_Y : 0), zPrimed + (k1 ? PRIME_Z : 0)), x1, y1, z1);
+		n += cornerContribution(hashCorner(seed, xPrimed + (i2 ? PRIME_X : 0), yPrimed + (j2 ? PRIME_Y : 0), zPrimed + (k2 ? PRIME_Z : 0)), x2, y2, z2);
+		n += cornerContribution(hashCorner(seed, xPrimed + PRIME_X, yPrimed + PRIME_Y, zPrimed + PRIME_Z), x3, y3, z3);
+		return n * NOISE_SCALE;
+	}
+
+	/// <summary>
+	/// Scale that divides an fBm sum by the total amplitude of its octaves
+	/// </summary>
+	static float getFbmNormalization(const FbmSettings& settings) {
+		float amplitude = 1.0f;
+		float amplitudeSum = 0.0f;
+		for (int octave = 0; octave < settings.octaves; octave++)
+		{
+			amplitudeSum += amplitude;
+			amplitude *= settings.gain;
+		}
+		return amplitudeSum > 0.0f ? 1.0f / amplitudeSum : 0.0f;
+	}
+
+	float fbmNoise(float x, float y, float z, const FbmSettings& settings)
+	{
+		float sum = 0.0f;
+		float amplitude = 1.0f;
+		float frequency = settings.frequency;
+		for (int octave = 0; octave < settings.octaves; octave++)
+		{
+			sum += simplexNoise(x * frequency, y * frequency, z * frequency, settings.seed + (uint32_t)octave) * amplitude;
+			amplitude *= settings.gain;
+			frequency *= settings.lacunarity;
+		}
+		return sum * getFbmNormalization(settings);
+	}
+
+	//Four lane helpers, so the batch kernel below is written once for both instruction sets.
+	//Masks are integer lanes with every bit set or clear.
+#if defined(EW_NOISE_SSE2)
+#define EW_NOISE_SIMD 1
+	typedef __m128 Floats;
+	typedef __m128i Ints;
+	static inline Floats splat(float v) { return _mm_set1_ps(v); }
+	static inline Ints splatInt(uint32_t v) { return _mm_set1_epi32((int)v); }
+	static inline Floats loadFloats(const float* p) { return _mm_loadu_ps(p); }
+	static inline void storeFloats(float* p, Floats v) { _mm_storeu_ps(p, v); }
+	static inline Floats addF(Floats a, Floats b) { return _mm_add_ps(a, b); }
+	static inline Floats subF(Floats a, Floats b) { return _mm_sub_ps(a, b); }
+	static inline Floats mulF(Floats a, Floats b) { return _mm_mul_ps(a, b); }
+	static inline Floats maxF(Floats a, Floats b) { return _mm_max_ps(a, b); }
+	static inline Ints addI(Ints a, Ints b) { return _mm_add_epi32(a, b); }
+	static inline Ints andI(Ints a, Ints b) { return _mm_and_si128(a, b); }
+	static inline Ints orI(Ints a, Ints b) { return _mm_or_si128(a, b); }
+	static inline Ints xorI(Ints a, Ints b) { return _mm_xor_si128(a, b); }
+	static inline Ints notI(Ints a) { return _mm_xor_si128(a, _mm_set1_epi32(-1)); }
+	static inline Ints mulI(Ints a, Ints b) {
+#if defined(__SSE4_1__) || defined(EW_SIMD_AVX)
+		return _mm_mullo_epi32(a, b);
+#else
+		//Low halves of the 64 bit products of the even and odd lanes, interleaved back together
+		__m128i even = _mm_mul_epu32(a, b);
+		__m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+		return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+#endif
+	}
+	template<int N> static inline Ints shiftLeft(Ints a) { return _mm_slli_epi32(a, N); }
+	template<int N> static inline Ints shiftRight(Ints a) { return _mm_srli_epi32(a, N); }
+	static inline Ints maskGe(Floats a, Floats b) { return _mm_castps_si128(_mm_cmpge_ps(a, b)); }
+	static inline Ints maskEq(Ints a, Ints b) { return _mm_cmpeq_epi32(a, b); }
+	static inline Floats select(Ints mask, Floats a, Floats b) {
+		__m128 m = _mm_castsi128_ps(mask);
+		return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+	}
+	static inline Floats maskF(Ints mask, Floats v) { return _mm_and_ps(_mm_castsi128_ps(mask), v); }
+	static inline Floats xorSign(Floats v, Ints signBits) { return _mm_xor_ps(v, _mm_castsi128_ps(signBits)); }
+	static inline Floats toFloats(Ints a) { return _mm_cvtepi32_ps(a); }
+	static inline Ints floorToInt(Floats v) {
+		__m128i i = _mm_cvttps_epi32(v);
+		//Truncation rounds negative values up; the all-ones mask is -1
+		return _mm_add_epi32(i, _mm_castps_si128(_mm_cmplt_ps(v, _mm_cvtepi32_ps(i))));
+	}
+#elif defined(EW_NOISE_NEON)
+#define EW_NOISE_SIMD 1
+	typedef float32x4_t Floats;
+	typedef uint32x4_t Ints;
+	static inline Floats splat(float v) { return vdupq_n_f32(v); }
+	static inline Ints splatInt(uint32_t v) { return vdupq_n_u32(v); }
+	static inline Floats loadFloats(const float* p) { return vld1q_f32(p); }
+	static inline void storeFloats(float* p, Floats v) { vst1q_f32(p, v); }
+	static inline Floats addF(Floats a, Floats b) { return vaddq_f32(a, b); }
+	static inline Floats subF(Floats a, Floats b) { return vsubq_f32(a, b); }
+	static inline Floats mulF(Floats a, Floats b) { return vmulq_f32(a, b); }
+	static inline Floats maxF(Floats a, Floats b) { return vmaxq_f32(a, b); }
+	static inline Ints addI(Ints a, Ints b) { return vaddq_u32(a, b); }
+	static inline Ints andI(Ints a, Ints b) { return vandq_u32(a, b); }
+	static inline Ints orI(Ints a, Ints b) { return vorrq_u32(a, b); }
+	static inline Ints xorI(Ints a, Ints b) { return veorq_u32(a, b); }
+	static inline Ints notI(Ints a) { return vmvnq_u32(a); }
+	static inline Ints mulI(Ints a, Ints b) { return vmulq_u32(a, b); }
+	template<int N> static inline Ints shiftLeft(Ints a) { return vshlq_n_u32(a, N); }
+	template<int N> static inline Ints shiftRight(Ints a) { return vshrq_n_u32(a, N); }
+	static inline Ints maskGe(Floats a, Floats b) { return vcgeq_f32(a, b); }
+	static inline Ints maskEq(Ints a, Ints b) { return vceqq_u32(a, b); }
+	static inline Floats select(Ints mask, Floats a, Floats b) { return vbslq_f32(mask, a, b); }
+	static inline Floats maskF(Ints mask, Floats v) { return vreinterpretq_f32_u32(vandq_u32(mask, vreinterpretq_u32_f32(v))); }
+	static inline Floats xorSign(Floats v, Ints signBits) { return vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(v), signBits)); }
+	static inline Floats toFloats(Ints a) { return vcvtq_f32_s32(vreinterpretq_s32_u32(a)); }
+	static inline Ints floorToInt(Floats v) {
+		int32x4_t i = vcvtq_s32_f32(v);
+		//Truncation rounds negative values up; the all-ones mask is -1
+		return vaddq_u32(vreinterpretq_u32_s32(i), vcltq_f32(v, vcvtq_f32_s32(i)));
+	}
+#endif
+
+#if defined(EW_NOISE_SIMD)
+	static inline Ints hashCorners(Ints seed, Ints xPrimed, Ints yPrimed, Ints zPrimed) {
+		Ints hash = mulI(xorI(xorI(seed, xPrimed), xorI(yPrimed, zPrimed)), splatInt(HASH_MULTIPLIER));
+		return xorI(hash, shiftRight<15>(hash));
+	}
+
+	static inline Floats gradientDots(Ints hash, Floats x, Floats y, Floats z) {
+		Ints zero = splatInt(0);
+		Floats u = select(maskEq(andI(hash, splatInt(8)), zero), x, y);
+		Floats v = select(maskEq(andI(hash, splatInt(12)), zero), y, select(maskEq(andI(hash, splatInt(13)), splatInt(12)), x, z));
+		//Bits 0 and 1 flip the signs of u and v
+		u = xorSign(u, shiftLeft<31>(hash));
+		v = xorSign(v, andI(shiftLeft<30>(hash), splatInt(0x80000000u)));
+		return addF(u, v);
+	}
+
+	static inline Floats cornerContributions(Ints hash, Floats x, Floats y, Floats z) {
+		Floats t = subF(subF(subF(splat(CORNER_RADIUS_SQ), mulF(x, x)), mulF(y, y)), mulF(z, z));
+		t = maxF(t, splat(0.0f));
+		t = mulF(t, t);
+		return mulF(mulF(t, t), gradientDots(hash, x, y, z));
+	}
+
+	/// <summary>
+	/// simplexNoise for four points, step for step, so results match the scalar version
+	/// </summary>
+	static inline Floats simplexNoise4(Floats x, Floats y, Floats z, Ints seed) {
+		Floats s = mulF(addF(addF(x, y), z), splat(SKEW));
+		Ints i = floorToInt(addF(x, s));
+		Ints j = floorToInt(addF(y, s));
+		Ints k = floorToInt(addF(z, s));
+		Floats t = mulF(toFloats(addI(addI(i, j), k)), splat(UNSKEW));
+		Floats x0 = subF(x, subF(toFloats(i), t));
+		Floats y0 = subF(y, subF(toFloats(j), t));
+		Floats z0 = subF(z, subF(toFloats(k), t));
+
+		Ints xy = maskGe(x0, y0);
+		Ints yz = maskGe(y0, z0);
+		Ints xz = maskGe(x0, z0);
+		Ints i1 = andI(xy, xz);
+		Ints j1 = andI(notI(xy), yz);
+		Ints k1 = andI(notI(xz), notI(yz));
+		Ints i2 = orI(xy, xz);
+		Ints j2 = orI(notI(xy), yz);
+		Ints k2 = notI(andI(xz, yz));
+
+		Floats one = splat(1.0f);
+		Floats x1 = addF(subF(x0, maskF(i1, one)), splat(UNSKEW));
+		Floats y1 = addF(subF(y0, maskF(j1, one)), splat(UNSKEW));
+		Floats z1 = addF(subF(z0, maskF(k1, one)), splat(UNSKEW));
+		Floats x2 = addF(subF(x0, maskF(i2, one)), splat(2.0f * UNSKEW));
+		Floats y2 = addF(subF(y0, maskF(j2, one)), splat(2.0f * UNSKEW));
+		Floats z2 = addF(subF(z0, maskF(k2, one)), splat(2.0f * UNSKEW));
+		Floats x3 = addF(subF(x0, one), splat(3.0f * UNSKEW));
+		Floats y3 = addF(subF(y0, one), splat(3.0f * UNSKEW));
+		Floats z3 = addF(subF(z0, one), splat(3.0f * UNSKEW));
+
+		Ints primeX = splatInt(PRIME_X);
+		Ints primeY = splatInt(PRIME_Y);
+		Ints primeZ = splatInt(PRIME_Z);
+		Ints xPrimed = mulI(i, primeX);
+		Ints yPrimed = mulI(j, primeY);
+		Ints zPrimed = mulI(k, primeZ);
+		Floats n = cornerContributions(hashCorners(seed, xPrimed, yPrimed, zPrimed), x0, y0, z0);
+		n = addF(n, cornerContributions(hashCorners(seed, addI(xPrimed, andI(i1, primeX)), addI(yPrimed, andI(j1, primeY)), addI(zPrimed, andI(k1, primeZ))), x1, y1, z1));
+		n = addF(n, cornerContributions(hashCorners(seed, addI(xPrimed, andI(i2, primeX)), addI(yPrimed, andI(j2, primeY)), addI(zPrimed, andI(k2, primeZ))), x2, y2, z2));
+		n = addF(n, cornerContributions(hashCorners(seed, addI(xPrimed, primeX), addI(yPrimed, primeY), addI(zPrimed, primeZ)), x3, y3, z3));
+		return mulF(n, splat(NOISE_SCALE));
+	}
+#endif
+
+	void simplexNoiseBatch(const float* x, const float* y, const float* z, float* result, int count, uint32_t seed)
+	{
+		int i = 0;
+#if defined(EW_NOISE_SIMD)
+		Ints seeds = splatInt(seed);
+		for (; i + 4 <= count; i += 4)
+		{
+			storeFloats(result + i, simplexNoise4(loadFloats(x + i), loadFloats(y + i), loadFloats(z + i), seeds));
+		}
+#endif
+		for (; i < count; i++)
+		{
+			result[i] = simplexNoise(x[i], y[i], z[i], seed);
+		}
+	}
+
+	/// <summary>
+	/// Runs every octave on four points before moving to the next four, so the points stay in registers
+	/// </summary>
+	void fbmNoiseBatch(const float* x, const float* y, const float* z, float* result, int count, const FbmSettings& settings)
+	{
+		int i = 0;
+#if defined(EW_NOISE_SIMD)
+		Floats normalization = splat(getFbmNormalization(settings));
+		for (; i + 4 <= count; i += 4)
+		{
+			Floats px = loadFloats(x + i);
+			Floats py = loadFloats(y + i);
+			Floats pz = loadFloats(z + i);
+			Floats sum = splat(0.0f);
+			float amplitude = 1.0f;
+			float frequency = settings.frequency;
+			for (int octave = 0; octave < settings.octaves; octave++)
+			{
+				Floats f = splat(frequency);
+				Floats n = simplexNoise4(mulF(px, f), mulF(py, f), mulF(pz, f), splatInt(settings.seed + (uint32_t)octave));
+				sum = addF(sum, mulF(n, splat(amplitude)));
+				amplitude *= settings.gain;
+				frequency *= settings.lacunarity;
+			}
+			storeFloats(result + i, mulF(sum, normalization));
+		}
+#endif
+		for (; i < count; i++)
+		{
+			result[i] = fbmNoise(x[i], y[i], z[i], settings);
+		}
+	}
+
+	void fbmNoiseSphereRow(float phi, float thetaStep, int count, const FbmSettings& settings, float* result)
+	{
+		float sinPhi = sinf(phi);
+		float cosPhi = cosf(phi);
+		float x[ROW_CHUNK];
+		float y[ROW_CHUNK];
+		float z[ROW_CHUNK];
+		for (int begin = 0; begin < count; begin += ROW_CHUNK)
+		{
+			int chunkSize = count - begin < ROW_CHUNK ? count - begin : ROW_CHUNK;
+			for (int col = 0; col < chunkSize; col++)
+			{
+				float theta = thetaStep * (begin + col);
+				x[col] = cosf(theta) * sinPhi;
+				y[col] = cosPhi;
+				z[col] = sinf(theta) * sinPhi;
+			}
+			fbmNoiseBatch(x, y, z, result + begin, chunkSize, settings);
+		}
+	}
+}
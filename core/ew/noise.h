@@ -0,0 +1,27 @@
+#pragma once
+#include <stdint.h>
+
+namespace ew {
+	//Fractal Brownian motion: octaves of simplex noise, each at lacunarity times the frequency and gain times the amplitude of the last
+	struct FbmSettings {
+		uint32_t seed = 0; //Same seed, same noise on every run and platform
+		int octaves = 6;
+		float frequency = 1.0f; //Of the first octave
+		float lacunarity = 2.0f;
+		float gain = 0.5f;
+	};
+
+	//3D simplex noise in roughly [-1, 1]. Each seed is an unrelated noise field.
+	float simplexNoise(float x, float y, float z, uint32_t seed);
+	//fBm normalized by the sum of the octave amplitudes, so also in roughly [-1, 1]
+	float fbmNoise(float x, float y, float z, const FbmSettings& settings);
+
+	//Batches evaluate four points at a time with SSE2 or NEON and return the same values as the single point functions,
+	//as long as noise.cpp is built without floating point contraction (see core/CMakeLists.txt). Checked by tests/noiseTest.cpp.
+	//Points are given as separate x, y and z arrays.
+	void simplexNoiseBatch(const float* x, const float* y, const float* z, float* result, int count, uint32_t seed);
+	void fbmNoiseBatch(const float* x, const float* y, const float* z, float* result, int count, const FbmSettings& settings);
+	//fBm at count unit sphere directions (cos(theta)sin(phi), cos(phi), sin(theta)sin(phi)) with theta = col * thetaStep,
+	//one row of a latitude/longitude grid like createEarth's
+	void fbmNoiseSphereRow(float phi, float thetaStep, int count, const FbmSettings& settings, float* result);
+}
@@ -0,0 +1,135 @@
+#include "parallel.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+
+namespace ew {
+	//Set on pool threads so nested parallelFor calls don't wait on themselves
+	static thread_local bool s_isWorkerThread = false;
+
+	/// <summary>
+	/// Fixed set of threads that sleep until parallelFor publishes a job, then pull chunks from it
+	/// </summary>
+	class WorkerPool {
+	public:
+		WorkerPool() {
+			int numThreads = (int)std::thread::hardware_concurrency();
+			//The calling thread also does work
+			for (int i = 1; i < numThreads; i++)
+			{
+				m_threads.emplace_back(&WorkerPool::workerLoop, this);
+			}
+		}
+		~WorkerPool() {
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_shutdown = true;
+			}
+			m_wake.notify_all();
+			for (std::thread& thread : m_threads)
+			{
+				thread.join();
+			}
+		}
+		inline int getNumThreads()const { return (int)m_threads.size() + 1; }
+
+		void run(int count, int chunkSize, const std::function<void(int, int)>& func) {
+			//One job at a time
+			std::lock_guard<std::mutex> submitLock(m_submitMutex);
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_func = &func;
+				m_count = count;
+				m_chunkSize = chunkSize;
+				m_nextItem = 0;
+				m_activeWorkers = (int)m_threads.size();
+				m_generation++;
+			}
+			m_wake.notify_all();
+			s_isWorkerThread = true;
+			runChunks();
+			s_isWorkerThread = false;
+
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_done.wait(lock, [this] { return m_activeWorkers == 0; });
+			m_func = nullptr;
+		}
+	private:
+		void runChunks() {
+			while (true) {
+				int begin = m_nextItem.fetch_add(m_chunkSize);
+				if (begin >= m_count)
+					break;
+				int end = begin + m_chunkSize < m_count ? begin + m_chunkSize : m_count;
+				(*m_func)(begin, end);
+			}
+		}
+		void workerLoop() {
+			s_isWorkerThread = true;
+			unsigned int seenGeneration = 0;
+			while (true) {
+				{
+					std::unique_lock<std::mutex> lock(m_mutex);
+					m_wake.wait(lock, [&] { return m_shutdown || m_generation != seenGeneration; });
+					if (m_shutdown)
+						return;
+					seenGeneration = m_generation;
+				}
+				runChunks();
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_activeWorkers--;
+				}
+				m_done.notify_one();
+			}
+		}
+
+		std::vector<std::thread> m_threads;
+		std::mutex m_submitMutex;
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		std::condition_variable m_done;
+		const std::function<void(int, int)>* m_func = nullptr;
+		int m_count = 0;
+		int m_chunkSize = 1;
+		std::atomic<int> m_nextItem{ 0 };
+		int m_activeWorkers = 0;
+		unsigned int m_generation = 0;
+		bool m_shutdown = false;
+	};
+
+	static WorkerPool& getWorkerPool() {
+		static WorkerPool pool;
+		return pool;
+	}
+
+	int getNumWorkerThreads()
+	{
+		return getWorkerPool().getNumThreads();
+	}
+
+	void parallelFor(int count, const std::function<void(int begin, int end)>& func, int minChunk)
+	{
+		if (count <= 0)
+			return;
+		if (minChunk < 1)
+			minChunk = 1;
+		if (s_isWorkerThread || count <= minChunk) {
+			func(0, count);
+			return;
+		}
+		WorkerPool& pool = getWorkerPool();
+		int numThreads = pool.getNumThreads();
+		if (numThreads <= 1) {
+			func(0, count);
+			return;
+		}
+		//A few chunks per thread so uneven rows still balance out
+		int chunkSize = count / (numThreads * 4);
+		if (chunkSize < minChunk)
+			chunkSize = minChunk;
+		pool.run(count, chunkSize, func);
+	}
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <functional>
+
+namespace ew {
+	//Number of threads parallelFor spreads work over, including the calling thread
+	int getNumWorkerThreads();
+
+	/// <summary>
+	/// Calls func(begin, end) on contiguous chunks covering [0, count), spread over a shared worker pool.
+	/// Returns once every chunk has run. Calls made from inside a worker run serially on that worker.
+	/// </summary>
+	/// <param name="count">Number of work items (e.g. rows)</param>
+	/// <param name="func">Called with a half open range of items</param>
+	/// <param name="minChunk">Smallest number of items handed to one thread</param>
+	void parallelFor(int count, const std::function<void(int begin, int end)>& func, int minChunk = 1);
+}
@@ -4,6 +4,8 @@
 
 
 #include "procGen.h"
+#include "parallel.h"
+#include "noise.h"
 #include <stdlib.h>
 
 namespace ew {
@@ -58,142 +60,137 @@ namespace ew {
 		return mesh;
 	}
 
+	//Rows handed to a single thread at minimum. Small meshes stay on the calling thread.
+	static const int MIN_ROWS_PER_THREAD = 16;
+
+	/// <summary>
+	/// Writes two triangles per grid cell, row by row, into a presized index array
+	/// </summary>
+	/// <param name="indices">Must hold subdivisions * subdivisions * 6 indices</param>
+	/// <param name="subdivisions">Number of cells per row and column</param>
+	static void createGridIndices(unsigned int* indices, int subdivisions) {
+		int columns = subdivisions + 1;
+		ew::parallelFor(subdivisions, [=](int rowBegin, int rowEnd) {
+			for (int row = rowBegin; row < rowEnd; row++)
+			{
+				unsigned int* out = indices + (size_t)row * subdivisions * 6;
+				for (int col = 0; col < subdivisions; col++)
+				{
+					int start = row * columns + col;
+					*out++ = start;
+					*out++ = start + 1;
+					*out++ = start + columns + 1;
+					*out++ = start + columns + 1;
+					*out++ = start + columns;
+					*out++ = start;
+				}
+			}
+		}, MIN_ROWS_PER_THREAD);
+	}
+
 	MeshData createPlane(float width, float height, int subdivisions)
 	{
 		//VERTICES
 		MeshData mesh;
 		int columns = subdivisions + 1;
-		for (size_t row = 0; row <= subdivisions; row++)
-		{
-			for (size_t col = 0; col <= subdivisions; col++)
+		mesh.vertices.resize((size_t)columns * columns);
+		Vertex* vertices = mesh.vertices.data();
+		ew::parallelFor(columns, [=](int rowBegin, int rowEnd) {
+			for (int row = rowBegin; row < rowEnd; row++)
 			{
-				Vertex v;
-				v.uv.x = ((float)col / subdivisions);
-				v.uv.y = ((float)row / subdivisions);
-				v.pos.x = -width/2 + width * v.uv.x;
-				v.pos.y = 0;
-				v.pos.z = height/2 -height * v.uv.y;
-				v.normal = ew::Vec3(0, 1, 0);
-				mesh.vertices.push_back(v);
+				for (int col = 0; col <= subdivisions; col++)
+				{
+					Vertex v;
+					v.uv.x = ((float)col / subdivisions);
+					v.uv.y = ((float)row / subdivisions);
+					v.pos.x = -width / 2 + width * v.uv.x;
+					v.pos.y = 0;
+					v.pos.z = height / 2 - height * v.uv.y;
+					v.normal = ew::Vec3(0, 1, 0);
+					vertices[row * columns + col] = v;
+				}
 			}
-		}
+		}, MIN_ROWS_PER_THREAD);
 		//INDICES
-		for (size_t row = 0; row < subdivisions; row++)
-		{
-			for (size_t col = 0; col < subdivisions; col++)
-			{
-				int start = row * columns + col;
-				mesh.indices.push_back(start);
-				mesh.indices.push_back(start + 1);
-				mesh.indices.push_back(start + columns + 1);
-				mesh.indices.push_back(start + columns + 1);
-				mesh.indices.push_back(start + columns);
-				mesh.indices.push_back(start);
-			}
-		}
+		mesh.indices.resize((size_t)subdivisions * subdivisions * 6);
+		createGridIndices(mesh.indices.data(), subdivisions);
 		return mesh;
 	}
 
-	float lerp(float a, float b, float f)
-	{
-		return a * (1.0 - f) + (b * f);
+	//Continent sized features on the first octave, down to about 1/32 of that on the last
+	static FbmSettings getEarthNoiseSettings() {
+		FbmSettings settings;
+		settings.seed = 1;
+		settings.octaves = 6;
+		settings.frequency = 2.0f;
+		return settings;
 	}
 
-	MeshData createEarth(float width, float height, float radius, int subdivisions, float scale, float intensity)
+	/// <summary>
+	/// Creates the earth as a morph target mesh. The flat map is stored in vertices and the globe in morphVertices,
+	/// on the same latitude/longitude grid, so the vertex shader can blend between them without regenerating the mesh.
+	/// </summary>
+	/// <param name="width">Width of the flat map</param>
+	/// <param name="height">Height of the flat map</param>
+	/// <param name="radius">Radius of the globe</param>
+	/// <param name="subdivisions">Rows and columns of quads</param>
+	/// <param name="intensity">Largest height of the fBm terrain above or below the surface. 0 leaves both flat and skips the noise.</param>
+	MeshData createEarth(float width, float height, float radius, int subdivisions, float intensity)
 	{
 		MeshData mesh;
+		FbmSettings noiseSettings = getEarthNoiseSettings();
 
 		//VERTICES
 		float thetaStep = ew::TAU / subdivisions;
 		float phiStep = ew::PI / subdivisions;
 		int columns = subdivisions + 1;
+		mesh.vertices.resize((size_t)columns * columns);
+		mesh.morphVertices.resize((size_t)columns * columns);
+		Vertex* planeVertices = mesh.vertices.data();
+		Vertex* sphereVertices = mesh.morphVertices.data();
 
-		for (size_t row = 0; row <= subdivisions; row++)
-		{
-			float phi = row * phiStep;
-			for (size_t col = 0; col <= subdivisions; col++)
+		ew::parallelFor(columns, [=](int rowBegin, int rowEnd) {
+			std::vector<float> rowHeights(columns, 0.0f);
+			for (int row = rowBegin; row < rowEnd; row++)
 			{
-				float theta = thetaStep * col;
-
-				Vertex v;
-
-				// BOB GET HEIGHT HERE
-				float earthHeight = 0.0f;
-
-				//---------------------plane
-
-				ew::Vec2 planeUV = ew::Vec2(0.0f);
-				planeUV.x = ((float)col / subdivisions);
-				planeUV.y = ((float)row / subdivisions);
-
-				ew::Vec3 planePosition = ew::Vec3(0.0f);
-				planePosition.x = -width / 2 + width * planeUV.x;
-				planePosition.z = earthHeight;
-				planePosition.y = height / 2 - height * planeUV.y;
-
-				ew::Vec3 planeNormal = ew::Vec3(0, 0, 1);
-
-				//---------------------sphere
+				float phi = row * phiStep;
+				//Sampled on the globe's directions, so the flat map gets the same heights and the seam and poles match up
+				if (intensity != 0.0f) {
+					fbmNoiseSphereRow(phi, thetaStep, columns, noiseSettings, rowHeights.data());
+				}
+				for (int col = 0; col <= subdivisions; col++)
+				{
+					float theta = thetaStep * col;
+					float earthHeight = rowHeights[col] * intensity;
 
-				ew::Vec3 sphereNormal = ew::Vec3(0.0f);
-				sphereNormal.x = cosf(theta) * sinf(phi);
-				sphereNormal.y = cosf(phi);
-				sphereNormal.z = sinf(theta) * sinf(phi);
+					//---------------------plane
 
-				ew::Vec3 spherePosition = ew::Vec3(0.0f);
-				spherePosition = sphereNormal * radius + earthHeight;
+					Vertex plane;
+					plane.uv.x = ((float)col / subdivisions);
+					plane.uv.y = ((float)row / subdivisions);
+					plane.pos.x = -width / 2 + width * plane.uv.x;
+					plane.pos.y = height / 2 - height * plane.uv.y;
+					plane.pos.z = earthHeight;
+					plane.normal = ew::Vec3(0, 0, 1);
+					planeVertices[row * columns + col] = plane;
 
-				ew::Vec2 sphereUV = ew::Vec2(0.0f);
-				sphereUV.x = (float)col / subdivisions;
-				sphereUV.y = 1.0 - ((float)row / subdivisions);
+					//---------------------sphere
 
-				v.pos = ew::Vec3(
-					lerp(planePosition.x, spherePosition.x, scale), 
-					lerp(planePosition.y, spherePosition.y, scale), 
-					lerp(planePosition.z, spherePosition.z, scale));
-				v.uv = ew::Vec2(
-					lerp(planeUV.x, sphereUV.x, scale),
-					lerp(planeUV.y, sphereUV.y, scale));
-				v.normal = ew::Vec3(
-					lerp(planeNormal.x, sphereNormal.x, scale),
-					lerp(planeNormal.y, sphereNormal.y, scale),
-					lerp(planeNormal.z, sphereNormal.z, scale));
-
-				mesh.vertices.push_back(v);
-			}
-		}
-		//VERTICES
-		for (size_t row = 0; row <= subdivisions; row++)
-		{
-			float phi = row * phiStep;
-			for (size_t col = 0; col <= subdivisions; col++)
-			{
-				float theta = thetaStep * col;
-				Vertex v;
-				v.normal.x = cosf(theta) * sinf(phi);
-				v.normal.y = cosf(phi);
-				v.normal.z = sinf(theta) * sinf(phi);
-				v.pos = v.normal * radius;
-				v.uv.x = (float)col / subdivisions;
-				v.uv.y = 1.0 - ((float)row / subdivisions);
-				mesh.vertices.push_back(v);
+					Vertex sphere;
+					sphere.normal.x = cosf(theta) * sinf(phi);
+					sphere.normal.y = cosf(phi);
+					sphere.normal.z = sinf(theta) * sinf(phi);
+					sphere.pos = sphere.normal * (radius + earthHeight);
+					sphere.uv.x = (float)col / subdivisions;
+					sphere.uv.y = 1.0 - ((float)row / subdivisions);
+					sphereVertices[row * columns + col] = sphere;
+				}
 			}
-		}
+		}, MIN_ROWS_PER_THREAD);
 
 		//INDICES
-		for (size_t row = 0; row < subdivisions; row++)
-		{
-			for (size_t col = 0; col < subdivisions; col++)
-			{
-				int start = row * columns + col;
-				mesh.indices.push_back(start);
-				mesh.indices.push_back(start + 1);
-				mesh.indices.push_back(start + columns + 1);
-				mesh.indices.push_back(start + columns + 1);
-				mesh.indices.push_back(start + columns);
-				mesh.indices.push_back(start);
-			}
-		}
+		mesh.indices.resize((size_t)subdivisions * subdivisions * 6);
+		createGridIndices(mesh.indices.data(), subdivisions);
 
 		return mesh;
 	}
@@ -204,56 +201,71 @@ namespace ew {
 		//VERTICES
 		float thetaStep = ew::TAU / subdivisions;
 		float phiStep = ew::PI / subdivisions;
-		for (size_t row = 0; row <= subdivisions; row++)
-		{
-			float phi = row * phiStep;
-			for (size_t col = 0; col <= subdivisions; col++)
+		unsigned int columns = subdivisions + 1;
+		mesh.vertices.resize((size_t)columns * columns);
+		Vertex* vertices = mesh.vertices.data();
+		ew::parallelFor(columns, [=](int rowBegin, int rowEnd) {
+			for (int row = rowBegin; row < rowEnd; row++)
 			{
-				float theta = thetaStep * col;
-				Vertex v;
-				v.normal.x = cosf(theta) * sinf(phi);
-				v.normal.y = cosf(phi);
-				v.normal.z = sinf(theta) * sinf(phi);
-				v.pos = v.normal * radius;
-				v.uv.x = (float)col / subdivisions;
-				v.uv.y = 1.0 - ((float)row / subdivisions);
-				mesh.vertices.push_back(v);
+				float phi = row * phiStep;
+				for (int col = 0; col <= subdivisions; col++)
+				{
+					float theta = thetaStep * col;
+					Vertex v;
+					v.normal.x = cosf(theta) * sinf(phi);
+					v.normal.y = cosf(phi);
+					v.normal.z = sinf(theta) * sinf(phi);
+					v.pos = v.normal * radius;
+					v.uv.x = (float)col / subdivisions;
+					v.uv.y = 1.0 - ((float)row / subdivisions);
+					vertices[row * columns + col] = v;
+				}
 			}
-		}
-		
+		}, MIN_ROWS_PER_THREAD);
+
 		//INDICES
-		unsigned int columns = subdivisions + 1;
+		//Top and bottom caps are one triangle per column, side rows 1..subdivisions-2 are two per column
+		int sideRows = subdivisions > 2 ? subdivisions - 2 : 0;
+		mesh.indices.resize((size_t)subdivisions * 6 + (size_t)sideRows * subdivisions * 6);
+		unsigned int* indices = mesh.indices.data();
 		unsigned int sideStart = columns;
 		unsigned int poleStart = 0;
 		//Top cap
-		for (size_t i = 0; i < subdivisions; i++)
+		unsigned int* out = indices;
+		for (int i = 0; i < subdivisions; i++)
 		{
-			mesh.indices.push_back(sideStart + i);
-			mesh.indices.push_back(poleStart + i);
-			mesh.indices.push_back(sideStart +i+1);
+			*out++ = sideStart + i;
+			*out++ = poleStart + i;
+			*out++ = sideStart + i + 1;
 		}
 		//Rows of quads for sides
-		for (size_t row = 1; row < subdivisions - 1; row++)
-		{
-			for (size_t col = 0; col < subdivisions; col++)
+		unsigned int* sideIndices = out;
+		ew::parallelFor(sideRows, [=](int rowBegin, int rowEnd) {
+			for (int sideRow = rowBegin; sideRow < rowEnd; sideRow++)
 			{
-				int start = row * columns + col;
-				mesh.indices.push_back(start);
-				mesh.indices.push_back(start + 1);
-				mesh.indices.push_back(start + columns);
-				mesh.indices.push_back(start + columns);
-				mesh.indices.push_back(start + 1);
-				mesh.indices.push_back(start + columns + 1);
+				int row = sideRow + 1;
+				unsigned int* rowOut = sideIndices + (size_t)sideRow * subdivisions * 6;
+				for (int col = 0; col < subdivisions; col++)
+				{
+					int start = row * columns + col;
+					*rowOut++ = start;
+					*rowOut++ = start + 1;
+					*rowOut++ = start + columns;
+					*rowOut++ = start + columns;
+					*rowOut++ = start + 1;
+					*rowOut++ = start + columns + 1;
+				}
 			}
-		}
+		}, MIN_ROWS_PER_THREAD);
+		out += (size_t)sideRows * subdivisions * 6;
 		//Bottom cap
 		poleStart = (columns * columns) - columns;
 		sideStart = poleStart - columns;
-		for (size_t i = 0; i < subdivisions; i++)
+		for (int i = 0; i < subdivisions; i++)
 		{
-			mesh.indices.push_back(sideStart + i);
-			mesh.indices.push_back(sideStart + i + 1);
-			mesh.indices.push_back(poleStart + i);
+			*out++ = sideStart + i;
+			*out++ = sideStart + i + 1;
+			*out++ = poleStart + i;
 		}
 		return mesh;
 	}
@@ -0,0 +1,269 @@
+#include "profiler.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <imgui.h>
+#include "external/glad.h"
+
+namespace ew {
+	void ProfilerHistory::push(float ms)
+	{
+		samples[next] = ms;
+		next = (next + 1) % PROFILER_HISTORY_LENGTH;
+		count = count < PROFILER_HISTORY_LENGTH ? count + 1 : count;
+	}
+	float ProfilerHistory::getLatest()const
+	{
+		return count > 0 ? samples[(next + PROFILER_HISTORY_LENGTH - 1) % PROFILER_HISTORY_LENGTH] : 0.0f;
+	}
+	float ProfilerHistory::getAverage()const
+	{
+		float sum = 0.0f;
+		for (int i = 0; i < count; i++)
+		{
+			sum += samples[i];
+		}
+		return count > 0 ? sum / count : 0.0f;
+	}
+	float ProfilerHistory::getMax()const
+	{
+		float max = 0.0f;
+		for (int i = 0; i < count; i++)
+		{
+			max = samples[i] > max ? samples[i] : max;
+		}
+		return max;
+	}
+
+	/// <summary>
+	/// Creates the GPU queries. Needs a current GL context.
+	/// </summary>
+	Profiler::Profiler()
+	{
+		glGenQueries(PROFILER_QUERY_FRAMES * PROFILER_MAX_ZONES, &m_queries[0][0]);
+		m_zones.reserve(PROFILER_MAX_ZONES);
+		m_zoneFrames.reserve(PROFILER_MAX_ZONES);
+	}
+	Profiler::~Profiler()
+	{
+		glDeleteQueries(PROFILER_QUERY_FRAMES * PROFILER_MAX_ZONES, &m_queries[0][0]);
+	}
+
+	/// <summary>
+	/// Finds the zone with this name, creating it if there is none
+	/// </summary>
+	/// <param name="gpu">Time the zone on the GPU too. Only used when the zone is created.</param>
+	/// <returns>Zone id, or -1 if there are already PROFILER_MAX_ZONES zones</returns>
+	int Profiler::getZoneId(const char* name, bool gpu)
+	{
+		for (size_t i = 0; i < m_zones.size(); i++)
+		{
+			if (m_zones[i].name == name)
+				return (int)i;
+		}
+		if (m_zones.size() >= PROFILER_MAX_ZONES) {
+			printf("Profiler has no room for zone %s\n", name);
+			return -1;
+		}
+		ProfilerZone zone;
+		zone.name = name;
+		zone.gpu = gpu;
+		m_zones.push_back(zone);
+		m_zoneFrames.push_back(ZoneFrame());
+		return (int)m_zones.size() - 1;
+	}
+
+	/// <summary>
+	/// Collects the GPU times of the queries issued in slot. Queries that have not finished are dropped rather than waited on.
+	/// </summary>
+	void Profiler::readGpuResults(int slot)
+	{
+		for (size_t i = 0; i < m_zones.size(); i++)
+		{
+			if (!m_zones[i].gpu)
+				continue;
+			if (!m_queryIssued[slot][i]) {
+				//Zone was not entered that frame
+				m_zones[i].gpuHistory.push(0.0f);
+				continue;
+			}
+			m_queryIssued[slot][i] = false;
+			GLint available = 0;
+			glGetQueryObjectiv(m_queries[slot][i], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available) {
+				m_numDroppedGpuSamples++;
+				continue;
+			}
+			GLuint64 nanoseconds = 0;
+			glGetQueryObjectui64v(m_queries[slot][i], GL_QUERY_RESULT, &nanoseconds);
+			m_zones[i].gpuHistory.push((float)(nanoseconds / 1.0e6));
+		}
+	}
+
+	/// <summary>
+	/// Starts timing a frame and reads back the GPU times of the frame that last used this frame's query slot.
+	/// Frame time is measured from one beginFrame to the next, so it includes the buffer swap.
+	/// Enabling or disabling the profiler takes effect here.
+	/// </summary>
+	void Profiler::beginFrame()
+	{
+		Clock::time_point now = Clock::now();
+		if (m_inFrame) {
+			endFrame();
+		}
+		if (m_hasFrameStart) {
+			m_frameHistory.push(std::chrono::duration<float, std::milli>(now - m_frameStart).count());
+		}
+		m_inFrame = m_hasFrameStart = m_enabled;
+		if (!m_inFrame)
+			return;
+		m_slot = (m_slot + 1) % PROFILER_QUERY_FRAMES;
+		readGpuResults(m_slot);
+		for (ZoneFrame& zoneFrame : m_zoneFrames)
+		{
+			zoneFrame = ZoneFrame();
+		}
+		m_openZones.clear();
+		m_openGpuZone = -1;
+		m_frameStart = now;
+	}
+
+	/// <summary>
+	/// Closes any zones left open and records this frame's CPU times
+	/// </summary>
+	void Profiler::endFrame()
+	{
+		if (!m_inFrame)
+			return;
+		while (!m_openZones.empty())
+		{
+			printf("Profiler zone %s was not closed\n", m_zones[m_openZones.back()].name.c_str());
+			endZone(m_openZones.back());
+		}
+		for (size_t i = 0; i < m_zones.size(); i++)
+		{
+			m_zones[i].cpuHistory.push(m_zoneFrames[i].cpuMs);
+		}
+		m_inFrame = false;
+	}
+
+	void Profiler::beginZone(int zone)
+	{
+		if (!m_inFrame || zone < 0)
+			return;
+		ProfilerZone& profilerZone = m_zones[zone];
+		ZoneFrame& zoneFrame = m_zoneFrames[zone];
+		profilerZone.parent = m_openZones.empty() ? -1 : m_openZones.back();
+		profilerZone.depth = (int)m_openZones.size();
+		m_openZones.push_back(zone);
+		if (zoneFrame.openCount++ == 0) {
+			zoneFrame.cpuStart = Clock::now();
+		}
+		if (profilerZone.gpu && m_openGpuZone < 0 && !zoneFrame.gpuTimed) {
+			glBeginQuery(GL_TIME_ELAPSED, m_queries[m_slot][zone]);
+			m_openGpuZone = zone;
+			zoneFrame.gpuTimed = true;
+			m_queryIssued[m_slot][zone] = true;
+		}
+	}
+
+	/// <summary>
+	/// Closes a zone. Zones must be closed in the reverse order they were opened.
+	/// </summary>
+	void Profiler::endZone(int zone)
+	{
+		if (!m_inFrame || zone < 0)
+			return;
+		if (m_openZones.empty() || m_openZones.back() != zone) {
+			printf("Profiler zone %s closed out of order\n", m_zones[zone].name.c_str());
+			return;
+		}
+		m_openZones.pop_back();
+		ZoneFrame& zoneFrame = m_zoneFrames[zone];
+		if (--zoneFrame.openCount == 0) {
+			zoneFrame.cpuMs += std::chrono::duration<float, std::milli>(Clock::now() - zoneFrame.cpuStart).count();
+		}
+		if (m_openGpuZone == zone) {
+			glEndQuery(GL_TIME_ELAPSED);
+			m_openGpuZone = -1;
+		}
+	}
+
+	/// <summary>
+	/// Plots a history oldest to newest
+	/// </summary>
+	static void plotHistory(const char* label, const ProfilerHistory& history, float height)
+	{
+		int offset = history.count < PROFILER_HISTORY_LENGTH ? 0 : history.next;
+		ImGui::PlotLines(label, history.samples, history.count, offset, nullptr, 0.0f, history.getMax(), ImVec2(0.0f, height));
+	}
+
+	/// <summary>
+	/// Appends parent's children to order, each followed by its own children.
+	/// Parents can change between frames, so the depth is capped in case they momentarily form a loop.
+	/// </summary>
+	static void appendZoneTree(const Profiler& profiler, int parent, std::vector<int>& order, int depth)
+	{
+		if (depth >= PROFILER_MAX_ZONES)
+			return;
+		for (int i = 0; i < profiler.getNumZones(); i++)
+		{
+			if (profiler.getZone(i).parent == parent) {
+				order.push_back(i);
+				appendZoneTree(profiler, i, order, depth + 1);
+			}
+		}
+	}
+
+	/// <summary>
+	/// Window with the frame time history and a table of zones, nested under the zone they were entered in.
+	/// Times are averaged over the history. The bar shows each zone's share of the frame, using the larger of its CPU and GPU time.
+	/// </summary>
+	void drawProfilerWindow(Profiler& profiler)
+	{
+		ImGui::Begin("Profiler");
+		bool enabled = profiler.isEnabled();
+		if (ImGui::Checkbox("Enabled", &enabled)) {
+			profiler.setEnabled(enabled);
+		}
+		const ProfilerHistory& frameHistory = profiler.getFrameHistory();
+		float frameMs = frameHistory.getAverage();
+		ImGui::Text("Frame: %.2f ms avg, %.2f ms max (%.0f FPS)", frameMs, frameHistory.getMax(), frameMs > 0.0f ? 1000.0f / frameMs : 0.0f);
+		plotHistory("##Frame", frameHistory, 40.0f);
+		if (profiler.getNumDroppedGpuSamples() > 0) {
+			ImGui::Text("%d GPU samples not ready in time", profiler.getNumDroppedGpuSamples());
+		}
+
+		std::vector<int> order;
+		appendZoneTree(profiler, -1, order, 0);
+		if (ImGui::BeginTable("Zones", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp)) {
+			ImGui::TableSetupColumn("Zone");
+			ImGui::TableSetupColumn("CPU ms");
+			ImGui::TableSetupColumn("GPU ms");
+			ImGui::TableSetupColumn("Share of frame");
+			ImGui::TableHeadersRow();
+			for (int index : order)
+			{
+				const ProfilerZone& zone = profiler.getZone(index);
+				float cpuMs = zone.cpuHistory.getAverage();
+				float gpuMs = zone.gpuHistory.getAverage();
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::Text("%*s%s", zone.depth * 2, "", zone.name.c_str());
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", cpuMs);
+				ImGui::TableNextColumn();
+				if (zone.gpu) {
+					ImGui::Text("%.3f", gpuMs);
+				}
+				else {
+					ImGui::TextUnformatted("-");
+				}
+				ImGui::TableNextColumn();
+				float share = frameMs > 0.0f ? (cpuMs > gpuMs ? cpuMs : gpuMs) / frameMs : 0.0f;
+				ImGui::ProgressBar(share > 1.0f ? 1.0f : share, ImVec2(-1.0f, 0.0f));
+			}
+			ImGui::EndTable();
+		}
+		ImGui::End();
+	}
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <chrono>
+
+namespace ew {
+	constexpr int PROFILER_MAX_ZONES = 32;
+	constexpr int PROFILER_HISTORY_LENGTH = 120;
+	//GPU queries are double buffered: a frame's results are read back when its query slot comes around again
+	constexpr int PROFILER_QUERY_FRAMES = 2;
+
+	//Last PROFILER_HISTORY_LENGTH samples of a time, in milliseconds
+	struct ProfilerHistory {
+		float samples[PROFILER_HISTORY_LENGTH] = {};
+		int next = 0; //Index the next sample is written to, which is also the oldest sample
+		int count = 0;
+		void push(float ms);
+		float getLatest()const;
+		float getAverage()const;
+		float getMax()const;
+	};
+
+	struct ProfilerZone {
+		std::string name;
+		int parent = -1; //Zone that was open when this one was last entered, -1 for top level zones
+		int depth = 0;
+		bool gpu = false; //Measured on the GPU as well as the CPU
+		ProfilerHistory cpuHistory;
+		ProfilerHistory gpuHistory;
+	};
+
+	/// <summary>
+	/// Frame profiler with named zones timed on the CPU and, optionally, on the GPU with GL_TIME_ELAPSED queries.
+	/// GPU results are read back PROFILER_QUERY_FRAMES frames later and only if already available, so timing never stalls the pipeline.
+	/// Time elapsed queries cannot overlap, so a GPU zone opened inside another GPU zone is timed on the CPU only.
+	/// A zone entered several times in a frame sums its CPU time; only the first entry is timed on the GPU.
+	/// </summary>
+	class Profiler {
+	public:
+		Profiler();
+		~Profiler();
+		Profiler(const Profiler&) = delete;
+		Profiler& operator=(const Profiler&) = delete;
+		void beginFrame();
+		void endFrame();
+		int getZoneId(const char* name, bool gpu = true);
+		void beginZone(int zone);
+		void endZone(int zone);
+		inline int getNumZones()const { return (int)m_zones.size(); }
+		inline const ProfilerZone& getZone(int zone)const { return m_zones[zone]; }
+		inline const ProfilerHistory& getFrameHistory()const { return m_frameHistory; }
+		inline int getNumDroppedGpuSamples()const { return m_numDroppedGpuSamples; }
+		inline bool isEnabled()const { return m_enabled; }
+		inline void setEnabled(bool enabled) { m_enabled = enabled; }
+	private:
+		typedef std::chrono::steady_clock Clock;
+		struct ZoneFrame {
+			Clock::time_point cpuStart;
+			float cpuMs = 0.0f;
+			int openCount = 0;
+			bool gpuTimed = false; //GPU query issued for this zone this frame
+		};
+		void readGpuResults(int slot);
+
+		std::vector<ProfilerZone> m_zones;
+		std::vector<ZoneFrame> m_zoneFrames;
+		unsigned int m_queries[PROFILER_QUERY_FRAMES][PROFILER_MAX_ZONES] = {};
+		bool m_queryIssued[PROFILER_QUERY_FRAMES][PROFILER_MAX_ZONES] = {};
+		std::vector<int> m_openZones; //CPU zone stack
+		int m_openGpuZone = -1;
+		int m_slot = 0;
+		bool m_inFrame = false;
+		bool m_hasFrameStart = false;
+		bool m_enabled = true;
+		Clock::time_point m_frameStart; //Start of the frame being profiled
+		ProfilerHistory m_frameHistory;
+		int m_numDroppedGpuSamples = 0;
+	};
+
+	//Opens a zone for the lifetime of the scope
+	class ProfileScope {
+	public:
+		ProfileScope(Profiler& profiler, int zone) :m_profiler(profiler), m_zone(zone) { m_profiler.beginZone(m_zone); }
+		ProfileScope(Profiler& profiler, const char* name, bool gpu = true) :ProfileScope(profiler, profiler.getZoneId(name, gpu)) {}
+		~ProfileScope() { m_profiler.endZone(m_zone); }
+		ProfileScope(const ProfileScope&) = delete;
+		ProfileScope& operator=(const ProfileScope&) = delete;
+	private:
+		Profiler& m_profiler;
+		int m_zone;
+	};
+
+	void drawProfilerWindow(Profiler& profiler);
+}
@@ -0,0 +1,121 @@
+#include "programCache.h"
+#include "hash.h"
+#include "textureCache.h"
+#include "external/glad.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+namespace ew {
+	static uint64_t hashString(const char* text, uint64_t hash) {
+		size_t length = text != nullptr ? strlen(text) : 0;
+		//Length first, so the boundary between two strings can't move without changing the hash
+		hash = hashBytes(&length, sizeof(length), hash);
+		return hashBytes(text, length, hash);
+	}
+
+	/// <summary>
+	/// Key of a program built from these sources by the current driver. A driver update changes the version string,
+	/// so binaries it can no longer load are rebuilt rather than offered to it. Needs a current GL context.
+	/// </summary>
+	uint64_t getProgramCacheKey(const std::string& vertexSource, const std::string& fragmentSource)
+	{
+		uint64_t hash = hashString(vertexSource.c_str(), HASH_SEED);
+		hash = hashString(fragmentSource.c_str(), hash);
+		hash = hashString((const char*)glGetString(GL_VENDOR), hash);
+		hash = hashString((const char*)glGetString(GL_RENDERER), hash);
+		return hashString((const char*)glGetString(GL_VERSION), hash);
+	}
+
+	/// <summary>
+	/// Name of a shader file without its directory and extension
+	/// </summary>
+	static std::string getStem(const std::string& filePath) {
+		size_t slash = filePath.find_last_of("/\\");
+		size_t start = slash == std::string::npos ? 0 : slash + 1;
+		size_t dot = filePath.find_last_of('.');
+		size_t end = dot == std::string::npos || dot < start ? filePath.size() : dot;
+		return filePath.substr(start, end - start);
+	}
+
+	/// <summary>
+	/// Cache file of a vertex and fragment shader pair, in the vertex shader's directory.
+	/// assets/terrain.vert with assets/defaultLit.frag caches to assets/terrain_defaultLit.glbin.
+	/// </summary>
+	std::string getProgramCachePath(const std::string& vertexShaderPath, const std::string& fragmentShaderPath)
+	{
+		size_t slash = vertexShaderPath.find_last_of("/\\");
+		std::string directory = slash == std::string::npos ? std::string() : vertexShaderPath.substr(0, slash + 1);
+		return directory + getStem(vertexShaderPath) + "_" + getStem(fragmentShaderPath) + ".glbin";
+	}
+
+	/// <summary>
+	/// Creates a program from a cached binary
+	/// </summary>
+	/// <returns>Linked program, or 0 if the file is missing, stale or rejected by the driver</returns>
+	unsigned int loadProgramBinary(const std::string& cachePath, uint64_t key)
+	{
+		std::vector<unsigned char> bytes;
+		if (!readFileBytes(cachePath.c_str(), bytes) || bytes.size() < sizeof(ProgramCacheHeader))
+			return 0;
+		ProgramCacheHeader header;
+		memcpy(&header, bytes.data(), sizeof(header));
+		if (memcmp(header.magic, "EWPB", 4) != 0 || header.version != PROGRAM_CACHE_VERSION || header.key != key
+			|| sizeof(ProgramCacheHeader) + header.binarySize > bytes.size())
+			return 0;
+
+		unsigned int program = glCreateProgram();
+		glProgramBinary(program, header.binaryFormat, bytes.data() + sizeof(ProgramCacheHeader), header.binarySize);
+		int success = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success) {
+			printf("Program binary %s rejected by the driver, compiling from source\n", cachePath.c_str());
+			glDeleteProgram(program);
+			return 0;
+		}
+		return program;
+	}
+
+	/// <summary>
+	/// Writes a linked program's binary for loadProgramBinary. The program should have been linked with
+	/// GL_PROGRAM_BINARY_RETRIEVABLE_HINT set, or some drivers return nothing.
+	/// </summary>
+	/// <returns>False if the program isn't linked, the driver has no binary formats or the file can't be written</returns>
+	bool saveProgramBinary(const std::string& cachePath, uint64_t key, unsigned int program)
+	{
+		int success = 0;
+		int binarySize = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binarySize);
+		if (!success || binarySize <= 0)
+			return false;
+		std::vector<unsigned char> binary(binarySize);
+		GLenum binaryFormat = 0;
+		GLsizei length = 0;
+		glGetProgramBinary(program, binarySize, &length, &binaryFormat, binary.data());
+		if (length <= 0)
+			return false;
+
+		ProgramCacheHeader header = {};
+		memcpy(header.magic, "EWPB", 4);
+		header.version = PROGRAM_CACHE_VERSION;
+		header.key = key;
+		header.binaryFormat = binaryFormat;
+		header.binarySize = (uint32_t)length;
+
+		//Write to a temporary file first so a partial write is never mistaken for a valid cache
+		std::string tempPath = cachePath + ".tmp";
+		FILE* file = fopen(tempPath.c_str(), "wb");
+		if (file == NULL)
+			return false;
+		bool written = fwrite(&header, 1, sizeof(header), file) == sizeof(header);
+		written &= fwrite(binary.data(), 1, (size_t)length, file) == (size_t)length;
+		fclose(file);
+		remove(cachePath.c_str());
+		if (!written || rename(tempPath.c_str(), cachePath.c_str()) != 0) {
+			remove(tempPath.c_str());
+			return false;
+		}
+		return true;
+	}
+}
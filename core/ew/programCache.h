@@ -0,0 +1,22 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+
+namespace ew {
+	//Bump when the file layout changes
+	constexpr uint32_t PROGRAM_CACHE_VERSION = 1;
+
+	//Layout of a .glbin file: this header followed by the driver's program binary
+	struct ProgramCacheHeader {
+		char magic[4]; //"EWPB"
+		uint32_t version;
+		uint64_t key; //Hash of the shader sources and the driver's vendor, renderer and version strings
+		uint32_t binaryFormat; //As returned by glGetProgramBinary
+		uint32_t binarySize;
+	};
+
+	uint64_t getProgramCacheKey(const std::string& vertexSource, const std::string& fragmentSource);
+	std::string getProgramCachePath(const std::string& vertexShaderPath, const std::string& fragmentShaderPath);
+	unsigned int loadProgramBinary(const std::string& cachePath, uint64_t key);
+	bool saveProgramBinary(const std::string& cachePath, uint64_t key, unsigned int program);
+}
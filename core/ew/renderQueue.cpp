@@ -0,0 +1,90 @@
+#include "renderQueue.h"
+#include <string.h>
+#include <algorithm>
+#include "hash.h"
+#include "profiler.h"
+
+namespace ew {
+	/// <summary>
+	/// Solid: pass (4 bits) | program (12) | texture set (16) | depth (32), so state changes are minimized and ties draw front to back.
+	/// Blended: pass (4 bits) | inverted depth (32) | program (12) | texture set (16), because blending needs back to front order first.
+	/// </summary>
+	uint64_t makeSortKey(RenderPass pass, unsigned int program, uint16_t textureSet, float depth) {
+		//Non-negative floats order the same as their bit patterns
+		depth = depth > 0.0f ? depth : 0.0f;
+		uint32_t depthBits;
+		memcpy(&depthBits, &depth, sizeof(depthBits));
+		uint64_t key = (uint64_t)pass << 60;
+		uint64_t programBits = program & 0xFFF;
+		if (pass == RenderPass::BLENDED) {
+			key |= (uint64_t)(~depthBits) << 28;
+			key |= programBits << 16;
+			key |= textureSet;
+		}
+		else {
+			key |= programBits << 48;
+			key |= (uint64_t)textureSet << 32;
+			key |= depthBits;
+		}
+		return key;
+	}
+
+	void RenderQueue::submit(const DrawItem& item)
+	{
+		m_items.push_back(item);
+		DrawItem& added = m_items.back();
+		//Identical texture bindings hash to the same set
+		uint16_t textureSet = (uint16_t)hashBytes(added.textures, sizeof(TextureBinding) * added.numTextures);
+		added.sortKey = makeSortKey(added.pass, added.shader->getId(), textureSet, added.depth);
+	}
+
+	/// <summary>
+	/// Draws everything submitted since the last flush in sort key order, then empties the queue.
+	/// Submission order breaks ties. Bindings are assumed unknown on entry.
+	/// With a profiler, each item's uniforms and draw are timed in its profile zone.
+	/// </summary>
+	void RenderQueue::flush(Profiler* profiler)
+	{
+		m_order.resize(m_items.size());
+		for (size_t i = 0; i < m_order.size(); i++)
+		{
+			m_order[i] = (uint32_t)i;
+		}
+		std::stable_sort(m_order.begin(), m_order.end(), [&](uint32_t a, uint32_t b) {
+			return m_items[a].sortKey < m_items[b].sortKey;
+		});
+
+		m_stateCache.invalidate();
+		m_stateCache.resetStats();
+		for (uint32_t index : m_order)
+		{
+			const DrawItem& item = m_items[index];
+			m_stateCache.useProgram(item.shader->getId());
+			for (int i = 0; i < item.numTextures; i++)
+			{
+				m_stateCache.bindTexture(item.textures[i].unit, item.textures[i].target, item.textures[i].texture);
+			}
+			if (profiler) {
+				profiler->beginZone(item.profileZone);
+			}
+			if (item.setUniforms) {
+				item.setUniforms();
+			}
+			if (item.draw) {
+				item.draw();
+				//Custom draws bind their own vertex arrays
+				m_stateCache.invalidateVertexArray();
+			}
+			else if (item.mesh) {
+				m_stateCache.bindVertexArray(item.mesh->getVertexArray());
+				item.mesh->draw(DrawMode::TRIANGLES, false);
+			}
+			if (profiler) {
+				profiler->endZone(item.profileZone);
+			}
+		}
+		m_stats.numItems = (int)m_items.size();
+		m_stats.state = m_stateCache.getStats();
+		m_items.clear();
+	}
+}
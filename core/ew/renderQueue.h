@@ -0,0 +1,69 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <functional>
+#include "glStateCache.h"
+#include "shader.h"
+#include "mesh.h"
+
+namespace ew {
+	class Profiler;
+
+	constexpr int MAX_DRAW_TEXTURES = 4;
+
+	//Passes are drawn in this order
+	enum class RenderPass {
+		SOLID = 0, //Sorted by program, then textures, then front to back
+		BLENDED = 1 //Sorted back to front, then by program and textures
+	};
+
+	struct TextureBinding {
+		int unit;
+		unsigned int target; //GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY...
+		unsigned int texture;
+	};
+
+	struct DrawItem {
+		RenderPass pass = RenderPass::SOLID;
+		float depth = 0.0f; //Distance from the camera
+		const Shader* shader = nullptr;
+		const Mesh* mesh = nullptr;
+		TextureBinding textures[MAX_DRAW_TEXTURES] = {};
+		int numTextures = 0;
+		std::function<void()> setUniforms; //Optional, called with the shader in use and textures bound
+		std::function<void()> draw; //Optional, replaces mesh->draw() for items that issue their own draw calls
+		int profileZone = -1; //Profiler zone the item is timed in, -1 for none
+		uint64_t sortKey = 0; //Set by RenderQueue::submit
+		inline void addTexture(int unit, unsigned int target, unsigned int texture) {
+			if (numTextures < MAX_DRAW_TEXTURES) {
+				textures[numTextures++] = { unit, target, texture };
+			}
+		}
+	};
+
+	//What the last RenderQueue::flush drew and how many binds the state cache saved
+	struct RenderQueueStats {
+		int numItems = 0;
+		StateCacheStats state;
+		inline int getNumSaved()const { return state.programBindsSkipped + state.vertexArrayBindsSkipped + state.textureBindsSkipped; }
+	};
+
+	uint64_t makeSortKey(RenderPass pass, unsigned int program, uint16_t textureSet, float depth);
+
+	/// <summary>
+	/// Collects a frame's draws, sorts them by a 64 bit key (pass, program, texture set, depth)
+	/// and submits them through a GLStateCache, so each program and texture is bound once per run of draws that share it.
+	/// </summary>
+	class RenderQueue {
+	public:
+		void submit(const DrawItem& item);
+		void flush(Profiler* profiler = nullptr);
+		inline const RenderQueueStats& getStats()const { return m_stats; }
+		inline GLStateCache& getStateCache() { return m_stateCache; }
+	private:
+		std::vector<DrawItem> m_items;
+		std::vector<uint32_t> m_order;
+		GLStateCache m_stateCache;
+		RenderQueueStats m_stats;
+	};
+}
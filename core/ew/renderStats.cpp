@@ -0,0 +1,23 @@
+#include "renderStats.h"
+
+namespace ew {
+	static RenderStats s_renderStats;
+
+	const RenderStats& getRenderStats()
+	{
+		return s_renderStats;
+	}
+	void resetRenderStats()
+	{
+		s_renderStats = RenderStats();
+	}
+	void countDrawCall(int64_t triangles)
+	{
+		s_renderStats.drawCalls++;
+		s_renderStats.triangles += triangles;
+	}
+	void countUpload(size_t bytes)
+	{
+		s_renderStats.uploadBytes += (int64_t)bytes;
+	}
+}
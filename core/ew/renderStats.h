@@ -0,0 +1,18 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+namespace ew {
+	//Draw calls and bytes copied from the CPU to GL buffers and textures by core, since the last resetRenderStats().
+	//Counted on the render thread only.
+	struct RenderStats {
+		int64_t drawCalls = 0;
+		int64_t triangles = 0; //Including every instance of instanced draws
+		int64_t uploadBytes = 0;
+	};
+
+	const RenderStats& getRenderStats();
+	void resetRenderStats();
+	void countDrawCall(int64_t triangles);
+	void countUpload(size_t bytes);
+}
@@ -1,18 +1,18 @@
 #include "shader.h"
+#include "programCache.h"
+#include "uniformBuffer.h"
+#include "vertexFormat.h"
+#include "virtualTexture.h"
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 #include "external/glad.h"
 
 namespace ew {
-	/// <summary>
-	/// Loads shader source code from a file.
-	/// </summary>
-	/// <param name="filePath"></param>
-	/// <returns></returns>
-	std::string loadShaderSourceFromFile(const std::string& filePath) {
+	static std::string readShaderFile(const std::string& filePath) {
 		std::ifstream fstream(filePath);
 		if (!fstream.is_open()) {
-			printf("Failed to load file %s", filePath.c_str());
+			printf("Failed to load file %s\n", filePath.c_str());
 			return {};
 		}
 		std::stringstream buffer;
@@ -20,6 +20,71 @@ namespace ew {
 		return buffer.str();
 	}
 
+	/// <summary>
+	/// GLSL that has to match core's C++ side. Each is defined next to that code and included by name.
+	/// </summary>
+	static const char* getBuiltinShaderInclude(const std::string& name) {
+		if (name == "ew/uniformBuffer.glsl")
+			return UNIFORM_BUFFER_GLSL;
+		if (name == "ew/vertexFormat.glsl")
+			return VERTEX_FORMAT_GLSL;
+		if (name == "ew/virtualTexture.glsl")
+			return VIRTUAL_TEXTURE_GLSL;
+		return nullptr;
+	}
+
+	/// <summary>
+	/// Appends source to result with every #include "name" line replaced by that source, expanded the same way.
+	/// Names are built in includes (see getBuiltinShaderInclude) or files relative to the including file.
+	/// Each is included once. Included sources get their own GLSL source string number, in include order,
+	/// so compile errors point at number(line).
+	/// </summary>
+	static void expandShaderIncludes(const std::string& source, const std::string& filePath, int sourceNumber, std::vector<std::string>& included, std::string& result) {
+		std::string directory = filePath.substr(0, filePath.find_last_of("/\\") + 1);
+		std::istringstream lines(source);
+		std::string line;
+		int lineNumber = 0;
+		while (std::getline(lines, line)) {
+			lineNumber++;
+			size_t start = line.find_first_not_of(" \t");
+			size_t open = start == std::string::npos || line.compare(start, 8, "#include") != 0 ? std::string::npos : line.find('"', start + 8);
+			size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+			if (close == std::string::npos) {
+				if (open != std::string::npos)
+					printf("Malformed #include in %s line %d\n", filePath.c_str(), lineNumber);
+				result += line;
+				result += '\n';
+				continue;
+			}
+			std::string name = line.substr(open + 1, close - open - 1);
+			const char* builtin = getBuiltinShaderInclude(name);
+			std::string includePath = builtin != nullptr ? name : directory + name;
+			//Keep the line, so line numbers after it don't move
+			result += '\n';
+			if (std::find(included.begin(), included.end(), includePath) != included.end())
+				continue;
+			included.push_back(includePath);
+			int includeNumber = (int)included.size();
+			result += "#line 1 " + std::to_string(includeNumber) + "\n";
+			expandShaderIncludes(builtin != nullptr ? std::string(builtin) : readShaderFile(includePath), includePath, includeNumber, included, result);
+			result += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(sourceNumber) + "\n";
+		}
+	}
+
+	/// <summary>
+	/// Loads shader source code from a file, expanding #include "name" lines.
+	/// Program cache keys hash the expanded source, so editing an include recompiles every program using it.
+	/// </summary>
+	/// <param name="filePath"></param>
+	/// <returns></returns>
+	std::string loadShaderSourceFromFile(const std::string& filePath) {
+		std::string source = readShaderFile(filePath);
+		std::string result;
+		std::vector<std::string> included;
+		expandShaderIncludes(source, filePath, 0, included, result);
+		return result;
+	}
+
 	/// <summary>
 	/// Creates and compiles a shader object of a given type
 	/// </summary>
@@ -49,8 +114,9 @@ namespace ew {
 	/// </summary>
 	/// <param name="vertexShaderSource">GLSL source code for the vertex shader</param>
 	/// <param name="fragmentShaderSource">GLSL source code for the fragment shader</param>
+	/// <param name="retrievable">Ask the driver to keep the linked binary for glGetProgramBinary</param>
 	/// <returns></returns>
-	unsigned int createShaderProgram(const char* vertexShaderSource, const char* fragmentShaderSource) {
+	unsigned int createShaderProgram(const char* vertexShaderSource, const char* fragmentShaderSource, bool retrievable) {
 		unsigned int vertexShader = createShader(GL_VERTEX_SHADER, vertexShaderSource);
 		unsigned int fragmentShader = createShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
 
@@ -58,6 +124,9 @@ namespace ew {
 		//Attach each stage
 		glAttachShader(shaderProgram, vertexShader);
 		glAttachShader(shaderProgram, fragmentShader);
+		if (retrievable) {
+			glProgramParameteri(shaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		}
 		//Link all the stages together
 		glLinkProgram(shaderProgram);
 		int success;
@@ -73,7 +142,9 @@ namespace ew {
 		return shaderProgram;
 	}
 	/// <summary>
-	/// Creates a shader instance with vertex + fragment stages
+	/// Creates a shader instance with vertex + fragment stages.
+	/// The linked program is cached as a driver binary next to the vertex shader (see programCache.h),
+	/// so later launches skip compiling unless a source file or the driver changed.
 	/// </summary>
 	/// <param name="vertexShader">File path to vertex shader</param>
 	/// <param name="fragmentShader">File path to fragment shader</param>
@@ -81,7 +152,120 @@ namespace ew {
 	{
 		std::string vertexShaderSource = ew::loadShaderSourceFromFile(vertexShader.c_str());
 		std::string fragmentShaderSource = ew::loadShaderSourceFromFile(fragmentShader.c_str());
-		m_id = ew::createShaderProgram(vertexShaderSource.c_str(), fragmentShaderSource.c_str());
+		std::string cachePath = ew::getProgramCachePath(vertexShader, fragmentShader);
+		uint64_t key = ew::getProgramCacheKey(vertexShaderSource, fragmentShaderSource);
+		m_id = ew::loadProgramBinary(cachePath, key);
+		if (m_id == 0) {
+			m_id = ew::createShaderProgram(vertexShaderSource.c_str(), fragmentShaderSource.c_str(), true);
+			ew::saveProgramBinary(cachePath, key, m_id);
+		}
+		cacheUniforms();
+	}
+	/// <summary>
+	/// Wraps a program that has already been linked, such as one from a ShaderBatch
+	/// </summary>
+	Shader::Shader(unsigned int program)
+		:m_id(program)
+	{
+		cacheUniforms();
+	}
+	/// <summary>
+	/// FNV-1a hash of a uniform name
+	/// </summary>
+	static uint32_t hashUniformName(const char* name) {
+		uint32_t hash = 2166136261u;
+		for (const char* c = name; *c != '\0'; c++)
+		{
+			hash ^= (unsigned char)*c;
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+	/// <summary>
+	/// Enumerates every active uniform once after linking, so setters never have to ask the driver.
+	/// Array elements are stored individually, plus the bare array name for element 0.
+	/// </summary>
+	void Shader::cacheUniforms()
+	{
+		int numUniforms = 0;
+		int maxNameLength = 0;
+		glGetProgramiv(m_id, GL_ACTIVE_UNIFORMS, &numUniforms);
+		glGetProgramiv(m_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+		//Collect first, then size the table for a load factor of at most 1/2
+		std::vector<std::pair<std::string, int>> uniforms;
+		std::vector<char> nameBuffer(maxNameLength + 1);
+		for (int i = 0; i < numUniforms; i++)
+		{
+			int arraySize = 0;
+			GLenum type;
+			GLsizei nameLength = 0;
+			glGetActiveUniform(m_id, i, (GLsizei)nameBuffer.size(), &nameLength, &arraySize, &type, nameBuffer.data());
+			std::string name(nameBuffer.data(), nameLength);
+			int location = glGetUniformLocation(m_id, name.c_str());
+			//Uniforms inside blocks have no location
+			if (location < 0)
+				continue;
+			uniforms.push_back({ name, location });
+
+			//"values[0]" also answers to "values" and "values[i]"
+			size_t bracket = name.size() >= 3 ? name.size() - 3 : std::string::npos;
+			if (bracket != std::string::npos && name.compare(bracket, 3, "[0]") == 0) {
+				std::string baseName = name.substr(0, bracket);
+				uniforms.push_back({ baseName, location });
+				for (int element = 1; element < arraySize; element++)
+				{
+					std::string elementName = baseName + "[" + std::to_string(element) + "]";
+					uniforms.push_back({ elementName, glGetUniformLocation(m_id, elementName.c_str()) });
+				}
+			}
+		}
+
+		size_t tableSize = 16;
+		while (tableSize < uniforms.size() * 2) {
+			tableSize *= 2;
+		}
+		m_uniformSlots.assign(tableSize, UniformSlot());
+		for (const auto& uniform : uniforms)
+		{
+			addUniform(uniform.first, uniform.second);
+		}
+	}
+	void Shader::addUniform(const std::string& name, int location)
+	{
+		uint32_t hash = hashUniformName(name.c_str());
+		size_t mask = m_uniformSlots.size() - 1;
+		for (size_t i = hash & mask;; i = (i + 1) & mask)
+		{
+			UniformSlot& slot = m_uniformSlots[i];
+			if (slot.name.empty()) {
+				slot.hash = hash;
+				slot.location = location;
+				slot.name = name;
+				return;
+			}
+			if (slot.hash == hash && slot.name == name)
+				return;
+		}
+	}
+	/// <summary>
+	/// Looks up a uniform location in the table built at link time
+	/// </summary>
+	/// <returns>-1 if the uniform is not active, which glUniform* ignores</returns>
+	int Shader::getUniformLocation(const std::string& name) const
+	{
+		if (m_uniformSlots.empty())
+			return -1;
+		uint32_t hash = hashUniformName(name.c_str());
+		size_t mask = m_uniformSlots.size() - 1;
+		for (size_t i = hash & mask;; i = (i + 1) & mask)
+		{
+			const UniformSlot& slot = m_uniformSlots[i];
+			if (slot.name.empty())
+				return -1;
+			if (slot.hash == hash && slot.name == name)
+				return slot.location;
+		}
 	}
 	void Shader::use()const
 	{
@@ -89,15 +273,15 @@ namespace ew {
 	}
 	void Shader::setInt(const std::string& name, int v) const
 	{
-		glUniform1i(glGetUniformLocation(m_id, name.c_str()), v);
+		glUniform1i(getUniformLocation(name), v);
 	}
 	void Shader::setFloat(const std::string& name, float v) const
 	{
-		glUniform1f(glGetUniformLocation(m_id, name.c_str()), v);
+		glUniform1f(getUniformLocation(name), v);
 	}
 	void Shader::setVec2(const std::string& name, float x, float y) const
 	{
-		glUniform2f(glGetUniformLocation(m_id, name.c_str()), x, y);
+		glUniform2f(getUniformLocation(name), x, y);
 	}
 	void Shader::setVec2(const std::string& name, const ew::Vec2& v) const
 	{
@@ -105,7 +289,7 @@ namespace ew {
 	}
 	void Shader::setVec3(const std::string& name, float x, float y, float z) const
 	{
-		glUniform3f(glGetUniformLocation(m_id, name.c_str()), x, y, z);
+		glUniform3f(getUniformLocation(name), x, y, z);
 	}
 	void Shader::setVec3(const std::string& name, const ew::Vec3& v) const
 	{
@@ -113,7 +297,7 @@ namespace ew {
 	}
 	void Shader::setVec4(const std::string& name, float x, float y, float z, float w) const
 	{
-		glUniform4f(glGetUniformLocation(m_id, name.c_str()), x, y, z, w);
+		glUniform4f(getUniformLocation(name), x, y, z, w);
 	}
 	void Shader::setVec4(const std::string& name, const ew::Vec4& v) const
 	{
@@ -121,7 +305,30 @@ namespace ew {
 	}
 	void Shader::setMat4(const std::string& name, const ew::Mat4& m) const
 	{
-		glUniformMatrix4fv(glGetUniformLocation(m_id, name.c_str()), 1, GL_FALSE, &m[0][0]);
+		glUniformMatrix4fv(getUniformLocation(name), 1, GL_FALSE, &m[0][0]);
+	}
+	void Shader::set(UniformHandle<int> handle, int v) const
+	{
+		glUniform1i(handle.location, v);
+	}
+	void Shader::set(UniformHandle<float> handle, float v) const
+	{
+		glUniform1f(handle.location, v);
+	}
+	void Shader::set(UniformHandle<ew::Vec2> handle, const ew::Vec2& v) const
+	{
+		glUniform2f(handle.location, v.x, v.y);
+	}
+	void Shader::set(UniformHandle<ew::Vec3> handle, const ew::Vec3& v) const
+	{
+		glUniform3f(handle.location, v.x, v.y, v.z);
+	}
+	void Shader::set(UniformHandle<ew::Vec4> handle, const ew::Vec4& v) const
+	{
+		glUniform4f(handle.location, v.x, v.y, v.z, v.w);
+	}
+	void Shader::set(UniformHandle<ew::Mat4> handle, const ew::Mat4& m) const
+	{
+		glUniformMatrix4fv(handle.location, 1, GL_FALSE, &m[0][0]);
 	}
 }
-
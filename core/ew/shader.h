@@ -1,14 +1,39 @@
 #pragma once
 #include <string>
+#include <vector>
+#include <stdint.h>
 #include "ewMath/ewMath.h"
 
 namespace ew {
 	std::string loadShaderSourceFromFile(const std::string& filePath);
-	unsigned int createShaderProgram(const char* vertexShaderSource, const char* fragmentShaderSource);
+	unsigned int createShaderProgram(const char* vertexShaderSource, const char* fragmentShaderSource, bool retrievable = false);
+
+	//Uniform location resolved once, typed by the value it expects. Pass to Shader::set in the render loop.
+	template<typename T>
+	struct UniformHandle {
+		int location = -1;
+		inline bool isValid()const { return location >= 0; }
+	};
+
 	class Shader {
 	public:
 		Shader(const std::string& vertexShader, const std::string& fragmentShader);
+		explicit Shader(unsigned int program);
 		void use()const;
+		inline unsigned int getId()const { return m_id; }
+		int getUniformLocation(const std::string& name) const;
+		template<typename T>
+		inline UniformHandle<T> getUniformHandle(const std::string& name) const {
+			UniformHandle<T> handle;
+			handle.location = getUniformLocation(name);
+			return handle;
+		}
+		void set(UniformHandle<int> handle, int v) const;
+		void set(UniformHandle<float> handle, float v) const;
+		void set(UniformHandle<ew::Vec2> handle, const ew::Vec2& v) const;
+		void set(UniformHandle<ew::Vec3> handle, const ew::Vec3& v) const;
+		void set(UniformHandle<ew::Vec4> handle, const ew::Vec4& v) const;
+		void set(UniformHandle<ew::Mat4> handle, const ew::Mat4& m) const;
 		void setInt(const std::string& name, int v) const;
 		void setFloat(const std::string& name, float v) const;
 		void setVec2(const std::string& name, float x, float y) const;
@@ -19,6 +44,15 @@ namespace ew {
 		void setVec4(const std::string& name, const ew::Vec4& v) const;
 		void setMat4(const std::string& name, const ew::Mat4& m) const;
 	private:
+		void cacheUniforms();
+		void addUniform(const std::string& name, int location);
+
+		struct UniformSlot {
+			uint32_t hash = 0;
+			int location = -1;
+			std::string name; //Empty for unused slots
+		};
 		unsigned int m_id; //Shader program handle
+		std::vector<UniformSlot> m_uniformSlots; //Open addressing hash table of active uniforms, power of two size
 	};
 }
\ No newline at end of file
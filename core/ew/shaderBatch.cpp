@@ -0,0 +1,207 @@
+#include "shaderBatch.h"
+#include "programCache.h"
+#include "external/glad.h"
+#include <GLFW/glfw3.h>
+#include <stdio.h>
+#include <string.h>
+
+//GL_KHR_parallel_shader_compile and GL_ARB_parallel_shader_compile, which the generated loader does not include.
+//Both extensions use the same values.
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+namespace ew {
+	typedef void (GLAD_API_PTR *PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+	static bool hasExtension(const char* name) {
+		int numExtensions = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+		for (int i = 0; i < numExtensions; i++)
+		{
+			const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+			if (extension != nullptr && strcmp(extension, name) == 0)
+				return true;
+		}
+		return false;
+	}
+
+	/// <summary>
+	/// Checks for parallel compile support and lets the driver pick how many threads to use. Needs a current GL context.
+	/// </summary>
+	ShaderBatch::ShaderBatch()
+	{
+		const char* functionName = nullptr;
+		if (hasExtension("GL_KHR_parallel_shader_compile")) {
+			functionName = "glMaxShaderCompilerThreadsKHR";
+		}
+		else if (hasExtension("GL_ARB_parallel_shader_compile")) {
+			functionName = "glMaxShaderCompilerThreadsARB";
+		}
+		if (functionName == nullptr)
+			return;
+		m_isParallel = true;
+		PFNGLMAXSHADERCOMPILERTHREADSKHRPROC maxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress(functionName);
+		if (maxShaderCompilerThreads != nullptr) {
+			//0xFFFFFFFF means as many as the implementation likes
+			maxShaderCompilerThreads(0xFFFFFFFF);
+		}
+	}
+
+	static unsigned int submitShader(GLenum shaderType, const char* sourceCode) {
+		unsigned int shader = glCreateShader(shaderType);
+		glShaderSource(shader, 1, &sourceCode, NULL);
+		glCompileShader(shader);
+		return shader;
+	}
+
+	/// <summary>
+	/// Loads the program from the binary cache, or reads its sources and starts compiling them
+	/// </summary>
+	/// <param name="vertexShader">File path to vertex shader</param>
+	/// <param name="fragmentShader">File path to fragment shader</param>
+	/// <returns>Index to pass to getShader</returns>
+	int ShaderBatch::add(const std::string& vertexShader, const std::string& fragmentShader)
+	{
+		PendingProgram pending;
+		pending.name = vertexShader + " + " + fragmentShader;
+		std::string vertexShaderSource = loadShaderSourceFromFile(vertexShader);
+		std::string fragmentShaderSource = loadShaderSourceFromFile(fragmentShader);
+		pending.cachePath = getProgramCachePath(vertexShader, fragmentShader);
+		pending.cacheKey = getProgramCacheKey(vertexShaderSource, fragmentShaderSource);
+		pending.program = loadProgramBinary(pending.cachePath, pending.cacheKey);
+		if (pending.program != 0) {
+			pending.state = State::READY;
+			m_numReady++;
+		}
+		else {
+			pending.vertexShader = submitShader(GL_VERTEX_SHADER, vertexShaderSource.c_str());
+			pending.fragmentShader = submitShader(GL_FRAGMENT_SHADER, fragmentShaderSource.c_str());
+		}
+		m_programs.push_back(pending);
+		return (int)m_programs.size() - 1;
+	}
+
+	/// <summary>
+	/// Whether a shader has compiled or a program has linked, without waiting. Always true without parallel compile,
+	/// where the status queries that follow are what waits.
+	/// </summary>
+	bool ShaderBatch::isComplete(unsigned int object, bool isProgram)const
+	{
+		if (!m_isParallel)
+			return true;
+		int complete = 0;
+		if (isProgram) {
+			glGetProgramiv(object, GL_COMPLETION_STATUS_KHR, &complete);
+		}
+		else {
+			glGetShaderiv(object, GL_COMPLETION_STATUS_KHR, &complete);
+		}
+		return complete != 0;
+	}
+
+	void ShaderBatch::link(PendingProgram& pending)
+	{
+		pending.program = glCreateProgram();
+		glAttachShader(pending.program, pending.vertexShader);
+		glAttachShader(pending.program, pending.fragmentShader);
+		glProgramParameteri(pending.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		glLinkProgram(pending.program);
+		pending.state = State::LINKING;
+	}
+
+	/// <summary>
+	/// Reports compile and link errors, frees the shader objects and caches the binary
+	/// </summary>
+	void ShaderBatch::finishProgram(PendingProgram& pending)
+	{
+		//512 is an arbitrary length, but should be plenty of characters for our error message.
+		char infoLog[512];
+		int success;
+		unsigned int shaders[2] = { pending.vertexShader, pending.fragmentShader };
+		for (unsigned int shader : shaders)
+		{
+			glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+			if (!success) {
+				glGetShaderInfoLog(shader, 512, NULL, infoLog);
+				printf("Failed to compile shader (%s): %s", pending.name.c_str(), infoLog);
+			}
+		}
+		glGetProgramiv(pending.program, GL_LINK_STATUS, &success);
+		if (!success) {
+			glGetProgramInfoLog(pending.program, 512, NULL, infoLog);
+			printf("Failed to link shader program (%s): %s", pending.name.c_str(), infoLog);
+		}
+		else {
+			saveProgramBinary(pending.cachePath, pending.cacheKey, pending.program);
+		}
+		glDeleteShader(pending.vertexShader);
+		glDeleteShader(pending.fragmentShader);
+		pending.vertexShader = pending.fragmentShader = 0;
+		pending.state = State::READY;
+		m_numReady++;
+	}
+
+	/// <summary>
+	/// Moves a program as far towards READY as it can go. With wait, it always gets there.
+	/// </summary>
+	void ShaderBatch::advance(PendingProgram& pending, bool wait)
+	{
+		if (pending.state == State::COMPILING) {
+			if (!wait && !(isComplete(pending.vertexShader, false) && isComplete(pending.fragmentShader, false)))
+				return;
+			link(pending);
+		}
+		if (pending.state == State::LINKING) {
+			if (!wait && !isComplete(pending.program, true))
+				return;
+			finishProgram(pending);
+		}
+	}
+
+	/// <summary>
+	/// Advances every program that can progress without waiting. Without parallel compile, finishes the next program instead.
+	/// </summary>
+	/// <returns>True once every program is ready</returns>
+	bool ShaderBatch::poll()
+	{
+		for (PendingProgram& pending : m_programs)
+		{
+			if (pending.state == State::READY)
+				continue;
+			advance(pending, false);
+			if (!m_isParallel)
+				break;
+		}
+		return m_numReady == (int)m_programs.size();
+	}
+
+	/// <summary>
+	/// Waits for every program
+	/// </summary>
+	void ShaderBatch::finish()
+	{
+		//Link everything before waiting on any link, so the driver can work on them together
+		for (PendingProgram& pending : m_programs)
+		{
+			if (pending.state == State::COMPILING) {
+				link(pending);
+			}
+		}
+		for (PendingProgram& pending : m_programs)
+		{
+			advance(pending, true);
+		}
+	}
+
+	/// <summary>
+	/// Shader for a program added to the batch, waiting for it if needed
+	/// </summary>
+	Shader ShaderBatch::getShader(int index)
+	{
+		PendingProgram& pending = m_programs[index];
+		advance(pending, true);
+		return Shader(pending.program);
+	}
+}
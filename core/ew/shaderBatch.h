@@ -0,0 +1,51 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "shader.h"
+
+namespace ew {
+	/// <summary>
+	/// Builds many programs at once. add() submits a program's compiles and returns immediately;
+	/// poll() advances them without blocking, so the app can draw loading frames or generate meshes while the driver works.
+	/// With GL_KHR_parallel_shader_compile (or the ARB version) the driver compiles on its own threads and poll() only
+	/// reads GL_COMPLETION_STATUS_KHR. Without it, poll() finishes one program per call.
+	/// Programs found in the binary cache (see programCache.h) are ready as soon as they are added.
+	/// </summary>
+	class ShaderBatch {
+	public:
+		ShaderBatch();
+		ShaderBatch(const ShaderBatch&) = delete;
+		ShaderBatch& operator=(const ShaderBatch&) = delete;
+		int add(const std::string& vertexShader, const std::string& fragmentShader);
+		bool poll();
+		void finish();
+		Shader getShader(int index);
+		inline int getNumPrograms()const { return (int)m_programs.size(); }
+		inline int getNumReady()const { return m_numReady; }
+		inline bool isParallel()const { return m_isParallel; }
+	private:
+		enum class State {
+			COMPILING,
+			LINKING,
+			READY
+		};
+		struct PendingProgram {
+			State state = State::COMPILING;
+			std::string name; //Vertex and fragment paths, for error messages
+			std::string cachePath;
+			uint64_t cacheKey = 0;
+			unsigned int vertexShader = 0;
+			unsigned int fragmentShader = 0;
+			unsigned int program = 0;
+		};
+		bool isComplete(unsigned int object, bool isProgram)const;
+		void link(PendingProgram& pending);
+		void finishProgram(PendingProgram& pending);
+		void advance(PendingProgram& pending, bool wait);
+
+		std::vector<PendingProgram> m_programs;
+		int m_numReady = 0;
+		bool m_isParallel = false;
+	};
+}
@@ -1,31 +1,25 @@
 #include "texture.h"
 #include "external/glad.h"
-#include "external/stb_image.h"
+#include "textureCache.h"
 
-static int getTextureFormat(int numComponents) {
-	switch (numComponents) {
-	default:
-		return GL_RGBA;
-	case 3:
-		return GL_RGB;
-	case 2:
-		return GL_RG;
-	}
-}
 namespace ew {
-	unsigned int loadTexture(const char* filePath, int wrapMode, int filterMode) {
-		int width, height, numComponents;
-		unsigned char* data = stbi_load(filePath, &width, &height, &numComponents, 0);
-		if (data == NULL) {
-			printf("Failed to load image %s", filePath);
-			stbi_image_free(data);
-			return 0;
+	/// <summary>
+	/// GL pixel format for an image with numComponents channels
+	/// </summary>
+	int getTextureFormat(int numComponents) {
+		switch (numComponents) {
+		default:
+			return GL_RGBA;
+		case 3:
+			return GL_RGB;
+		case 2:
+			return GL_RG;
 		}
-		unsigned int texture;
-		glGenTextures(1, &texture);
-		glBindTexture(GL_TEXTURE_2D, texture);
-		int format = getTextureFormat(numComponents);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+	}
+	/// <summary>
+	/// Applies wrap and filter settings to the texture bound to GL_TEXTURE_2D. Minification always uses mipmaps.
+	/// </summary>
+	void setTextureParameters(int wrapMode, int filterMode) {
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapMode);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapMode);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
@@ -33,12 +27,22 @@ namespace ew {
 
 		float borderColor[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
 		glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-
-		glGenerateMipmap(GL_TEXTURE_2D);
+	}
+	/// <summary>
+	/// Loads an image and its mip chain through the texture cache, so warm starts skip decoding
+	/// </summary>
+	unsigned int loadTexture(const char* filePath, int wrapMode, int filterMode) {
+		TextureData data;
+		if (!loadTextureData(filePath, data)) {
+			return 0;
+		}
+		unsigned int texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		uploadTextureData(data);
+		setTextureParameters(wrapMode, filterMode);
 
 		glBindTexture(GL_TEXTURE_2D, NULL);
-		stbi_image_free(data);
 		return texture;
 	}
 }
-
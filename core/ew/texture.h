@@ -1,5 +1,8 @@
+
 #pragma once
 
 namespace ew {
 	unsigned int loadTexture(const char* filePath, int wrapMode, int filterMode);
+	int getTextureFormat(int numComponents);
+	void setTextureParameters(int wrapMode, int filterMode);
 }
@@ -0,0 +1,188 @@
+#include "textureCache.h"
+#include "renderStats.h"
+#include "texture.h"
+#include "hash.h"
+#include "external/glad.h"
+#include "external/stb_image.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+namespace ew {
+	//Bump when the file layout or mip filter changes
+	static const uint32_t TEXTURE_CACHE_VERSION = 1;
+
+	/// <summary>
+	/// Reads a whole file into bytes
+	/// </summary>
+	bool readFileBytes(const char* filePath, std::vector<unsigned char>& bytes) {
+		FILE* file = fopen(filePath, "rb");
+		if (file == NULL)
+			return false;
+		fseek(file, 0, SEEK_END);
+		long size = ftell(file);
+		fseek(file, 0, SEEK_SET);
+		bytes.resize(size > 0 ? size : 0);
+		size_t numRead = fread(bytes.data(), 1, bytes.size(), file);
+		fclose(file);
+		return numRead == bytes.size();
+	}
+
+	/// <summary>
+	/// 2x2 box filter. Odd source sizes repeat the last row/column.
+	/// </summary>
+	void downsampleImage(const unsigned char* src, int srcWidth, int srcHeight, unsigned char* dst, int dstWidth, int dstHeight, int numComponents) {
+		for (int y = 0; y < dstHeight; y++)
+		{
+			int y0 = y * 2 < srcHeight ? y * 2 : srcHeight - 1;
+			int y1 = y * 2 + 1 < srcHeight ? y * 2 + 1 : srcHeight - 1;
+			for (int x = 0; x < dstWidth; x++)
+			{
+				int x0 = x * 2 < srcWidth ? x * 2 : srcWidth - 1;
+				int x1 = x * 2 + 1 < srcWidth ? x * 2 + 1 : srcWidth - 1;
+				for (int c = 0; c < numComponents; c++)
+				{
+					int sum = src[(y0 * srcWidth + x0) * numComponents + c]
+						+ src[(y0 * srcWidth + x1) * numComponents + c]
+						+ src[(y1 * srcWidth + x0) * numComponents + c]
+						+ src[(y1 * srcWidth + x1) * numComponents + c];
+					dst[(y * dstWidth + x) * numComponents + c] = (unsigned char)((sum + 2) / 4);
+				}
+			}
+		}
+	}
+
+	static bool isHeaderValid(const MappedFile& file, uint64_t sourceHash, uint64_t paramsHash) {
+		if (file.getSize() < sizeof(TextureCacheHeader))
+			return false;
+		const TextureCacheHeader* header = (const TextureCacheHeader*)file.getData();
+		if (memcmp(header->magic, "EWTX", 4) != 0 || header->version != TEXTURE_CACHE_VERSION)
+			return false;
+		if (header->sourceHash != sourceHash || header->paramsHash != paramsHash)
+			return false;
+		if (header->numLevels < 1 || header->numLevels > TEXTURE_CACHE_MAX_LEVELS)
+			return false;
+		for (int i = 0; i < header->numLevels; i++)
+		{
+			if (header->levelOffsets[i] + header->levelSizes[i] > file.getSize())
+				return false;
+		}
+		return true;
+	}
+
+	size_t TextureData::getTotalSize() const
+	{
+		int last = m_header->numLevels - 1;
+		return (size_t)(m_header->levelOffsets[last] + m_header->levelSizes[last] - m_header->levelOffsets[0]);
+	}
+
+	/// <summary>
+	/// Loads an image with a full mip chain. On a warm start the decoded cache file (filePath + ".ewtex") is memory mapped.
+	/// Otherwise the image is decoded, mipmapped on the CPU and written to the cache for next time.
+	/// The cache is keyed by a hash of the source file contents and the load parameters.
+	/// </summary>
+	/// <param name="filePath">Encoded image (jpg, png, ...)</param>
+	/// <param name="textureData">Filled on success</param>
+	/// <param name="desiredComponents">Channel count to convert to, or 0 to keep the source count</param>
+	/// <returns>False if the image can't be read or decoded</returns>
+	bool loadTextureData(const char* filePath, TextureData& textureData, int desiredComponents)
+	{
+		std::vector<unsigned char> source;
+		if (!readFileBytes(filePath, source)) {
+			printf("Failed to load image %s", filePath);
+			return false;
+		}
+		uint64_t sourceHash = hashBytes(source.data(), source.size());
+		int32_t params[2] = { desiredComponents, (int32_t)TEXTURE_CACHE_VERSION };
+		uint64_t paramsHash = hashBytes(params, sizeof(params));
+		std::string cachePath = std::string(filePath) + ".ewtex";
+
+		//Warm start
+		if (textureData.m_file.open(cachePath.c_str())) {
+			if (isHeaderValid(textureData.m_file, sourceHash, paramsHash)) {
+				textureData.m_memory.clear();
+				textureData.m_bytes = textureData.m_file.getData();
+				textureData.m_header = (const TextureCacheHeader*)textureData.m_bytes;
+				return true;
+			}
+			textureData.m_file.close();
+		}
+
+		//Cold start
+		int width, height, numComponents;
+		unsigned char* pixels = stbi_load_from_memory(source.data(), (int)source.size(), &width, &height, &numComponents, desiredComponents);
+		if (pixels == NULL) {
+			printf("Failed to load image %s", filePath);
+			return false;
+		}
+		if (desiredComponents != 0) {
+			numComponents = desiredComponents;
+		}
+
+		TextureCacheHeader header = {};
+		memcpy(header.magic, "EWTX", 4);
+		header.version = TEXTURE_CACHE_VERSION;
+		header.sourceHash = sourceHash;
+		header.paramsHash = paramsHash;
+		header.width = width;
+		header.height = height;
+		header.numComponents = numComponents;
+		header.numLevels = 1;
+		while (header.numLevels < TEXTURE_CACHE_MAX_LEVELS && ((width >> header.numLevels) > 0 || (height >> header.numLevels) > 0)) {
+			header.numLevels++;
+		}
+		uint64_t offset = (sizeof(TextureCacheHeader) + 15) & ~15ull;
+		for (int i = 0; i < header.numLevels; i++)
+		{
+			int levelWidth = width >> i > 0 ? width >> i : 1;
+			int levelHeight = height >> i > 0 ? height >> i : 1;
+			header.levelOffsets[i] = offset;
+			header.levelSizes[i] = (uint64_t)levelWidth * levelHeight * numComponents;
+			offset = (offset + header.levelSizes[i] + 15) & ~15ull;
+		}
+
+		std::vector<unsigned char>& memory = textureData.m_memory;
+		memory.assign((size_t)offset, 0);
+		memcpy(memory.data(), &header, sizeof(header));
+		memcpy(memory.data() + header.levelOffsets[0], pixels, (size_t)header.levelSizes[0]);
+		stbi_image_free(pixels);
+		for (int i = 1; i < header.numLevels; i++)
+		{
+			downsampleImage(memory.data() + header.levelOffsets[i - 1], width >> (i - 1) > 0 ? width >> (i - 1) : 1, height >> (i - 1) > 0 ? height >> (i - 1) : 1,
+				memory.data() + header.levelOffsets[i], width >> i > 0 ? width >> i : 1, height >> i > 0 ? height >> i : 1, numComponents);
+		}
+		textureData.m_bytes = memory.data();
+		textureData.m_header = (const TextureCacheHeader*)memory.data();
+
+		//Write to a temporary file first so a partial write is never mistaken for a valid cache
+		std::string tempPath = cachePath + ".tmp";
+		FILE* file = fopen(tempPath.c_str(), "wb");
+		if (file != NULL) {
+			bool written = fwrite(memory.data(), 1, memory.size(), file) == memory.size();
+			fclose(file);
+			remove(cachePath.c_str());
+			if (!written || rename(tempPath.c_str(), cachePath.c_str()) != 0) {
+				remove(tempPath.c_str());
+				printf("Failed to write texture cache %s", cachePath.c_str());
+			}
+		}
+		return true;
+	}
+
+	/// <summary>
+	/// Uploads every mip level to the texture bound to GL_TEXTURE_2D
+	/// </summary>
+	void uploadTextureData(const TextureData& textureData)
+	{
+		int format = getTextureFormat(textureData.getNumComponents());
+		//Rows are tightly packed
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (int i = 0; i < textureData.getNumLevels(); i++)
+		{
+			glTexImage2D(GL_TEXTURE_2D, i, format, textureData.getLevelWidth(i), textureData.getLevelHeight(i), 0, format, GL_UNSIGNED_BYTE, textureData.getLevelData(i));
+		}
+		countUpload(textureData.getTotalSize());
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, textureData.getNumLevels() - 1);
+	}
+}
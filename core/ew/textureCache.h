@@ -0,0 +1,51 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include "mappedFile.h"
+
+namespace ew {
+	constexpr int TEXTURE_CACHE_MAX_LEVELS = 16;
+
+	//Layout of a .ewtex file: this header followed by each mip level, tightly packed rows, 16 byte aligned levels
+	struct TextureCacheHeader {
+		char magic[4]; //"EWTX"
+		uint32_t version;
+		uint64_t sourceHash; //Hash of the encoded source file
+		uint64_t paramsHash; //Hash of the load parameters
+		int32_t width;
+		int32_t height;
+		int32_t numComponents;
+		int32_t numLevels;
+		uint64_t levelOffsets[TEXTURE_CACHE_MAX_LEVELS]; //From the start of the file
+		uint64_t levelSizes[TEXTURE_CACHE_MAX_LEVELS];
+	};
+
+	/// <summary>
+	/// Decoded pixels with a complete mip chain. Backed by either a mapped cache file or heap memory.
+	/// </summary>
+	class TextureData {
+	public:
+		inline bool isValid()const { return m_header != nullptr; }
+		inline int getWidth()const { return m_header->width; }
+		inline int getHeight()const { return m_header->height; }
+		inline int getNumComponents()const { return m_header->numComponents; }
+		inline int getNumLevels()const { return m_header->numLevels; }
+		inline int getLevelWidth(int level)const { int w = m_header->width >> level; return w > 0 ? w : 1; }
+		inline int getLevelHeight(int level)const { int h = m_header->height >> level; return h > 0 ? h : 1; }
+		inline const unsigned char* getLevelData(int level)const { return m_bytes + m_header->levelOffsets[level]; }
+		inline size_t getLevelSize(int level)const { return (size_t)m_header->levelSizes[level]; }
+		size_t getTotalSize()const;
+		inline bool isMapped()const { return m_file.isOpen(); }
+	private:
+		friend bool loadTextureData(const char* filePath, TextureData& textureData, int desiredComponents);
+		MappedFile m_file;
+		std::vector<unsigned char> m_memory;
+		const unsigned char* m_bytes = nullptr;
+		const TextureCacheHeader* m_header = nullptr;
+	};
+
+	bool loadTextureData(const char* filePath, TextureData& textureData, int desiredComponents = 0);
+	void uploadTextureData(const TextureData& textureData);
+	bool readFileBytes(const char* filePath, std::vector<unsigned char>& bytes);
+	void downsampleImage(const unsigned char* src, int srcWidth, int srcHeight, unsigned char* dst, int dstWidth, int dstHeight, int numComponents);
+}
@@ -0,0 +1,186 @@
+#include "textureStreamer.h"
+#include "renderStats.h"
+#include "texture.h"
+#include "external/glad.h"
+#include <string.h>
+#include <stdio.h>
+
+namespace ew {
+	/// <summary>
+	/// Starts the decode threads and creates the pixel buffer ring
+	/// </summary>
+	/// <param name="numWorkers">Number of decode threads</param>
+	/// <param name="numPixelBuffers">Number of uploads that can be in flight on the GPU at once</param>
+	TextureStreamer::TextureStreamer(int numWorkers, int numPixelBuffers)
+	{
+		m_pixelBuffers.resize(numPixelBuffers < 1 ? 1 : numPixelBuffers);
+		for (PixelBuffer& pixelBuffer : m_pixelBuffers)
+		{
+			glGenBuffers(1, &pixelBuffer.id);
+		}
+		for (int i = 0; i < numWorkers; i++)
+		{
+			m_workers.emplace_back(&TextureStreamer::workerLoop, this);
+		}
+	}
+	TextureStreamer::~TextureStreamer()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_shutdown = true;
+		}
+		m_requestAdded.notify_all();
+		for (std::thread& worker : m_workers)
+		{
+			worker.join();
+		}
+		for (PixelBuffer& pixelBuffer : m_pixelBuffers)
+		{
+			if (pixelBuffer.fence != nullptr) {
+				glDeleteSync((GLsync)pixelBuffer.fence);
+			}
+			glDeleteBuffers(1, &pixelBuffer.id);
+		}
+	}
+	/// <summary>
+	/// Creates a texture filled with placeholderColor and queues the image for decoding.
+	/// </summary>
+	/// <returns>Texture handle, valid immediately</returns>
+	unsigned int TextureStreamer::load(const char* filePath, int wrapMode, int filterMode, const ew::Vec4& placeholderColor)
+	{
+		unsigned char placeholder[4] = {
+			(unsigned char)(ew::Clamp(placeholderColor.x, 0.0f, 1.0f) * 255.0f),
+			(unsigned char)(ew::Clamp(placeholderColor.y, 0.0f, 1.0f) * 255.0f),
+			(unsigned char)(ew::Clamp(placeholderColor.z, 0.0f, 1.0f) * 255.0f),
+			(unsigned char)(ew::Clamp(placeholderColor.w, 0.0f, 1.0f) * 255.0f)
+		};
+		unsigned int texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+		setTextureParameters(wrapMode, filterMode);
+		glGenerateMipmap(GL_TEXTURE_2D);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_requests.push_back({ texture, filePath });
+		}
+		m_requestAdded.notify_one();
+		return texture;
+	}
+	void TextureStreamer::workerLoop()
+	{
+		while (true) {
+			Request request;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_requestAdded.wait(lock, [this] { return m_shutdown || !m_requests.empty(); });
+				if (m_shutdown)
+					return;
+				request = m_requests.front();
+				m_requests.pop_front();
+				m_numDecoding++;
+			}
+			DecodedImage image;
+			image.texture = request.texture;
+			image.filePath = request.filePath;
+			loadTextureData(request.filePath.c_str(), image.data);
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_decoded.push_back(std::move(image));
+				m_numDecoding--;
+			}
+		}
+	}
+	/// <summary>
+	/// Returns the next pixel buffer in the ring if the GPU is done with it, otherwise NULL. Never blocks.
+	/// </summary>
+	TextureStreamer::PixelBuffer* TextureStreamer::acquirePixelBuffer()
+	{
+		PixelBuffer& pixelBuffer = m_pixelBuffers[m_nextPixelBuffer];
+		if (pixelBuffer.fence != nullptr) {
+			GLenum result = glClientWaitSync((GLsync)pixelBuffer.fence, 0, 0);
+			if (result == GL_TIMEOUT_EXPIRED)
+				return nullptr;
+			glDeleteSync((GLsync)pixelBuffer.fence);
+			pixelBuffer.fence = nullptr;
+		}
+		m_nextPixelBuffer = (m_nextPixelBuffer + 1) % m_pixelBuffers.size();
+		return &pixelBuffer;
+	}
+	/// <summary>
+	/// Uploads decoded images. Call once per frame from the thread that owns the GL context.
+	/// At least one image is uploaded per call if one is ready, even if it exceeds maxUploadBytes.
+	/// </summary>
+	/// <param name="maxUploadBytes">Soft limit on bytes copied this call</param>
+	/// <returns>Number of textures finished this call</returns>
+	int TextureStreamer::update(size_t maxUploadBytes)
+	{
+		int numFinished = 0;
+		size_t uploadedBytes = 0;
+		while (uploadedBytes < maxUploadBytes) {
+			DecodedImage* image;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (m_decoded.empty())
+					break;
+				//Only this thread pops, and push_back leaves references to the front intact
+				image = &m_decoded.front();
+			}
+			const TextureData& data = image->data;
+			if (data.isValid()) {
+				PixelBuffer* pixelBuffer = acquirePixelBuffer();
+				if (pixelBuffer == nullptr)
+					break;
+				//Mip levels are contiguous, so the whole chain goes through the buffer in one copy
+				size_t size = data.getTotalSize();
+				const unsigned char* base = data.getLevelData(0);
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer->id);
+				if (pixelBuffer->capacity < size) {
+					glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+					pixelBuffer->capacity = size;
+				}
+				void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+				if (mapped != NULL) {
+					memcpy(mapped, base, size);
+					countUpload(size);
+					glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+					//Source is the bound pixel buffer, so the last argument is an offset
+					int format = getTextureFormat(data.getNumComponents());
+					glBindTexture(GL_TEXTURE_2D, image->texture);
+					glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+					for (int i = 0; i < data.getNumLevels(); i++)
+					{
+						const void* offset = (const void*)(data.getLevelData(i) - base);
+						glTexImage2D(GL_TEXTURE_2D, i, format, data.getLevelWidth(i), data.getLevelHeight(i), 0, format, GL_UNSIGNED_BYTE, offset);
+					}
+					glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, data.getNumLevels() - 1);
+					glBindTexture(GL_TEXTURE_2D, 0);
+					pixelBuffer->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+				}
+				else {
+					printf("Failed to map pixel buffer for %s", image->filePath.c_str());
+				}
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+				uploadedBytes += size;
+			}
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_decoded.pop_front();
+			}
+			numFinished++;
+		}
+		return numFinished;
+	}
+	/// <summary>
+	/// Number of textures still waiting for decode or upload
+	/// </summary>
+	int TextureStreamer::getNumPending() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return (int)(m_requests.size() + m_decoded.size()) + m_numDecoding;
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "ewMath/ewMath.h"
+#include "textureCache.h"
+
+namespace ew {
+	/// <summary>
+	/// Loads textures without blocking the render thread.
+	/// load() returns a texture handle right away, backed by a 1x1 placeholder.
+	/// Worker threads load the image and its mip chain through the texture cache; update() copies finished images into a ring of pixel buffer objects
+	/// and respecifies the texture from there, so the driver copies asynchronously.
+	/// </summary>
+	class TextureStreamer {
+	public:
+		TextureStreamer(int numWorkers = 2, int numPixelBuffers = 3);
+		~TextureStreamer();
+		TextureStreamer(const TextureStreamer&) = delete;
+		TextureStreamer& operator=(const TextureStreamer&) = delete;
+		unsigned int load(const char* filePath, int wrapMode, int filterMode, const ew::Vec4& placeholderColor = ew::Vec4(0.0f, 0.0f, 0.0f, 1.0f));
+		int update(size_t maxUploadBytes = 64 * 1024 * 1024);
+		int getNumPending()const;
+	private:
+		struct Request {
+			unsigned int texture;
+			std::string filePath;
+		};
+		struct DecodedImage {
+			unsigned int texture;
+			TextureData data; //Invalid if decoding failed
+			std::string filePath;
+		};
+		struct PixelBuffer {
+			unsigned int id = 0;
+			size_t capacity = 0;
+			void* fence = nullptr; //GLsync, signaled once the texture upload reading this buffer is done
+		};
+		void workerLoop();
+		PixelBuffer* acquirePixelBuffer();
+
+		std::vector<std::thread> m_workers;
+		std::vector<PixelBuffer> m_pixelBuffers;
+		int m_nextPixelBuffer = 0;
+		mutable std::mutex m_mutex;
+		std::condition_variable m_requestAdded;
+		std::deque<Request> m_requests;
+		std::deque<DecodedImage> m_decoded;
+		int m_numDecoding = 0;
+		bool m_shutdown = false;
+	};
+}
@@ -0,0 +1,120 @@
+#include "transformSystem.h"
+
+namespace ew {
+	/// <summary>
+	/// Adds a transform and returns its id. Ids are indices into getModelMatrices().
+	/// </summary>
+	int TransformSystem::create(const Transform& transform)
+	{
+		int id = (int)m_models.size();
+		m_positionX.push_back(transform.position.x);
+		m_positionY.push_back(transform.position.y);
+		m_positionZ.push_back(transform.position.z);
+		m_rotationX.push_back(transform.rotation.x);
+		m_rotationY.push_back(transform.rotation.y);
+		m_rotationZ.push_back(transform.rotation.z);
+		m_scaleX.push_back(transform.scale.x);
+		m_scaleY.push_back(transform.scale.y);
+		m_scaleZ.push_back(transform.scale.z);
+		m_models.push_back(ew::IdentityMatrix());
+		m_isDirty.push_back(0);
+		markDirty(id);
+		return id;
+	}
+	void TransformSystem::set(int id, const Transform& transform)
+	{
+		setPosition(id, transform.position);
+		setRotation(id, transform.rotation);
+		setScale(id, transform.scale);
+	}
+	void TransformSystem::setPosition(int id, const ew::Vec3& position)
+	{
+		m_positionX[id] = position.x;
+		m_positionY[id] = position.y;
+		m_positionZ[id] = position.z;
+		markDirty(id);
+	}
+	void TransformSystem::setRotation(int id, const ew::Vec3& rotation)
+	{
+		m_rotationX[id] = rotation.x;
+		m_rotationY[id] = rotation.y;
+		m_rotationZ[id] = rotation.z;
+		markDirty(id);
+	}
+	void TransformSystem::setScale(int id, const ew::Vec3& scale)
+	{
+		m_scaleX[id] = scale.x;
+		m_scaleY[id] = scale.y;
+		m_scaleZ[id] = scale.z;
+		markDirty(id);
+	}
+	ew::Vec3 TransformSystem::getPosition(int id) const
+	{
+		return ew::Vec3(m_positionX[id], m_positionY[id], m_positionZ[id]);
+	}
+	ew::Vec3 TransformSystem::getRotation(int id) const
+	{
+		return ew::Vec3(m_rotationX[id], m_rotationY[id], m_rotationZ[id]);
+	}
+	ew::Vec3 TransformSystem::getScale(int id) const
+	{
+		return ew::Vec3(m_scaleX[id], m_scaleY[id], m_scaleZ[id]);
+	}
+	Transform TransformSystem::get(int id) const
+	{
+		Transform transform;
+		transform.position = getPosition(id);
+		transform.rotation = getRotation(id);
+		transform.scale = getScale(id);
+		return transform;
+	}
+	void TransformSystem::markDirty(int id)
+	{
+		if (!m_isDirty[id]) {
+			m_isDirty[id] = 1;
+			m_dirty.push_back(id);
+		}
+	}
+	/// <summary>
+	/// Rebuilds the model matrix of every dirty transform.
+	/// Rx * Ry * Rz is expanded by hand and the scale is folded into its columns, so no Mat4 products are needed.
+	/// </summary>
+	/// <returns>Number of matrices rewritten</returns>
+	int TransformSystem::update()
+	{
+		m_updatedBegin = 0;
+		m_updatedEnd = 0;
+		if (m_dirty.empty())
+			return 0;
+		m_updatedBegin = m_dirty[0];
+		m_updatedEnd = m_dirty[0] + 1;
+		for (int id : m_dirty)
+		{
+			float radX = ew::Radians(m_rotationX[id]);
+			float radY = ew::Radians(m_rotationY[id]);
+			float radZ = ew::Radians(m_rotationZ[id]);
+			float cx = cosf(radX), sx = sinf(radX);
+			float cy = cosf(radY), sy = sinf(radY);
+			float cz = cosf(radZ), sz = sinf(radZ);
+			float scaleX = m_scaleX[id];
+			float scaleY = m_scaleY[id];
+			float scaleZ = m_scaleZ[id];
+
+			//Row major arguments, like ew::Translate etc.
+			m_models[id] = ew::Mat4(
+				(cy * cz) * scaleX, (-cy * sz) * scaleY, sy * scaleZ, m_positionX[id],
+				(cx * sz + sx * sy * cz) * scaleX, (cx * cz - sx * sy * sz) * scaleY, (-sx * cy) * scaleZ, m_positionY[id],
+				(sx * sz - cx * sy * cz) * scaleX, (sx * cz + cx * sy * sz) * scaleY, (cx * cy) * scaleZ, m_positionZ[id],
+				0.0f, 0.0f, 0.0f, 1.0f
+			);
+			m_isDirty[id] = 0;
+			if (id < m_updatedBegin)
+				m_updatedBegin = id;
+			if (id + 1 > m_updatedEnd)
+				m_updatedEnd = id + 1;
+		}
+		int numUpdated = (int)m_dirty.size();
+		m_dirty.clear();
+		return numUpdated;
+	}
+}
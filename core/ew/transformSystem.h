@@ -0,0 +1,43 @@
+#pragma once
+#include <vector>
+#include "ewMath/ewMath.h"
+#include "transform.h"
+
+namespace ew {
+	/// <summary>
+	/// Stores many transforms as structure of arrays and keeps their model matrices in one contiguous array.
+	/// Setters only mark an entry dirty; update() rebuilds the matrices of dirty entries.
+	/// Matrices match ew::Transform: Translate * RotateX * RotateY * RotateZ * Scale, Euler angles in degrees.
+	/// </summary>
+	class TransformSystem {
+	public:
+		int create(const Transform& transform = Transform());
+		inline int size()const { return (int)m_models.size(); }
+		void set(int id, const Transform& transform);
+		void setPosition(int id, const ew::Vec3& position);
+		void setRotation(int id, const ew::Vec3& rotation);
+		void setScale(int id, const ew::Vec3& scale);
+		ew::Vec3 getPosition(int id)const;
+		ew::Vec3 getRotation(int id)const;
+		ew::Vec3 getScale(int id)const;
+		Transform get(int id)const;
+		int update();
+		inline const ew::Mat4& getModelMatrix(int id)const { return m_models[id]; }
+		//Contiguous model matrices, ready to upload
+		inline const ew::Mat4* getModelMatrices()const { return m_models.data(); }
+		//Range [begin, end) of matrices rewritten by the last update()
+		inline int getUpdatedBegin()const { return m_updatedBegin; }
+		inline int getUpdatedEnd()const { return m_updatedEnd; }
+	private:
+		void markDirty(int id);
+
+		std::vector<float> m_positionX, m_positionY, m_positionZ;
+		std::vector<float> m_rotationX, m_rotationY, m_rotationZ; //Degrees
+		std::vector<float> m_scaleX, m_scaleY, m_scaleZ;
+		std::vector<ew::Mat4> m_models;
+		std::vector<unsigned char> m_isDirty;
+		std::vector<int> m_dirty; //Ids waiting for update()
+		int m_updatedBegin = 0;
+		int m_updatedEnd = 0;
+	};
+}
@@ -0,0 +1,42 @@
+#include "uniformBuffer.h"
+#include "renderStats.h"
+#include "external/glad.h"
+#include <stdio.h>
+
+namespace ew {
+	/// <summary>
+	/// Allocates size bytes and attaches the buffer to binding
+	/// </summary>
+	/// <param name="binding">Uniform block binding point, e.g. UBO_BINDING_FRAME</param>
+	/// <param name="size">Size of the std140 block in bytes</param>
+	UniformBuffer::UniformBuffer(unsigned int binding, size_t size)
+		:m_binding(binding), m_size(size)
+	{
+		glGenBuffers(1, &m_id);
+		glBindBuffer(GL_UNIFORM_BUFFER, m_id);
+		glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		bind();
+	}
+	/// <summary>
+	/// Overwrites part of the buffer
+	/// </summary>
+	void UniformBuffer::update(const void* data, size_t size, size_t offset) const
+	{
+		if (offset + size > m_size) {
+			printf("Uniform buffer update of %zu bytes at %zu exceeds size %zu", size, offset, m_size);
+			return;
+		}
+		glBindBuffer(GL_UNIFORM_BUFFER, m_id);
+		glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+		countUpload(size);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+	/// <summary>
+	/// Attaches the buffer to its binding point
+	/// </summary>
+	void UniformBuffer::bind() const
+	{
+		glBindBufferBase(GL_UNIFORM_BUFFER, m_binding, m_id);
+	}
+}
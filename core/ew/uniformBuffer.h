@@ -0,0 +1,77 @@
+#pragma once
+#include <stddef.h>
+#include "ewMath/ewMath.h"
+
+namespace ew {
+	//Binding points shared by every program. Must match the binding qualifiers of the GLSL blocks.
+	constexpr unsigned int UBO_BINDING_FRAME = 0;
+	constexpr unsigned int UBO_BINDING_LIGHTS = 1;
+	constexpr int MAX_LIGHTS = 4;
+
+	//std140 layout of FrameData in UNIFORM_BUFFER_GLSL
+	struct FrameUniforms {
+		ew::Mat4 viewProjection;
+		ew::Vec3 viewPosition;
+		float pad0;
+	};
+
+	//std140 layout of Light in UNIFORM_BUFFER_GLSL
+	struct LightUniform {
+		ew::Vec3 position; //World space
+		float pad0;
+		ew::Vec3 color; //RGB
+		float pad1;
+	};
+
+	//std140 layout of LightData in UNIFORM_BUFFER_GLSL
+	struct LightUniforms {
+		LightUniform lights[MAX_LIGHTS];
+		int numLights;
+		int pad0[3];
+	};
+
+	//std140 puts a vec3 on a 16 byte boundary, and array elements and structs on 16 byte strides
+	static_assert(offsetof(FrameUniforms, viewPosition) == 64, "FrameUniforms must match the std140 FrameData block");
+	static_assert(sizeof(FrameUniforms) == 80, "FrameUniforms must match the std140 FrameData block");
+	static_assert(offsetof(LightUniform, color) == 16, "LightUniform must match the std140 Light struct");
+	static_assert(sizeof(LightUniform) == 32, "LightUniform must match the std140 Light struct");
+	static_assert(offsetof(LightUniforms, numLights) == 128, "LightUniforms must match the std140 LightData block");
+	static_assert(sizeof(LightUniforms) == 144, "LightUniforms must match the std140 LightData block");
+
+	//Shader side of the blocks above, #include "ew/uniformBuffer.glsl" in any stage that reads them
+	static_assert(UBO_BINDING_FRAME == 0 && UBO_BINDING_LIGHTS == 1 && MAX_LIGHTS == 4, "Update UNIFORM_BUFFER_GLSL to match");
+	constexpr char UNIFORM_BUFFER_GLSL[] = R"(//Shared by every program, see ew/uniformBuffer.h
+layout(std140, binding = 0) uniform FrameData {
+	mat4 _ViewProjection;
+	vec3 _ViewPosition;
+};
+
+struct Light {
+	vec3 position;
+	vec3 color;
+};
+#define MAX_LIGHTS 4
+layout(std140, binding = 1) uniform LightData {
+	Light _Lights[MAX_LIGHTS];
+	int numLights;
+};
+)";
+
+	/// <summary>
+	/// Uniform buffer object attached to a fixed binding point, so one upload is seen by every program
+	/// </summary>
+	class UniformBuffer {
+	public:
+		UniformBuffer(unsigned int binding, size_t size);
+		void update(const void* data, size_t size, size_t offset = 0) const;
+		template<typename T>
+		inline void update(const T& data) const { update(&data, sizeof(T)); }
+		void bind() const;
+		inline unsigned int getId()const { return m_id; }
+		inline unsigned int getBinding()const { return m_binding; }
+	private:
+		unsigned int m_id = 0;
+		unsigned int m_binding = 0;
+		size_t m_size = 0;
+	};
+}
@@ -0,0 +1,174 @@
+#include "vertexFormat.h"
+#include "parallel.h"
+#include <string.h>
+#include <math.h>
+
+namespace ew {
+	//Vertices per parallelFor chunk
+	static const int MIN_VERTICES_PER_THREAD = 4096;
+
+	/// <summary>
+	/// Bytes per vertex in the vertex buffer
+	/// </summary>
+	int getVertexSize(VertexFormat format) {
+		return format == VertexFormat::FLOAT ? (int)sizeof(Vertex) : (int)sizeof(PackedVertex);
+	}
+
+	/// <summary>
+	/// IEEE 754 binary16, round to nearest even. Out of range values become infinity.
+	/// </summary>
+	uint16_t floatToHalf(float v) {
+		uint32_t bits;
+		memcpy(&bits, &v, 4);
+		uint32_t sign = (bits >> 16) & 0x8000;
+		uint32_t exponent = (bits >> 23) & 0xFF;
+		uint32_t mantissa = bits & 0x7FFFFF;
+		//NaN and infinity
+		if (exponent == 0xFF)
+			return (uint16_t)(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+		int halfExponent = (int)exponent - 127 + 15;
+		if (halfExponent >= 31)
+			return (uint16_t)(sign | 0x7C00);
+		if (halfExponent <= 0) {
+			//Subnormal or zero
+			if (halfExponent < -10)
+				return (uint16_t)sign;
+			mantissa |= 0x800000;
+			int shift = 14 - halfExponent;
+			uint32_t half = mantissa >> shift;
+			uint32_t remainder = mantissa & ((1u << shift) - 1);
+			uint32_t halfway = 1u << (shift - 1);
+			if (remainder > halfway || (remainder == halfway && (half & 1)))
+				half++;
+			return (uint16_t)(sign | half);
+		}
+		uint32_t half = ((uint32_t)halfExponent << 10) | (mantissa >> 13);
+		uint32_t remainder = mantissa & 0x1FFF;
+		//Carry into the exponent is correct, including overflow to infinity
+		if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+			half++;
+		return (uint16_t)(sign | half);
+	}
+
+	float halfToFloat(uint16_t h) {
+		uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+		uint32_t exponent = (h >> 10) & 0x1F;
+		uint32_t mantissa = h & 0x3FF;
+		uint32_t bits;
+		if (exponent == 0) {
+			if (mantissa == 0) {
+				bits = sign;
+			}
+			else {
+				//Subnormal, normalize it
+				int shift = 0;
+				while ((mantissa & 0x400) == 0) {
+					mantissa <<= 1;
+					shift++;
+				}
+				bits = sign | ((uint32_t)(127 - 15 + 1 - shift) << 23) | ((mantissa & 0x3FF) << 13);
+			}
+		}
+		else if (exponent == 31) {
+			bits = sign | 0x7F800000 | (mantissa << 13);
+		}
+		else {
+			bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+		}
+		float v;
+		memcpy(&v, &bits, 4);
+		return v;
+	}
+
+	/// <summary>
+	/// Maps a unit vector onto the [-1,1] square: project onto the octahedron |x|+|y|+|z|=1, then fold the lower half over
+	/// </summary>
+	ew::Vec2 encodeOctahedral(const ew::Vec3& normal) {
+		float l1 = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+		if (l1 <= 0.0f)
+			return ew::Vec2(0.0f, 0.0f);
+		float x = normal.x / l1;
+		float y = normal.y / l1;
+		if (normal.z < 0.0f) {
+			float foldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+			float foldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+			x = foldedX;
+			y = foldedY;
+		}
+		return ew::Vec2(x, y);
+	}
+
+	/// <summary>
+	/// Inverse of encodeOctahedral. Matches decodeNormal() in VERTEX_FORMAT_GLSL.
+	/// </summary>
+	ew::Vec3 decodeOctahedral(const ew::Vec2& encoded) {
+		ew::Vec3 v(encoded.x, encoded.y, 1.0f - fabsf(encoded.x) - fabsf(encoded.y));
+		float t = v.z < 0.0f ? -v.z : 0.0f;
+		v.x += v.x >= 0.0f ? -t : t;
+		v.y += v.y >= 0.0f ? -t : t;
+		return ew::Normalize(v);
+	}
+
+	/// <summary>
+	/// Axis aligned bounds of the vertices and morph vertices together
+	/// </summary>
+	void getPositionBounds(const MeshDataView& meshData, ew::Vec3& boundsMin, ew::Vec3& boundsMax) {
+		boundsMin = ew::Vec3(INFINITY);
+		boundsMax = ew::Vec3(-INFINITY);
+		const Vertex* arrays[2] = { meshData.vertices, meshData.morphVertices };
+		size_t counts[2] = { meshData.numVertices, meshData.numMorphVertices };
+		for (int a = 0; a < 2; a++)
+		{
+			for (size_t i = 0; i < counts[a]; i++)
+			{
+				const ew::Vec3& p = arrays[a][i].pos;
+				boundsMin = ew::Vec3(fminf(boundsMin.x, p.x), fminf(boundsMin.y, p.y), fminf(boundsMin.z, p.z));
+				boundsMax = ew::Vec3(fmaxf(boundsMax.x, p.x), fmaxf(boundsMax.y, p.y), fmaxf(boundsMax.z, p.z));
+			}
+		}
+		if (boundsMin.x > boundsMax.x) {
+			boundsMin = boundsMax = ew::Vec3(0.0f);
+		}
+	}
+
+	static int16_t toSnorm16(float v) {
+		v = v < -1.0f ? -1.0f : (v > 1.0f ? 1.0f : v);
+		return (int16_t)lroundf(v * 32767.0f);
+	}
+
+	static uint16_t toUnorm16(float v) {
+		v = v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+		return (uint16_t)lroundf(v * 65535.0f);
+	}
+
+	/// <summary>
+	/// Quantizes vertices for a packed format. NORMALIZED positions are stored as (pos - positionOffset) / positionScale,
+	/// so the shader decodes them with pos * scale + offset. HALF ignores the scale and offset.
+	/// </summary>
+	void packVertices(const Vertex* vertices, size_t count, VertexFormat format, const ew::Vec3& positionScale, const ew::Vec3& positionOffset, PackedVertex* out) {
+		ew::Vec3 invScale(1.0f / positionScale.x, 1.0f / positionScale.y, 1.0f / positionScale.z);
+		parallelFor((int)count, [&](int begin, int end) {
+			for (int i = begin; i < end; i++)
+			{
+				const Vertex& v = vertices[i];
+				PackedVertex& p = out[i];
+				if (format == VertexFormat::HALF) {
+					p.pos[0] = floatToHalf(v.pos.x);
+					p.pos[1] = floatToHalf(v.pos.y);
+					p.pos[2] = floatToHalf(v.pos.z);
+				}
+				else {
+					p.pos[0] = (uint16_t)toSnorm16((v.pos.x - positionOffset.x) * invScale.x);
+					p.pos[1] = (uint16_t)toSnorm16((v.pos.y - positionOffset.y) * invScale.y);
+					p.pos[2] = (uint16_t)toSnorm16((v.pos.z - positionOffset.z) * invScale.z);
+				}
+				p.pos[3] = 0;
+				ew::Vec2 normal = encodeOctahedral(v.normal);
+				p.normal[0] = toSnorm16(normal.x);
+				p.normal[1] = toSnorm16(normal.y);
+				p.uv[0] = toUnorm16(v.uv.x);
+				p.uv[1] = toUnorm16(v.uv.y);
+			}
+		}, MIN_VERTICES_PER_THREAD);
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <stdint.h>
+#include "mesh.h"
+
+namespace ew {
+	//16 byte vertex used by VertexFormat::HALF and VertexFormat::NORMALIZED
+	struct PackedVertex {
+		uint16_t pos[4]; //Half floats, or snorm16 relative to the mesh bounds. [3] is padding.
+		int16_t normal[2]; //Octahedral encoded, snorm16
+		uint16_t uv[2]; //unorm16, clamped to [0,1]
+	};
+	static_assert(sizeof(PackedVertex) == 16, "PackedVertex must stay 16 bytes");
+
+	//Shader side of the packed formats: #include "ew/vertexFormat.glsl" in a vertex shader and pass attributes through
+	//decodePosition and decodeNormal. Mesh users set the uniforms from getPositionScale, getPositionOffset and getVertexFormat.
+	constexpr char VERTEX_FORMAT_GLSL[] = R"(//Packed vertex decode, see ew/vertexFormat.h. The defaults leave FLOAT meshes untouched.
+uniform vec3 _PositionScale = vec3(1.0);
+uniform vec3 _PositionOffset = vec3(0.0);
+uniform bool _OctahedralNormals = false;
+
+vec3 decodePosition(vec3 p){
+	return p * _PositionScale + _PositionOffset;
+}
+//Same as ew::decodeOctahedral
+vec3 decodeNormal(vec3 n){
+	if (!_OctahedralNormals)
+		return n;
+	vec3 v = vec3(n.xy, 1.0 - abs(n.x) - abs(n.y));
+	float t = max(-v.z, 0.0);
+	v.xy += mix(vec2(t), vec2(-t), greaterThanEqual(v.xy, vec2(0.0)));
+	return normalize(v);
+}
+)";
+
+	int getVertexSize(VertexFormat format);
+	uint16_t floatToHalf(float v);
+	float halfToFloat(uint16_t h);
+	ew::Vec2 encodeOctahedral(const ew::Vec3& normal);
+	ew::Vec3 decodeOctahedral(const ew::Vec2& encoded);
+	void getPositionBounds(const MeshDataView& meshData, ew::Vec3& boundsMin, ew::Vec3& boundsMax);
+	void packVertices(const Vertex* vertices, size_t count, VertexFormat format, const ew::Vec3& positionScale, const ew::Vec3& positionOffset, PackedVertex* out);
+}
@@ -0,0 +1,463 @@
+#include "virtualTexture.h"
+#include "renderStats.h"
+#include "textureCache.h"
+#include "hash.h"
+#include "external/glad.h"
+#include "external/stb_image.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <algorithm>
+
+namespace ew {
+	//Bump when the tile file layout changes
+	static const uint32_t VIRTUAL_TEXTURE_VERSION = 2;
+
+	static bool isTileFileValid(const MappedFile& file, uint64_t sourceHash, bool wrapX) {
+		if (file.getSize() < sizeof(VirtualTextureHeader))
+			return false;
+		const VirtualTextureHeader* header = (const VirtualTextureHeader*)file.getData();
+		if (memcmp(header->magic, "EWVT", 4) != 0 || header->version != VIRTUAL_TEXTURE_VERSION || header->sourceHash != sourceHash)
+			return false;
+		if ((header->wrapX != 0) != wrapX)
+			return false;
+		if (header->tileSize != VIRTUAL_TEXTURE_TILE_SIZE || header->tileBorder != VIRTUAL_TEXTURE_TILE_BORDER)
+			return false;
+		if (header->numLevels < 1 || header->numLevels > VIRTUAL_TEXTURE_MAX_LEVELS)
+			return false;
+		int last = header->numLevels - 1;
+		if (header->levelTilesX[last] != 1 || header->levelTilesY[last] != 1)
+			return false;
+		int slotSize = header->tileSize + header->tileBorder * 2;
+		if (header->tileBytes != (uint64_t)slotSize * slotSize * 4)
+			return false;
+		uint64_t numTiles = (uint64_t)header->levelFirstTile[last] + 1;
+		return header->dataOffset + numTiles * header->tileBytes <= file.getSize();
+	}
+
+	/// <summary>
+	/// Opens the tile file for filePath (filePath + ".ewvt"), building it from the source image if it is missing or stale,
+	/// then creates the atlas and page table and loads the coarsest level.
+	/// </summary>
+	/// <param name="filePath">Encoded source image</param>
+	/// <param name="atlasTilesPerSide">Atlas size in tiles. VRAM use is fixed by this, not by the image size.</param>
+	/// <param name="wrapX">Image repeats horizontally, like a longitude wrapped map, so filtering across the left and right edges blends them</param>
+	VirtualTexture::VirtualTexture(const char* filePath, int atlasTilesPerSide, bool wrapX)
+	{
+		//Page entries store slot coordinates in 8 bits
+		m_atlasTilesPerSide = std::min(std::max(atlasTilesPerSide, 2), 256);
+
+		std::vector<unsigned char> source;
+		if (!readFileBytes(filePath, source)) {
+			printf("Failed to load image %s", filePath);
+			return;
+		}
+		uint64_t sourceHash = hashBytes(source.data(), source.size());
+		std::string tilePath = std::string(filePath) + ".ewvt";
+		if (!m_file.open(tilePath.c_str()) || !isTileFileValid(m_file, sourceHash, wrapX)) {
+			m_file.close();
+			if (!buildTileFile(source, tilePath.c_str(), sourceHash, wrapX) || !m_file.open(tilePath.c_str()) || !isTileFileValid(m_file, sourceHash, wrapX)) {
+				printf("Failed to build virtual texture %s", tilePath.c_str());
+				m_file.close();
+				return;
+			}
+		}
+		source.clear();
+		source.shrink_to_fit();
+		m_header = (const VirtualTextureHeader*)m_file.getData();
+
+		int slotSize = m_header->tileSize + m_header->tileBorder * 2;
+		int atlasSize = m_atlasTilesPerSide * slotSize;
+		glGenTextures(1, &m_atlas);
+		glBindTexture(GL_TEXTURE_2D, m_atlas);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, atlasSize, atlasSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		//One layer per level, each sized for level 0 so every level shares the same tile coordinates
+		glGenTextures(1, &m_pageTable);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, m_pageTable);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8UI, m_header->levelTilesX[0], m_header->levelTilesY[0], m_header->numLevels, 0, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, NULL);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+		m_slots.resize(m_atlasTilesPerSide * m_atlasTilesPerSide);
+		m_pageEntries.resize((size_t)m_header->levelTilesX[0] * m_header->levelTilesY[0] * m_header->numLevels);
+
+		//Coarsest level is a single tile that every lookup can fall back to
+		int slot = findFreeSlot();
+		uploadTile(makeKey(m_header->numLevels - 1, 0, 0), slot);
+		m_slots[slot].isPinned = true;
+		updatePageTable();
+	}
+	VirtualTexture::~VirtualTexture()
+	{
+		glDeleteTextures(1, &m_atlas);
+		glDeleteTextures(1, &m_pageTable);
+	}
+	/// <summary>
+	/// Decodes the source image and writes every tile of every level to tilePath.
+	/// Only one level is held in memory at a time, besides the level being downsampled into.
+	/// </summary>
+	bool VirtualTexture::buildTileFile(const std::vector<unsigned char>& source, const char* tilePath, uint64_t sourceHash, bool wrapX)
+	{
+		int width, height, numComponents;
+		unsigned char* pixels = stbi_load_from_memory(source.data(), (int)source.size(), &width, &height, &numComponents, 4);
+		if (pixels == NULL)
+			return false;
+
+		const int tileSize = VIRTUAL_TEXTURE_TILE_SIZE;
+		const int border = VIRTUAL_TEXTURE_TILE_BORDER;
+		const int slotSize = tileSize + border * 2;
+		VirtualTextureHeader header = {};
+		memcpy(header.magic, "EWVT", 4);
+		header.version = VIRTUAL_TEXTURE_VERSION;
+		header.sourceHash = sourceHash;
+		header.width = width;
+		header.height = height;
+		header.tileSize = tileSize;
+		header.tileBorder = border;
+		header.wrapX = wrapX ? 1 : 0;
+		int firstTile = 0;
+		while (header.numLevels < VIRTUAL_TEXTURE_MAX_LEVELS) {
+			int level = header.numLevels++;
+			int levelWidth = std::max(width >> level, 1);
+			int levelHeight = std::max(height >> level, 1);
+			header.levelTilesX[level] = (levelWidth + tileSize - 1) / tileSize;
+			header.levelTilesY[level] = (levelHeight + tileSize - 1) / tileSize;
+			header.levelFirstTile[level] = firstTile;
+			firstTile += header.levelTilesX[level] * header.levelTilesY[level];
+			if (header.levelTilesX[level] == 1 && header.levelTilesY[level] == 1)
+				break;
+		}
+		//Tile coordinates are packed into 12 bits each, see makeKey
+		if (header.levelTilesX[0] > 4096 || header.levelTilesY[0] > 4096) {
+			stbi_image_free(pixels);
+			return false;
+		}
+		header.tileBytes = (uint64_t)slotSize * slotSize * 4;
+		header.dataOffset = (sizeof(VirtualTextureHeader) + 15) & ~15ull;
+
+		//Write to a temporary file first so a partial write is never mistaken for a valid tile file
+		std::string tempPath = std::string(tilePath) + ".tmp";
+		FILE* file = fopen(tempPath.c_str(), "wb");
+		if (file == NULL) {
+			stbi_image_free(pixels);
+			return false;
+		}
+		unsigned char padding[16] = {};
+		bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+		written &= fwrite(padding, 1, (size_t)header.dataOffset - sizeof(header), file) == (size_t)header.dataOffset - sizeof(header);
+
+		std::vector<uint32_t> tile(slotSize * slotSize);
+		std::vector<unsigned char> current, next;
+		const unsigned char* levelPixels = pixels;
+		for (int level = 0; level < header.numLevels; level++)
+		{
+			int levelWidth = std::max(width >> level, 1);
+			int levelHeight = std::max(height >> level, 1);
+			const uint32_t* texels = (const uint32_t*)levelPixels;
+			for (int tileY = 0; tileY < header.levelTilesY[level]; tileY++)
+			{
+				for (int tileX = 0; tileX < header.levelTilesX[level]; tileX++)
+				{
+					//Texels past the top and bottom repeat the edge. Past the left and right they come from the opposite edge when wrapping.
+					for (int y = 0; y < slotSize; y++)
+					{
+						int srcY = std::min(std::max(tileY * tileSize - border + y, 0), levelHeight - 1);
+						for (int x = 0; x < slotSize; x++)
+						{
+							int srcX = tileX * tileSize - border + x;
+							srcX = wrapX ? ((srcX % levelWidth) + levelWidth) % levelWidth : std::min(std::max(srcX, 0), levelWidth - 1);
+							tile[y * slotSize + x] = texels[srcY * levelWidth + srcX];
+						}
+					}
+					written &= fwrite(tile.data(), 1, (size_t)header.tileBytes, file) == header.tileBytes;
+				}
+			}
+			if (level + 1 < header.numLevels) {
+				int nextWidth = std::max(width >> (level + 1), 1);
+				int nextHeight = std::max(height >> (level + 1), 1);
+				next.resize((size_t)nextWidth * nextHeight * 4);
+				downsampleImage(levelPixels, levelWidth, levelHeight, next.data(), nextWidth, nextHeight, 4);
+				if (pixels != NULL) {
+					stbi_image_free(pixels);
+					pixels = NULL;
+				}
+				current.swap(next);
+				levelPixels = current.data();
+			}
+		}
+		if (pixels != NULL) {
+			stbi_image_free(pixels);
+		}
+		fclose(file);
+		remove(tilePath);
+		if (!written || rename(tempPath.c_str(), tilePath) != 0) {
+			remove(tempPath.c_str());
+			return false;
+		}
+		return true;
+	}
+	/// <summary>
+	/// Marks a tile and its ancestors as used this frame. Tiles that aren't resident are queued for the next update().
+	/// Out of range requests are ignored.
+	/// </summary>
+	void VirtualTexture::requestTile(int level, int x, int y)
+	{
+		if (!isValid() || level < 0 || level >= m_header->numLevels)
+			return;
+		if (x < 0 || y < 0 || x >= m_header->levelTilesX[level] || y >= m_header->levelTilesY[level])
+			return;
+		for (; level < m_header->numLevels; level++)
+		{
+			uint32_t key = makeKey(level, x, y);
+			auto it = m_residentSlots.find(key);
+			if (it != m_residentSlots.end()) {
+				Slot& slot = m_slots[it->second];
+				//Ancestors were touched by whoever touched this tile first
+				if (slot.lastUsedFrame == m_frame)
+					return;
+				slot.lastUsedFrame = m_frame;
+			}
+			else {
+				m_requested.insert(key);
+			}
+			if (level + 1 < m_header->numLevels) {
+				x = std::min(x / 2, m_header->levelTilesX[level + 1] - 1);
+				y = std::min(y / 2, m_header->levelTilesY[level + 1] - 1);
+			}
+		}
+	}
+	/// <summary>
+	/// Empty slot if there is one, otherwise the least recently used unpinned slot not used this frame. -1 if none.
+	/// </summary>
+	int VirtualTexture::findFreeSlot() const
+	{
+		int best = -1;
+		for (int i = 0; i < (int)m_slots.size(); i++)
+		{
+			const Slot& slot = m_slots[i];
+			if (slot.key == UINT32_MAX)
+				return i;
+			if (slot.isPinned || slot.lastUsedFrame == m_frame)
+				continue;
+			if (best < 0 || slot.lastUsedFrame < m_slots[best].lastUsedFrame)
+				best = i;
+		}
+		return best;
+	}
+	void VirtualTexture::uploadTile(uint32_t key, int slot)
+	{
+		Slot& dst = m_slots[slot];
+		if (dst.key != UINT32_MAX) {
+			m_residentSlots.erase(dst.key);
+		}
+		dst.key = key;
+		dst.lastUsedFrame = m_frame;
+		m_residentSlots[key] = slot;
+		m_isPageTableDirty = true;
+
+		int level = key >> 24;
+		int y = (key >> 12) & 0xFFF;
+		int x = key & 0xFFF;
+		uint64_t tileIndex = (uint64_t)m_header->levelFirstTile[level] + (uint64_t)y * m_header->levelTilesX[level] + x;
+		const unsigned char* data = m_file.getData() + m_header->dataOffset + tileIndex * m_header->tileBytes;
+
+		int slotSize = m_header->tileSize + m_header->tileBorder * 2;
+		glBindTexture(GL_TEXTURE_2D, m_atlas);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, (slot % m_atlasTilesPerSide) * slotSize, (slot / m_atlasTilesPerSide) * slotSize, slotSize, slotSize, GL_RGBA, GL_UNSIGNED_BYTE, data);
+		countUpload((size_t)slotSize * slotSize * 4);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	/// <summary>
+	/// Rebuilds the page table from the resident set, coarsest level first so missing tiles can copy their parent's entry
+	/// </summary>
+	void VirtualTexture::updatePageTable()
+	{
+		int pitch = m_header->levelTilesX[0];
+		size_t layerSize = (size_t)pitch * m_header->levelTilesY[0];
+		for (int level = m_header->numLevels - 1; level >= 0; level--)
+		{
+			PageEntry* entries = &m_pageEntries[level * layerSize];
+			const PageEntry* parentEntries = level + 1 < m_header->numLevels ? &m_pageEntries[(level + 1) * layerSize] : nullptr;
+			for (int y = 0; y < m_header->levelTilesY[level]; y++)
+			{
+				for (int x = 0; x < m_header->levelTilesX[level]; x++)
+				{
+					auto it = m_residentSlots.find(makeKey(level, x, y));
+					PageEntry& entry = entries[y * pitch + x];
+					if (it != m_residentSlots.end()) {
+						entry.slotX = (uint8_t)(it->second % m_atlasTilesPerSide);
+						entry.slotY = (uint8_t)(it->second / m_atlasTilesPerSide);
+						entry.level = (uint8_t)level;
+						entry.unused = 0;
+					}
+					else if (parentEntries != nullptr) {
+						int parentX = std::min(x / 2, m_header->levelTilesX[level + 1] - 1);
+						int parentY = std::min(y / 2, m_header->levelTilesY[level + 1] - 1);
+						entry = parentEntries[parentY * pitch + parentX];
+					}
+				}
+			}
+		}
+		glBindTexture(GL_TEXTURE_2D_ARRAY, m_pageTable);
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, pitch, m_header->levelTilesY[0], m_header->numLevels, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, m_pageEntries.data());
+		countUpload(layerSize * m_header->numLevels * sizeof(PageEntry));
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+		m_isPageTableDirty = false;
+	}
+	/// <summary>
+	/// Streams in requested tiles, coarsest first, evicting least recently used ones once the atlas is full.
+	/// Call once per frame after the feedback for this frame has been collected.
+	/// </summary>
+	/// <param name="maxTileUploads">Limit on tiles uploaded this call. Tiles over the limit are requested again by later feedback.</param>
+	/// <returns>Number of tiles uploaded</returns>
+	int VirtualTexture::update(int maxTileUploads)
+	{
+		if (!isValid())
+			return 0;
+		//Level is in the high bits of the key, so descending keys are coarsest first
+		std::vector<uint32_t> missing(m_requested.begin(), m_requested.end());
+		std::sort(missing.begin(), missing.end(), [](uint32_t a, uint32_t b) { return a > b; });
+		m_requested.clear();
+
+		int numUploaded = 0;
+		for (uint32_t key : missing)
+		{
+			if (numUploaded >= maxTileUploads)
+				break;
+			int slot = findFreeSlot();
+			//Everything resident is in use this frame
+			if (slot < 0)
+				break;
+			uploadTile(key, slot);
+			numUploaded++;
+		}
+		if (m_isPageTableDirty) {
+			updatePageTable();
+		}
+		m_frame++;
+		return numUploaded;
+	}
+	void VirtualTexture::bind(int atlasUnit, int pageTableUnit) const
+	{
+		glActiveTexture(GL_TEXTURE0 + atlasUnit);
+		glBindTexture(GL_TEXTURE_2D, m_atlas);
+		glActiveTexture(GL_TEXTURE0 + pageTableUnit);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, m_pageTable);
+	}
+
+	VirtualTextureFeedback::VirtualTextureFeedback(int width, int height)
+		: m_width(width < 1 ? 1 : width), m_height(height < 1 ? 1 : height)
+	{
+		glGenTextures(1, &m_colorTexture);
+		glBindTexture(GL_TEXTURE_2D, m_colorTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16UI, m_width, m_height, 0, GL_RGBA_INTEGER, GL_UNSIGNED_SHORT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		glGenRenderbuffers(1, &m_depthBuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, m_depthBuffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, m_width, m_height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+		glGenFramebuffers(1, &m_fbo);
+		glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_colorTexture, 0);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthBuffer);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			printf("Virtual texture feedback framebuffer incomplete");
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		glGenBuffers(2, m_pixelBuffers);
+		for (int i = 0; i < 2; i++)
+		{
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pixelBuffers[i]);
+			glBufferData(GL_PIXEL_PACK_BUFFER, (size_t)m_width * m_height * 4 * sizeof(uint16_t), NULL, GL_STREAM_READ);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+	VirtualTextureFeedback::~VirtualTextureFeedback()
+	{
+		for (int i = 0; i < 2; i++)
+		{
+			if (m_fences[i] != nullptr) {
+				glDeleteSync((GLsync)m_fences[i]);
+			}
+		}
+		glDeleteBuffers(2, m_pixelBuffers);
+		glDeleteFramebuffers(1, &m_fbo);
+		glDeleteRenderbuffers(1, &m_depthBuffer);
+		glDeleteTextures(1, &m_colorTexture);
+	}
+	/// <summary>
+	/// Binds and clears the feedback target. Draw every virtually textured object with the feedback shader, then call end().
+	/// </summary>
+	void VirtualTextureFeedback::begin()
+	{
+		glGetIntegerv(GL_VIEWPORT, m_prevViewport);
+		glGetIntegerv(GL_FRAMEBUFFER_BINDING, &m_prevFramebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+		glViewport(0, 0, m_width, m_height);
+		const GLuint clearColor[4] = { 0, 0, 0, 0 };
+		glClearBufferuiv(GL_COLOR, 0, clearColor);
+		glClear(GL_DEPTH_BUFFER_BIT);
+	}
+	/// <summary>
+	/// Starts reading back this frame's feedback and hands last frame's (if the GPU has finished it) to the textures.
+	/// Restores the default framebuffer and the previous viewport.
+	/// </summary>
+	/// <param name="textures">Indexed by the texture index the feedback shader wrote, minus one</param>
+	void VirtualTextureFeedback::end(VirtualTexture* const* textures, int numTextures)
+	{
+		int current = m_frame % 2;
+		int previous = 1 - current;
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pixelBuffers[current]);
+		if (m_fences[current] != nullptr) {
+			//Never consumed, overwrite it
+			glDeleteSync((GLsync)m_fences[current]);
+		}
+		glReadPixels(0, 0, m_width, m_height, GL_RGBA_INTEGER, GL_UNSIGNED_SHORT, (void*)0);
+		m_fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+		if (m_fences[previous] != nullptr && glClientWaitSync((GLsync)m_fences[previous], 0, 0) != GL_TIMEOUT_EXPIRED) {
+			glDeleteSync((GLsync)m_fences[previous]);
+			m_fences[previous] = nullptr;
+			size_t size = (size_t)m_width * m_height * 4 * sizeof(uint16_t);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pixelBuffers[previous]);
+			const uint16_t* pixels = (const uint16_t*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+			if (pixels != NULL) {
+				uint64_t prevPixel = 0;
+				for (int i = 0; i < m_width * m_height; i++)
+				{
+					const uint16_t* pixel = pixels + i * 4;
+					//Neighboring pixels usually hit the same tile
+					uint64_t packed;
+					memcpy(&packed, pixel, sizeof(packed));
+					if (packed == prevPixel)
+						continue;
+					prevPixel = packed;
+					int index = pixel[3];
+					if (index == 0 || index > numTextures)
+						continue;
+					textures[index - 1]->requestTile(pixel[2], pixel[0], pixel[1]);
+				}
+				glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			}
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, m_prevFramebuffer);
+		glViewport(m_prevViewport[0], m_prevViewport[1], m_prevViewport[2], m_prevViewport[3]);
+		m_frame++;
+	}
+}
@@ -0,0 +1,147 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include "mappedFile.h"
+
+namespace ew {
+	constexpr int VIRTUAL_TEXTURE_MAX_LEVELS = 16;
+	constexpr int VIRTUAL_TEXTURE_TILE_SIZE = 128; //Texels per tile side, excluding the border
+	constexpr int VIRTUAL_TEXTURE_TILE_BORDER = 1; //Texels copied from neighboring tiles on each side, so bilinear filtering doesn't bleed
+
+	//Shader side: #include "ew/virtualTexture.glsl" for sampleVirtual(uv), with the atlas and page table from VirtualTexture::bind.
+	//The feedback shader uses getVirtualTile, so it requests exactly the tiles sampleVirtual looks up.
+	constexpr char VIRTUAL_TEXTURE_GLSL[] = R"(//Virtual texture, see ew/virtualTexture.h
+uniform usampler2DArray _PageTable;
+uniform sampler2D _TileAtlas;
+uniform vec2 _VTSize; //Texels at level 0
+uniform int _VTNumLevels;
+uniform int _VTTileSize;
+uniform int _VTTileBorder;
+uniform int _VTAtlasTiles; //Atlas size in tiles per side
+
+//Tile x, tile y and level that uv is sampled from. lodBias is subtracted from the level of detail.
+ivec3 getVirtualTile(vec2 uv, float lodBias){
+	vec2 texel = uv * _VTSize;
+	float lod = log2(max(max(length(dFdx(texel)), length(dFdy(texel))), 1.0)) - lodBias;
+	int level = clamp(int(lod), 0, _VTNumLevels - 1);
+	ivec2 levelSize = max(ivec2(_VTSize) >> level, ivec2(1));
+	ivec2 tile = min(ivec2(fract(uv) * vec2(levelSize)), levelSize - 1) / _VTTileSize;
+	return ivec3(tile, level);
+}
+
+vec4 sampleVirtual(vec2 uv){
+	//Page table points at this tile or its closest resident ancestor
+	uvec4 entry = texelFetch(_PageTable, getVirtualTile(uv, 0.0), 0);
+	uv = fract(uv);
+
+	ivec2 residentSize = max(ivec2(_VTSize) >> int(entry.z), ivec2(1));
+	vec2 residentTexel = min(uv * vec2(residentSize), vec2(residentSize) - 0.001);
+	vec2 inTile = residentTexel - vec2(ivec2(residentTexel) / _VTTileSize * _VTTileSize);
+	float slotSize = float(_VTTileSize + 2 * _VTTileBorder);
+	vec2 atlasTexel = vec2(entry.xy) * slotSize + float(_VTTileBorder) + inTile;
+	return textureLod(_TileAtlas, atlasTexel / (slotSize * float(_VTAtlasTiles)), 0.0);
+}
+)";
+
+	//Layout of a .ewvt file: this header followed by every tile of every level, RGBA8,
+	//finest level first, tiles in row major order within a level
+	struct VirtualTextureHeader {
+		char magic[4]; //"EWVT"
+		uint32_t version;
+		uint64_t sourceHash; //Hash of the encoded source file
+		int32_t width;
+		int32_t height;
+		int32_t tileSize;
+		int32_t tileBorder;
+		int32_t wrapX; //Left and right borders hold texels from the opposite edge instead of repeating their own
+		int32_t numLevels; //The last level is a single tile
+		int32_t levelTilesX[VIRTUAL_TEXTURE_MAX_LEVELS];
+		int32_t levelTilesY[VIRTUAL_TEXTURE_MAX_LEVELS];
+		int32_t levelFirstTile[VIRTUAL_TEXTURE_MAX_LEVELS];
+		uint64_t dataOffset; //From the start of the file
+		uint64_t tileBytes;
+	};
+
+	/// <summary>
+	/// Image of any size sampled through a fixed size atlas of resident tiles.
+	/// Tiles are read from a memory mapped tile file (built from the source image on first use).
+	/// A page table texture maps every tile of every level to its atlas slot, or to the slot of its closest resident ancestor.
+	/// The coarsest level is always resident, so every lookup resolves to something.
+	/// </summary>
+	class VirtualTexture {
+	public:
+		VirtualTexture(const char* filePath, int atlasTilesPerSide = 16, bool wrapX = true);
+		~VirtualTexture();
+		VirtualTexture(const VirtualTexture&) = delete;
+		VirtualTexture& operator=(const VirtualTexture&) = delete;
+		void requestTile(int level, int x, int y);
+		int update(int maxTileUploads = 8);
+		void bind(int atlasUnit, int pageTableUnit)const;
+		inline bool isValid()const { return m_header != nullptr; }
+		inline int getWidth()const { return m_header->width; }
+		inline int getHeight()const { return m_header->height; }
+		inline int getNumLevels()const { return m_header->numLevels; }
+		inline int getTileSize()const { return m_header->tileSize; }
+		inline int getTileBorder()const { return m_header->tileBorder; }
+		inline int getAtlasTilesPerSide()const { return m_atlasTilesPerSide; }
+		inline int getNumResidentTiles()const { return (int)m_residentSlots.size(); }
+		inline unsigned int getAtlas()const { return m_atlas; }
+		inline unsigned int getPageTable()const { return m_pageTable; }
+	private:
+		struct PageEntry {
+			uint8_t slotX, slotY; //Atlas slot of the tile, or of its closest resident ancestor
+			uint8_t level; //Level of the tile in that slot
+			uint8_t unused;
+		};
+		struct Slot {
+			uint32_t key = UINT32_MAX; //Resident tile, UINT32_MAX if empty
+			uint32_t lastUsedFrame = 0;
+			bool isPinned = false;
+		};
+		static inline uint32_t makeKey(int level, int x, int y) { return ((uint32_t)level << 24) | ((uint32_t)y << 12) | (uint32_t)x; }
+		bool buildTileFile(const std::vector<unsigned char>& source, const char* tilePath, uint64_t sourceHash, bool wrapX);
+		int findFreeSlot()const;
+		void uploadTile(uint32_t key, int slot);
+		void updatePageTable();
+
+		MappedFile m_file;
+		const VirtualTextureHeader* m_header = nullptr;
+		unsigned int m_atlas = 0;
+		unsigned int m_pageTable = 0;
+		int m_atlasTilesPerSide;
+		std::vector<Slot> m_slots;
+		std::unordered_map<uint32_t, int> m_residentSlots; //Tile key -> slot
+		std::unordered_set<uint32_t> m_requested; //Missing tiles requested since the last update
+		std::vector<PageEntry> m_pageEntries; //One per tile per level, uploaded as the layers of m_pageTable
+		uint32_t m_frame = 1;
+		bool m_isPageTableDirty = true;
+	};
+
+	/// <summary>
+	/// Low resolution render target that the feedback shader writes (tile x, tile y, level, texture index + 1) into.
+	/// Results are read back through pixel buffers one frame late, so the readback never stalls.
+	/// </summary>
+	class VirtualTextureFeedback {
+	public:
+		VirtualTextureFeedback(int width, int height);
+		~VirtualTextureFeedback();
+		VirtualTextureFeedback(const VirtualTextureFeedback&) = delete;
+		VirtualTextureFeedback& operator=(const VirtualTextureFeedback&) = delete;
+		void begin();
+		void end(VirtualTexture* const* textures, int numTextures);
+		inline int getWidth()const { return m_width; }
+		inline int getHeight()const { return m_height; }
+	private:
+		int m_width, m_height;
+		unsigned int m_fbo = 0;
+		unsigned int m_colorTexture = 0;
+		unsigned int m_depthBuffer = 0;
+		unsigned int m_pixelBuffers[2] = {};
+		void* m_fences[2] = {}; //GLsync per pixel buffer
+		int m_frame = 0;
+		int m_prevViewport[4] = {};
+		int m_prevFramebuffer = 0; //Restored by end(), so the scene can render to a framebuffer of its own
+	};
+}
@@ -0,0 +1,87 @@
+#include "tests.h"
+#include <random>
+#include <vector>
+#include <ew/frustum.h>
+#include <ew/ewMath/transformations.h>
+
+/// <summary>
+/// Axis aligned box from -halfSize to halfSize. With whole numbers every plane distance is exact,
+/// so spheres can be placed exactly touching a plane.
+/// </summary>
+static ew::Frustum boxFrustum(float halfSize) {
+	ew::Frustum frustum;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		for (int side = 0; side < 2; side++)
+		{
+			ew::Vec4 plane(0.0f, 0.0f, 0.0f, halfSize);
+			(&plane.x)[axis] = side == 0 ? 1.0f : -1.0f;
+			frustum.planes[axis * 2 + side] = plane;
+		}
+	}
+	return frustum;
+}
+
+static int checkCull(const ew::Frustum& frustum, const std::vector<ew::BoundingSphere>& spheres, const char* name) {
+	int failures = 0;
+	std::vector<uint8_t> visible(spheres.size(), 2);
+	int numVisible = ew::cullSpheres(frustum, spheres.data(), spheres.size(), visible.data());
+	int expectedVisible = 0;
+	for (size_t i = 0; i < spheres.size(); i++)
+	{
+		uint8_t expected = ew::isSphereInFrustum(frustum, spheres[i]) ? 1 : 0;
+		expectedVisible += expected;
+		const ew::BoundingSphere& s = spheres[i];
+		TEST_CHECK(visible[i] == expected, failures, "%s: sphere %d (%g, %g, %g) radius %g culled as %d, expected %d",
+			name, (int)i, s.center.x, s.center.y, s.center.z, s.radius, visible[i], expected);
+	}
+	TEST_CHECK(numVisible == expectedVisible, failures, "%s: %d visible, expected %d", name, numVisible, expectedVisible);
+	return failures;
+}
+
+/// <summary>
+/// cullSpheres' four wide SSE/NEON path must give the same answer as isSphereInFrustum for every sphere
+/// </summary>
+int testFrustumCull() {
+	std::mt19937 random(1);
+	int failures = 0;
+
+	//Random spheres around a perspective camera, in and out of every plane
+	ew::Mat4 viewProjection = ew::Perspective(1.0f, 16.0f / 9.0f, 0.1f, 100.0f) * ew::LookAt(ew::Vec3(3.0f, 2.0f, 10.0f), ew::Vec3(0.0f), ew::Vec3(0.0f, 1.0f, 0.0f));
+	ew::Frustum frustum = ew::extractFrustum(viewProjection);
+	std::uniform_real_distribution<float> position(-120.0f, 120.0f);
+	std::uniform_real_distribution<float> radius(0.0f, 20.0f);
+	const int NUM_SPHERES = 10001;
+	std::vector<ew::BoundingSphere> spheres(NUM_SPHERES);
+	for (ew::BoundingSphere& s : spheres)
+	{
+		s.center = ew::Vec3(position(random), position(random), position(random));
+		s.radius = radius(random);
+	}
+	failures += checkCull(frustum, spheres, "Perspective");
+
+	//Spheres just touching a plane are visible, and a hair further out are not
+	ew::Frustum box = boxFrustum(10.0f);
+	std::uniform_int_distribution<int> coordinate(-10, 10);
+	std::uniform_int_distribution<int> axisDistribution(0, 2);
+	std::vector<ew::BoundingSphere> touching;
+	for (int i = 0; i < 999; i++)
+	{
+		ew::BoundingSphere s;
+		s.center = ew::Vec3((float)coordinate(random), (float)coordinate(random), (float)coordinate(random));
+		s.radius = (float)(1 + i % 4);
+		int axis = axisDistribution(random);
+		float edge = 10.0f + s.radius;
+		(&s.center.x)[axis] = (i % 2 == 0 ? edge : -edge) + (i % 3 == 2 ? 0.001f : 0.0f);
+		touching.push_back(s);
+	}
+	failures += checkCull(box, touching, "Touching");
+
+	//Every count up to a few full batches, so the scalar tail runs after 0 to 3 leftovers
+	for (size_t count = 0; count <= 13; count++)
+	{
+		std::vector<ew::BoundingSphere> prefix(spheres.begin(), spheres.begin() + count);
+		failures += checkCull(frustum, prefix, "Prefix");
+	}
+	return failures;
+}
@@ -0,0 +1,118 @@
+#include "tests.h"
+#include <algorithm>
+#include <array>
+#include <vector>
+#include <ew/mesh.h>
+
+typedef std::array<unsigned int, 3> Triangle;
+
+static std::vector<Triangle> toTriangles(const std::vector<unsigned int>& indices) {
+	std::vector<Triangle> triangles(indices.size() / 3);
+	for (size_t i = 0; i < triangles.size(); i++)
+	{
+		triangles[i] = { indices[i * 3], indices[i * 3 + 1], indices[i * 3 + 2] };
+	}
+	return triangles;
+}
+
+/// <summary>
+/// Checks that the chunks cover every index in order, and returns the original vertex of every index
+/// by adding each chunk's base vertex back and following duplicated vertices to their source
+/// </summary>
+static std::vector<unsigned int> unpackIndexChunks(const ew::IndexChunks& chunks, size_t numIndices, size_t numVertices, int& failures, const char* name) {
+	std::vector<unsigned int> indices;
+	TEST_CHECK(chunks.indices.size() == numIndices, failures, "%s: %d packed indices, expected %d", name, (int)chunks.indices.size(), (int)numIndices);
+	int expectedFirst = 0;
+	for (const ew::IndexChunk& chunk : chunks.chunks)
+	{
+		TEST_CHECK(chunk.firstIndex == expectedFirst, failures, "%s: chunk starts at %d, expected %d", name, chunk.firstIndex, expectedFirst);
+		TEST_CHECK(chunk.numIndices > 0 && chunk.numIndices % 3 == 0, failures, "%s: chunk has %d indices", name, chunk.numIndices);
+		expectedFirst = chunk.firstIndex + chunk.numIndices;
+		for (int i = chunk.firstIndex; i < expectedFirst && i < (int)chunks.indices.size(); i++)
+		{
+			unsigned int vertex = (unsigned int)chunk.baseVertex + chunks.indices[i];
+			if (vertex >= numVertices) {
+				size_t copy = vertex - numVertices;
+				TEST_CHECK(copy < chunks.duplicatedVertices.size(), failures, "%s: index %d reads past the duplicated vertices", name, i);
+				vertex = copy < chunks.duplicatedVertices.size() ? chunks.duplicatedVertices[copy] : 0;
+			}
+			indices.push_back(vertex);
+		}
+	}
+	TEST_CHECK(expectedFirst == (int)numIndices, failures, "%s: chunks cover %d of %d indices", name, expectedFirst, (int)numIndices);
+	return indices;
+}
+
+/// <summary>
+/// buildIndexChunks splits large meshes at the right places, and every chunk unpacks back to the original triangles
+/// </summary>
+int testIndexChunks() {
+	int failures = 0;
+	ew::IndexChunks chunks;
+
+	//Small mesh: a single chunk based at its lowest index, indices unchanged
+	{
+		std::vector<unsigned int> indices = { 100, 101, 102, 102, 101, 60000, 5000, 100, 60000 };
+		ew::buildIndexChunks(indices.data(), indices.size(), 60001, chunks);
+		TEST_CHECK(chunks.chunks.size() == 1, failures, "Small: %d chunks, expected 1", (int)chunks.chunks.size());
+		TEST_CHECK(!chunks.chunks.empty() && chunks.chunks[0].baseVertex == 100, failures, "Small: base vertex %d, expected 100", chunks.chunks.empty() ? -1 : chunks.chunks[0].baseVertex);
+		TEST_CHECK(chunks.duplicatedVertices.empty(), failures, "Small: %d vertices duplicated", (int)chunks.duplicatedVertices.size());
+		TEST_CHECK(unpackIndexChunks(chunks, indices.size(), 60001, failures, "Small") == indices, failures, "Small: indices do not round trip");
+	}
+
+	//Separate triangles (3k, 3k + 1, 3k + 2): 21845 triangles span 65535 vertices, so each chunk holds that many
+	{
+		const int NUM_TRIANGLES = 100000;
+		std::vector<unsigned int> indices(NUM_TRIANGLES * 3);
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			indices[i] = (unsigned int)i;
+		}
+		ew::buildIndexChunks(indices.data(), indices.size(), indices.size(), chunks);
+		const int TRIANGLES_PER_CHUNK = 21845;
+		int expectedChunks = (NUM_TRIANGLES + TRIANGLES_PER_CHUNK - 1) / TRIANGLES_PER_CHUNK;
+		TEST_CHECK((int)chunks.chunks.size() == expectedChunks, failures, "Strip: %d chunks, expected %d", (int)chunks.chunks.size(), expectedChunks);
+		for (size_t c = 0; c < chunks.chunks.size(); c++)
+		{
+			int expectedBase = (int)c * TRIANGLES_PER_CHUNK * 3;
+			TEST_CHECK(chunks.chunks[c].baseVertex == expectedBase, failures, "Strip: chunk %d base vertex %d, expected %d", (int)c, chunks.chunks[c].baseVertex, expectedBase);
+		}
+		TEST_CHECK(chunks.duplicatedVertices.empty(), failures, "Strip: %d vertices duplicated", (int)chunks.duplicatedVertices.size());
+		TEST_CHECK(unpackIndexChunks(chunks, indices.size(), indices.size(), failures, "Strip") == indices, failures, "Strip: indices do not round trip");
+	}
+
+	//Triangles spanning more than 65536 vertices among narrow ones, fanning out from vertex 0.
+	//Enough of them that the duplicates need several windows, each with its own copy of vertex 0.
+	{
+		const unsigned int NUM_VERTICES = 300000;
+		std::vector<unsigned int> indices;
+		std::vector<unsigned int> narrow;
+		for (unsigned int t = 0; t < 120000; t++)
+		{
+			unsigned int v = (t * 7919u) % (NUM_VERTICES - 70000);
+			if (t % 3 == 0) {
+				unsigned int wide[3] = { 0, v + 70000, v + 70001 };
+				indices.insert(indices.end(), wide, wide + 3);
+			}
+			else {
+				unsigned int tri[3] = { v, v + 2, v + 1 };
+				indices.insert(indices.end(), tri, tri + 3);
+				narrow.insert(narrow.end(), tri, tri + 3);
+			}
+		}
+		ew::buildIndexChunks(indices.data(), indices.size(), NUM_VERTICES, chunks);
+		TEST_CHECK(!chunks.duplicatedVertices.empty() && chunks.duplicatedVertices.size() <= 120000, failures, "Wide: %d vertices duplicated for 40000 wide triangles", (int)chunks.duplicatedVertices.size());
+		std::vector<unsigned int> unpacked = unpackIndexChunks(chunks, indices.size(), NUM_VERTICES, failures, "Wide");
+		//Narrow triangles keep their order ahead of the wide ones
+		TEST_CHECK(unpacked.size() >= narrow.size() && std::equal(narrow.begin(), narrow.end(), unpacked.begin()), failures, "Wide: narrow triangles were reordered");
+		std::vector<Triangle> expected = toTriangles(indices);
+		std::vector<Triangle> actual = toTriangles(unpacked);
+		std::sort(expected.begin(), expected.end());
+		std::sort(actual.begin(), actual.end());
+		TEST_CHECK(actual == expected, failures, "Wide: triangles do not round trip");
+	}
+
+	ew::buildIndexChunks(nullptr, 0, 0, chunks);
+	TEST_CHECK(chunks.chunks.empty() && chunks.indices.empty(), failures, "Empty: %d chunks", (int)chunks.chunks.size());
+	return failures;
+}
@@ -0,0 +1,42 @@
+//Tests for core: SIMD paths and rewritten math against their reference implementations.
+//Usage: core_tests [FILTER], runs every test whose name contains FILTER. Exits with 1 if any check fails.
+
+#include <stdio.h>
+#include <string.h>
+#include "tests.h"
+
+struct Test {
+	const char* name;
+	int (*run)();
+};
+
+static const Test TESTS[] = {
+	{ "Mat4 SIMD", testMat4Simd },
+	{ "TransformSystem", testTransformSystem },
+	{ "Noise batch", testNoiseBatch },
+	{ "Frustum cull", testFrustumCull },
+	{ "Index chunks", testIndexChunks },
+	{ "Mesh optimizer", testMeshOptimizer },
+	{ "Pack vertices", testPackVertices },
+};
+
+int main(int argc, char** argv) {
+	const char* filter = argc > 1 ? argv[1] : nullptr;
+	int numFailed = 0;
+	int numRun = 0;
+	for (const Test& test : TESTS)
+	{
+		if (filter != nullptr && strstr(test.name, filter) == nullptr)
+			continue;
+		printf("%s\n", test.name);
+		int failures = test.run();
+		printf("  %s", failures == 0 ? "passed\n" : "FAILED");
+		if (failures != 0) {
+			printf(" (%d checks)\n", failures);
+			numFailed++;
+		}
+		numRun++;
+	}
+	printf("%d of %d tests passed\n", numRun - numFailed, numRun);
+	return numFailed == 0 ? 0 : 1;
+}
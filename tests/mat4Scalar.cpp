@@ -0,0 +1,39 @@
+//ewMath's scalar path, compiled alongside the SIMD one so the two can be compared in a single executable.
+//The headers go in their own namespace, so their inline functions don't merge at link time with the SIMD build's.
+//Standard headers are included first so they stay in the global namespace.
+
+#include <math.h>
+#include <string.h>
+#include <cstddef>
+#include <random>
+#ifndef EW_NO_SIMD
+#define EW_NO_SIMD
+#endif
+namespace scalar {
+#include <ew/ewMath/ewMath.h>
+}
+#include "mat4Scalar.h"
+
+static_assert(sizeof(scalar::ew::Mat4) == 16 * sizeof(float), "Mat4 is 16 packed floats");
+
+static scalar::ew::Mat4 toMat4(const float* m) {
+	return scalar::ew::Mat4(
+		scalar::ew::Vec4(m[0], m[1], m[2], m[3]),
+		scalar::ew::Vec4(m[4], m[5], m[6], m[7]),
+		scalar::ew::Vec4(m[8], m[9], m[10], m[11]),
+		scalar::ew::Vec4(m[12], m[13], m[14], m[15]));
+}
+
+void scalarMat4Multiply(const float* l, const float* r, float* result) {
+	scalar::ew::Mat4 m = toMat4(l) * toMat4(r);
+	memcpy(result, &m[0].x, sizeof(float) * 16);
+}
+
+void scalarMat4TransformVec4(const float* m, const float* v, float* result) {
+	scalar::ew::Vec4 r = toMat4(m) * scalar::ew::Vec4(v[0], v[1], v[2], v[3]);
+	memcpy(result, &r.x, sizeof(float) * 4);
+}
+
+void scalarTransformVec4Batch(const float* m, const float* in, float* out, size_t count) {
+	scalar::ew::TransformVec4Batch(toMat4(m), reinterpret_cast<const scalar::ew::Vec4*>(in), reinterpret_cast<scalar::ew::Vec4*>(out), count);
+}
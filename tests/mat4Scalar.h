@@ -0,0 +1,7 @@
+#pragma once
+#include <stddef.h>
+
+//ewMath built with EW_NO_SIMD, see mat4Scalar.cpp. Matrices are 16 floats in ew::Mat4's column-major layout, vectors 4 floats.
+void scalarMat4Multiply(const float* l, const float* r, float* result);
+void scalarMat4TransformVec4(const float* m, const float* v, float* result);
+void scalarTransformVec4Batch(const float* m, const float* in, float* out, size_t count);
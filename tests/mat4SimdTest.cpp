@@ -0,0 +1,79 @@
+#include "tests.h"
+#include "mat4Scalar.h"
+#include <string.h>
+#include <random>
+#include <vector>
+#include <ew/ewMath/ewMath.h>
+
+static const char* getSimdPath() {
+#if defined(EW_SIMD_AVX)
+	return "AVX";
+#elif defined(EW_SIMD_SSE)
+	return "SSE";
+#elif defined(EW_SIMD_NEON)
+	return "NEON";
+#else
+	return "scalar (EW_NO_SIMD)";
+#endif
+}
+
+static ew::Mat4 randomMat4(std::mt19937& random) {
+	std::uniform_real_distribution<float> distribution(-10.0f, 10.0f);
+	ew::Mat4 m;
+	for (int c = 0; c < 4; c++)
+	{
+		m[c] = ew::Vec4(distribution(random), distribution(random), distribution(random), distribution(random));
+	}
+	return m;
+}
+
+static ew::Vec4 randomVec4(std::mt19937& random) {
+	std::uniform_real_distribution<float> distribution(-100.0f, 100.0f);
+	return ew::Vec4(distribution(random), distribution(random), distribution(random), distribution(random));
+}
+
+/// <summary>
+/// Mat4 * Mat4, Mat4 * Vec4 and TransformVec4Batch through the SIMD paths must match the EW_NO_SIMD build bit for bit
+/// </summary>
+int testMat4Simd() {
+	printf("  SIMD path: %s\n", getSimdPath());
+	std::mt19937 random(1);
+	int failures = 0;
+	const int NUM_TRIALS = 10000;
+	for (int i = 0; i < NUM_TRIALS; i++)
+	{
+		ew::Mat4 l = randomMat4(random);
+		ew::Mat4 r = randomMat4(random);
+		ew::Mat4 product = l * r;
+		float expected[16];
+		scalarMat4Multiply(&l[0].x, &r[0].x, expected);
+		TEST_CHECK(memcmp(&product, expected, sizeof(expected)) == 0, failures, "Mat4 * Mat4 differs in trial %d", i);
+
+		ew::Vec4 v = randomVec4(random);
+		ew::Vec4 transformed = l * v;
+		float expectedVec[4];
+		scalarMat4TransformVec4(&l[0].x, &v.x, expectedVec);
+		TEST_CHECK(memcmp(&transformed, expectedVec, sizeof(expectedVec)) == 0, failures, "Mat4 * Vec4 differs in trial %d", i);
+	}
+
+	//Every count up to a few full iterations, so the AVX pair loop and the odd tail both run
+	for (size_t count = 0; count <= 37; count++)
+	{
+		ew::Mat4 m = randomMat4(random);
+		std::vector<ew::Vec4> in(count);
+		for (ew::Vec4& v : in)
+		{
+			v = randomVec4(random);
+		}
+		std::vector<ew::Vec4> out(count);
+		std::vector<ew::Vec4> expected(count);
+		ew::TransformVec4Batch(m, in.data(), out.data(), count);
+		scalarTransformVec4Batch(&m[0].x, (const float*)in.data(), (float*)expected.data(), count);
+		TEST_CHECK(count == 0 || memcmp(out.data(), expected.data(), sizeof(ew::Vec4) * count) == 0, failures, "TransformVec4Batch differs for %d vectors", (int)count);
+
+		//out may alias in
+		ew::TransformVec4Batch(m, in.data(), in.data(), count);
+		TEST_CHECK(count == 0 || memcmp(in.data(), expected.data(), sizeof(ew::Vec4) * count) == 0, failures, "In place TransformVec4Batch differs for %d vectors", (int)count);
+	}
+	return failures;
+}
@@ -0,0 +1,73 @@
+#include "tests.h"
+#include <algorithm>
+#include <string.h>
+#include <vector>
+#include <ew/meshOptimizer.h>
+#include <ew/procGen.h>
+
+//A triangle by the contents of its vertices in winding order, so it can be found again after vertices are renumbered
+struct TriangleVertices {
+	ew::Vertex v[3];
+	bool operator<(const TriangleVertices& other)const { return memcmp(v, other.v, sizeof(v)) < 0; }
+	bool operator==(const TriangleVertices& other)const { return memcmp(v, other.v, sizeof(v)) == 0; }
+};
+
+static std::vector<TriangleVertices> getSortedTriangles(const ew::MeshData& mesh) {
+	std::vector<TriangleVertices> triangles(mesh.indices.size() / 3);
+	for (size_t t = 0; t < triangles.size(); t++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			triangles[t].v[k] = mesh.vertices[mesh.indices[t * 3 + k]];
+		}
+	}
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+/// <summary>
+/// optimizeMesh keeps every triangle with its winding, and its output still fits 16 bit index chunks without duplicated vertices
+/// </summary>
+int testMeshOptimizer() {
+	int failures = 0;
+	const int SUBDIVISIONS[] = { 64, 320, 640 };
+	for (int subdivisions : SUBDIVISIONS)
+	{
+		ew::MeshData mesh = ew::createSphere(1.0f, subdivisions);
+		std::vector<TriangleVertices> expected = getSortedTriangles(mesh);
+		ew::MeshOptimizationReport report = ew::optimizeMesh(mesh);
+		char name[32];
+		snprintf(name, sizeof(name), "  createSphere %d", subdivisions);
+		ew::printMeshOptimizationReport(name, report);
+
+		TEST_CHECK(report.numDegenerateTriangles == 0, failures, "Sphere %d: %d triangles removed as degenerate", subdivisions, report.numDegenerateTriangles);
+		TEST_CHECK(getSortedTriangles(mesh) == expected, failures, "Sphere %d: triangles changed", subdivisions);
+		for (unsigned int index : mesh.indices)
+		{
+			TEST_CHECK(index < mesh.vertices.size(), failures, "Sphere %d: index %u past %d vertices", subdivisions, index, (int)mesh.vertices.size());
+		}
+
+		ew::IndexChunks chunks;
+		ew::buildIndexChunks(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size(), chunks);
+		TEST_CHECK(chunks.duplicatedVertices.empty(), failures, "Sphere %d: %d vertices duplicated for triangles spanning more than 65536 vertices", subdivisions, (int)chunks.duplicatedVertices.size());
+		TEST_CHECK((int)chunks.chunks.size() <= report.numWindows, failures, "Sphere %d: %d index chunks for %d windows", subdivisions, (int)chunks.chunks.size(), report.numWindows);
+
+		//A sphere can't cover itself, so overdraw ordering would only cost vertex cache hits
+		TEST_CHECK(report.isConvex && report.acmrOverdraw == report.acmrVertexCache, failures, "Sphere %d: overdraw pass ran on a convex mesh, ACMR %.3f -> %.3f", subdivisions, report.acmrVertexCache, report.acmrOverdraw);
+		TEST_CHECK(report.acmrVertexFetch < report.acmrCleanup, failures, "Sphere %d: ACMR %.3f, not better than %.3f", subdivisions, report.acmrVertexFetch, report.acmrCleanup);
+	}
+
+	//Displaced globe morph target: not convex, so the overdraw pass runs, but still within the windows
+	ew::MeshData earth = ew::createEarth(2.0f, 1.0f, 1.0f, 400, 0.05f);
+	std::vector<TriangleVertices> expected = getSortedTriangles(earth);
+	ew::MeshOptimizationReport report = ew::optimizeMesh(earth);
+	ew::printMeshOptimizationReport("  createEarth 400", report);
+	TEST_CHECK(getSortedTriangles(earth) == expected, failures, "Earth: triangles changed");
+	TEST_CHECK(earth.morphVertices.size() == earth.vertices.size(), failures, "Earth: %d morph vertices for %d vertices", (int)earth.morphVertices.size(), (int)earth.vertices.size());
+	TEST_CHECK(!report.isConvex && report.numClusters > 0, failures, "Earth: overdraw pass skipped on a displaced mesh");
+	TEST_CHECK(report.acmrOverdraw <= report.acmrVertexCache * 1.05f, failures, "Earth: overdraw raised ACMR from %.3f to %.3f", report.acmrVertexCache, report.acmrOverdraw);
+	ew::IndexChunks chunks;
+	ew::buildIndexChunks(earth.indices.data(), earth.indices.size(), earth.vertices.size(), chunks);
+	TEST_CHECK(chunks.duplicatedVertices.empty(), failures, "Earth: %d vertices duplicated", (int)chunks.duplicatedVertices.size());
+	return failures;
+}
@@ -0,0 +1,104 @@
+#include "tests.h"
+#include <math.h>
+#include <random>
+#include <vector>
+#include <ew/noise.h>
+
+//Seeds and octave settings the batches are checked with: defaults, createEarth's, and uneven ones
+static ew::FbmSettings getTestSettings(int index) {
+	ew::FbmSettings settings;
+	if (index == 1) {
+		settings.seed = 1;
+		settings.frequency = 2.0f;
+	}
+	else if (index == 2) {
+		settings.seed = 0xdeadbeefu;
+		settings.octaves = 3;
+		settings.frequency = 0.37f;
+		settings.lacunarity = 1.9f;
+		settings.gain = 0.65f;
+	}
+	return settings;
+}
+static const int NUM_TEST_SETTINGS = 3;
+
+/// <summary>
+/// Random points, with every other one on a quarter unit grid so lattice and simplex boundaries come up
+/// </summary>
+static void randomPoints(std::mt19937& random, int count, std::vector<float>& x, std::vector<float>& y, std::vector<float>& z) {
+	std::uniform_real_distribution<float> distribution(-100.0f, 100.0f);
+	x.resize(count);
+	y.resize(count);
+	z.resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		x[i] = distribution(random);
+		y[i] = distribution(random);
+		z[i] = distribution(random);
+		if (i % 2 == 1) {
+			x[i] = floorf(x[i] * 4.0f) * 0.25f;
+			y[i] = floorf(y[i] * 4.0f) * 0.25f;
+			z[i] = floorf(z[i] * 4.0f) * 0.25f;
+		}
+	}
+}
+
+/// <summary>
+/// simplexNoiseBatch, fbmNoiseBatch and fbmNoiseSphereRow must return exactly what the single point functions do
+/// </summary>
+int testNoiseBatch() {
+	std::mt19937 random(1);
+	int failures = 0;
+	const int NUM_POINTS = 4096;
+	std::vector<float> x, y, z;
+	randomPoints(random, NUM_POINTS, x, y, z);
+	std::vector<float> result(NUM_POINTS);
+
+	for (int s = 0; s < NUM_TEST_SETTINGS; s++)
+	{
+		ew::FbmSettings settings = getTestSettings(s);
+		ew::simplexNoiseBatch(x.data(), y.data(), z.data(), result.data(), NUM_POINTS, settings.seed);
+		for (int i = 0; i < NUM_POINTS; i++)
+		{
+			float expected = ew::simplexNoise(x[i], y[i], z[i], settings.seed);
+			TEST_CHECK(result[i] == expected, failures, "simplexNoiseBatch seed %u point %d (%g, %g, %g): %.9g, expected %.9g", settings.seed, i, x[i], y[i], z[i], result[i], expected);
+		}
+		ew::fbmNoiseBatch(x.data(), y.data(), z.data(), result.data(), NUM_POINTS, settings);
+		for (int i = 0; i < NUM_POINTS; i++)
+		{
+			float expected = ew::fbmNoise(x[i], y[i], z[i], settings);
+			TEST_CHECK(result[i] == expected, failures, "fbmNoiseBatch settings %d point %d (%g, %g, %g): %.9g, expected %.9g", s, i, x[i], y[i], z[i], result[i], expected);
+		}
+	}
+
+	//Counts that are not multiples of four end in the scalar tail
+	for (int count = 0; count <= 13; count++)
+	{
+		ew::FbmSettings settings = getTestSettings(2);
+		ew::fbmNoiseBatch(x.data(), y.data(), z.data(), result.data(), count, settings);
+		for (int i = 0; i < count; i++)
+		{
+			TEST_CHECK(result[i] == ew::fbmNoise(x[i], y[i], z[i], settings), failures, "fbmNoiseBatch of %d points differs at point %d", count, i);
+		}
+	}
+
+	//Rows longer than the internal chunk, pole to pole like createEarth's grid
+	const int NUM_ROWS = 9;
+	const int NUM_COLUMNS = 601;
+	const float PI = 3.14159265359f;
+	float thetaStep = 2.0f * PI / (NUM_COLUMNS - 1);
+	std::vector<float> row(NUM_COLUMNS);
+	for (int r = 0; r < NUM_ROWS; r++)
+	{
+		ew::FbmSettings settings = getTestSettings(1);
+		float phi = PI * r / (NUM_ROWS - 1);
+		ew::fbmNoiseSphereRow(phi, thetaStep, NUM_COLUMNS, settings, row.data());
+		for (int col = 0; col < NUM_COLUMNS; col++)
+		{
+			float theta = thetaStep * col;
+			float expected = ew::fbmNoise(cosf(theta) * sinf(phi), cosf(phi), sinf(theta) * sinf(phi), settings);
+			TEST_CHECK(row[col] == expected, failures, "fbmNoiseSphereRow row %d column %d: %.9g, expected %.9g", r, col, row[col], expected);
+		}
+	}
+	return failures;
+}
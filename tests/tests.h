@@ -0,0 +1,20 @@
+#pragma once
+#include <stdio.h>
+
+//Each test returns its number of failed checks and prints what failed
+int testMat4Simd();
+int testTransformSystem();
+int testNoiseBatch();
+int testFrustumCull();
+int testIndexChunks();
+int testMeshOptimizer();
+int testPackVertices();
+
+//Counts and reports a failed check, printing the first few so a broken path doesn't flood the output
+#define TEST_CHECK(condition, failures, ...) \
+	do { \
+		if (!(condition)) { \
+			if ((failures) < 10) { printf("    "); printf(__VA_ARGS__); printf("\n"); } \
+			(failures)++; \
+		} \
+	} while (0)
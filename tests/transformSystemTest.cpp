@@ -0,0 +1,94 @@
+#include "tests.h"
+#include <math.h>
+#include <string.h>
+#include <random>
+#include <vector>
+#include <ew/transformSystem.h>
+
+/// <summary>
+/// The closed form matrix reorders the arithmetic of Translate * RotateX * RotateY * RotateZ * Scale,
+/// so entries are compared relative to their size instead of bit for bit
+/// </summary>
+static bool isNearlyEqual(const ew::Mat4& a, const ew::Mat4& b) {
+	for (int c = 0; c < 4; c++)
+	{
+		for (int r = 0; r < 4; r++)
+		{
+			float expected = b[c][r];
+			if (fabsf(a[c][r] - expected) > 1e-5f * (1.0f + fabsf(expected)))
+				return false;
+		}
+	}
+	return true;
+}
+
+static ew::Transform randomTransform(std::mt19937& random) {
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> rotation(-360.0f, 360.0f);
+	std::uniform_real_distribution<float> scale(0.1f, 10.0f);
+	ew::Transform transform;
+	transform.position = ew::Vec3(position(random), position(random), position(random));
+	transform.rotation = ew::Vec3(rotation(random), rotation(random), rotation(random));
+	transform.scale = ew::Vec3(scale(random), scale(random), scale(random));
+	return transform;
+}
+
+/// <summary>
+/// TransformSystem matrices match Transform::getModelMatrix, and update() rebuilds exactly the dirty entries
+/// </summary>
+int testTransformSystem() {
+	std::mt19937 random(1);
+	int failures = 0;
+	const int NUM_TRANSFORMS = 1000;
+
+	ew::TransformSystem system;
+	std::vector<ew::Transform> transforms;
+	for (int i = 0; i < NUM_TRANSFORMS; i++)
+	{
+		transforms.push_back(randomTransform(random));
+		TEST_CHECK(system.create(transforms[i]) == i, failures, "create returned the wrong id for transform %d", i);
+	}
+	TEST_CHECK(system.update() == NUM_TRANSFORMS, failures, "First update did not rebuild every transform");
+	TEST_CHECK(system.getUpdatedBegin() == 0 && system.getUpdatedEnd() == NUM_TRANSFORMS, failures, "First update range is [%d, %d)", system.getUpdatedBegin(), system.getUpdatedEnd());
+	for (int i = 0; i < NUM_TRANSFORMS; i++)
+	{
+		TEST_CHECK(isNearlyEqual(system.getModelMatrix(i), transforms[i].getModelMatrix()), failures, "Matrix %d differs from Transform::getModelMatrix", i);
+		ew::Transform stored = system.get(i);
+		TEST_CHECK(memcmp(&stored, &transforms[i], sizeof(ew::Transform)) == 0, failures, "get(%d) does not return what was created", i);
+	}
+
+	//Nothing changed, nothing rebuilt
+	TEST_CHECK(system.update() == 0, failures, "Update without changes rebuilt matrices");
+	TEST_CHECK(system.getUpdatedBegin() == system.getUpdatedEnd(), failures, "Empty update reported a range");
+
+	//Each setter marks its transform once, however often it is called
+	std::vector<ew::Mat4> before(system.getModelMatrices(), system.getModelMatrices() + NUM_TRANSFORMS);
+	const int changed[] = { 10, 500, 730 };
+	transforms[10].position = ew::Vec3(1.0f, 2.0f, 3.0f);
+	transforms[10].rotation = ew::Vec3(45.0f, 0.0f, 90.0f);
+	transforms[500].scale = ew::Vec3(2.0f);
+	transforms[730] = randomTransform(random);
+	system.setPosition(10, transforms[10].position);
+	system.setRotation(10, transforms[10].rotation);
+	system.setScale(500, transforms[500].scale);
+	system.set(730, transforms[730]);
+	TEST_CHECK(system.update() == 3, failures, "Update after changing 3 transforms did not rebuild 3");
+	TEST_CHECK(system.getUpdatedBegin() == 10 && system.getUpdatedEnd() == 731, failures, "Update range is [%d, %d), expected [10, 731)", system.getUpdatedBegin(), system.getUpdatedEnd());
+	for (int i = 0; i < NUM_TRANSFORMS; i++)
+	{
+		bool isChanged = i == changed[0] || i == changed[1] || i == changed[2];
+		if (isChanged) {
+			TEST_CHECK(isNearlyEqual(system.getModelMatrix(i), transforms[i].getModelMatrix()), failures, "Changed matrix %d differs from Transform::getModelMatrix", i);
+		}
+		else {
+			TEST_CHECK(memcmp(&system.getModelMatrix(i), &before[i], sizeof(ew::Mat4)) == 0, failures, "Unchanged matrix %d was rewritten", i);
+		}
+	}
+
+	//Transforms created later are picked up by the next update
+	ew::Transform added = randomTransform(random);
+	int addedId = system.create(added);
+	TEST_CHECK(system.update() == 1, failures, "Update after create did not rebuild the new transform");
+	TEST_CHECK(isNearlyEqual(system.getModelMatrix(addedId), added.getModelMatrix()), failures, "Added matrix differs from Transform::getModelMatrix");
+	return failures;
+}
@@ -0,0 +1,116 @@
+#include "tests.h"
+#include <float.h>
+#include <math.h>
+#include <random>
+#include <vector>
+#include <ew/vertexFormat.h>
+
+//What the GPU reads from a snorm16 attribute
+static float fromSnorm16(uint16_t v) {
+	return fmaxf((float)(int16_t)v / 32767.0f, -1.0f);
+}
+
+//Angle between two unit vectors in radians, in double so it stays accurate near zero
+static double getAngle(const ew::Vec3& a, const ew::Vec3& b) {
+	double cx = (double)a.y * b.z - (double)a.z * b.y;
+	double cy = (double)a.z * b.x - (double)a.x * b.z;
+	double cz = (double)a.x * b.y - (double)a.y * b.x;
+	double dot = (double)a.x * b.x + (double)a.y * b.y + (double)a.z * b.z;
+	return atan2(sqrt(cx * cx + cy * cy + cz * cz), dot);
+}
+
+/// <summary>
+/// Random vertices inside the given bounds, plus vertices on the bounds' corners and normals along every axis,
+/// where octahedral encoding folds
+/// </summary>
+static std::vector<ew::Vertex> randomVertices(std::mt19937& random, int count, const ew::Vec3& boundsMin, const ew::Vec3& boundsMax) {
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::normal_distribution<float> gaussian(0.0f, 1.0f);
+	std::vector<ew::Vertex> vertices(count);
+	for (int i = 0; i < count; i++)
+	{
+		ew::Vertex& v = vertices[i];
+		for (int k = 0; k < 3; k++)
+		{
+			float t = i < 8 ? (float)((i >> k) & 1) : unit(random);
+			(&v.pos.x)[k] = (&boundsMin.x)[k] + ((&boundsMax.x)[k] - (&boundsMin.x)[k]) * t;
+		}
+		v.normal = ew::Normalize(ew::Vec3(gaussian(random), gaussian(random), gaussian(random)));
+		if (i < 6) {
+			v.normal = ew::Vec3(0.0f);
+			(&v.normal.x)[i / 2] = i % 2 == 0 ? 1.0f : -1.0f;
+		}
+		v.uv = ew::Vec2(unit(random) * 1.2f - 0.1f, unit(random));
+	}
+	return vertices;
+}
+
+/// <summary>
+/// packVertices round trips through the shader's decode within the precision of each packed field
+/// </summary>
+int testPackVertices() {
+	std::mt19937 random(1);
+	int failures = 0;
+	//More than one parallelFor chunk
+	const int NUM_VERTICES = 10000;
+	//snorm16 steps are 2/65534 in octahedral space, and the fold stretches them by at most about pi/2 on the sphere
+	const double MAX_NORMAL_ANGLE = 1e-4;
+
+	//NORMALIZED, with the scale and offset Mesh::load derives from the bounds
+	ew::Vec3 boundsMin(-3000.0f, 2.0f, -0.5f);
+	ew::Vec3 boundsMax(5000.0f, 2.25f, 0.5f);
+	std::vector<ew::Vertex> vertices = randomVertices(random, NUM_VERTICES, boundsMin, boundsMax);
+	ew::Vec3 offset = (boundsMin + boundsMax) * 0.5f;
+	ew::Vec3 scale = (boundsMax - boundsMin) * 0.5f;
+	std::vector<ew::PackedVertex> packed(NUM_VERTICES);
+	ew::packVertices(vertices.data(), vertices.size(), ew::VertexFormat::NORMALIZED, scale, offset, packed.data());
+	double maxNormalAngle = 0.0;
+	for (int i = 0; i < NUM_VERTICES; i++)
+	{
+		const ew::Vertex& v = vertices[i];
+		const ew::PackedVertex& p = packed[i];
+		for (int k = 0; k < 3; k++)
+		{
+			float s = (&scale.x)[k];
+			float o = (&offset.x)[k];
+			float expected = (&v.pos.x)[k];
+			float decoded = fromSnorm16(p.pos[k]) * s + o;
+			//Half a quantization step, plus float rounding in the encode and decode
+			float maxError = s * (0.5f / 32767.0f) + 4.0f * FLT_EPSILON * (fabsf(o) + s);
+			TEST_CHECK(fabsf(decoded - expected) <= maxError, failures, "NORMALIZED vertex %d axis %d: %.9g decoded as %.9g, error over %g", i, k, expected, decoded, maxError);
+		}
+		TEST_CHECK(p.pos[3] == 0, failures, "NORMALIZED vertex %d: padding %d", i, p.pos[3]);
+
+		ew::Vec3 normal = ew::decodeOctahedral(ew::Vec2(fromSnorm16((uint16_t)p.normal[0]), fromSnorm16((uint16_t)p.normal[1])));
+		double angle = getAngle(normal, v.normal);
+		maxNormalAngle = fmax(maxNormalAngle, angle);
+		TEST_CHECK(angle <= MAX_NORMAL_ANGLE, failures, "Vertex %d normal (%g, %g, %g) decoded as (%g, %g, %g), %g radians off", i, v.normal.x, v.normal.y, v.normal.z, normal.x, normal.y, normal.z, angle);
+
+		for (int k = 0; k < 2; k++)
+		{
+			float expected = fminf(fmaxf((&v.uv.x)[k], 0.0f), 1.0f);
+			float decoded = p.uv[k] / 65535.0f;
+			TEST_CHECK(fabsf(decoded - expected) <= 0.5f / 65535.0f + FLT_EPSILON, failures, "Vertex %d uv %d: %g decoded as %g", i, k, expected, decoded);
+		}
+	}
+	printf("  Largest normal error %.3g radians\n", maxNormalAngle);
+
+	//HALF: positions round to the nearest half float, normals and uvs pack the same way
+	std::vector<ew::Vertex> halfVertices = randomVertices(random, NUM_VERTICES, ew::Vec3(-1000.0f), ew::Vec3(1000.0f));
+	ew::packVertices(halfVertices.data(), halfVertices.size(), ew::VertexFormat::HALF, scale, offset, packed.data());
+	for (int i = 0; i < NUM_VERTICES; i++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			float expected = (&halfVertices[i].pos.x)[k];
+			float decoded = ew::halfToFloat(packed[i].pos[k]);
+			//Half of the 11 bit significand's last place, or of the smallest normal step below 2^-14
+			float maxError = fmaxf(fabsf(expected), 6.1035156e-5f) * (1.0f / 2048.0f);
+			TEST_CHECK(fabsf(decoded - expected) <= maxError, failures, "HALF vertex %d axis %d: %.9g decoded as %.9g", i, k, expected, decoded);
+			TEST_CHECK(ew::floatToHalf(decoded) == packed[i].pos[k], failures, "HALF vertex %d axis %d: %.9g does not round trip", i, k, decoded);
+		}
+		ew::Vec3 normal = ew::decodeOctahedral(ew::Vec2(fromSnorm16((uint16_t)packed[i].normal[0]), fromSnorm16((uint16_t)packed[i].normal[1])));
+		TEST_CHECK(getAngle(normal, halfVertices[i].normal) <= MAX_NORMAL_ANGLE, failures, "HALF vertex %d normal %g radians off", i, getAngle(normal, halfVertices[i].normal));
+	}
+	return failures;
+}